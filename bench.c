@@ -0,0 +1,1551 @@
+/******************************************************************************
+ * File: bench.c
+ *
+ * Micro-benchmarks for the routing modules. Not part of the router binary.
+ *
+ * Usage:
+ *   ./dv_bench [name]      (no name => run all)
+ *
+ * Benchmarks:
+ *   routes   - processDistanceVector() cost per tuple as the table grows
+ *   codec    - ASCII vs binary DV encode/decode, ns and bytes per entry
+ *   recv     - packets/sec for recvfrom() vs recvmmsg() under a local
+ *              UDP flood on 127.0.0.1
+ *   snapshot - lock-free distanceLookup() rate with and without a writer
+ *              applying DVs and publishing a snapshot per DV
+ *   slab     - route-sized object churn and teardown, malloc/free vs the
+ *              slab pool
+ *   parse    - fuzz check of the single-pass ASCII DV parser (scalar, SSE2
+ *              and AVX2 tuple kernels) against the old copy + strtok_r
+ *              parser, then MB/s of each
+ *   converge - messages and time to converge after a route withdrawal and
+ *              a link cut on line/ring/grid topologies of forked routers,
+ *              without split horizon, with it, and with poisoned reverse,
+ *              then without split horizon but with infinity at 16
+ *   sim      - in-process simulator (sim.h): convergence time, messages
+ *              and CPU per router on ring/grid/random/fat-tree topologies
+ *              of 10, 100 and 1000 routers, then the same simulation on
+ *              several threads at once, checked against the serial run,
+ *              and HELLO RTT/jitter/loss estimates against the link model
+ *   churn    - a flapping link in the simulator: triggered DVs, messages
+ *              and settle time with the triggered-DV token bucket off and
+ *              at several rates
+ *   detect   - neighbor failure detection: time from a neighbor going
+ *              silent to its loss handler, with the default 10 s timeout
+ *              and with announced HELLO intervals and detect multipliers,
+ *              for 100 and 500 neighbors on a virtual clock, and the cost
+ *              of the HELLOs and expiry passes, then HELLO loss counts
+ *              across neighbors restarting within their detect time
+ *   clock    - ns per read of time(NULL), CLOCK_REALTIME and the monotonic
+ *              clockNowMs() / clockNowCoarseMs()
+ *   log      - ns per log line: printf, LOG_* without the writer thread,
+ *              filtered by level, and queued from one and several threads
+ *
+ * Router modules log to stdout; that is sent to /dev/null while a benchmark
+ * runs and results are written to the original stdout.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <signal.h>
+
+#include "clock.h"
+#include "distance.h"
+#include "dvcodec.h"
+#include "ipaddr.h"
+#include "log.h"
+#include "neighbor.h"
+#include "netio.h"
+#include "rcu.h"
+#include "router.h"
+#include "sim.h"
+#include "slab.h"
+#include "trigger.h"
+
+static FILE* g_out = NULL; /* results go here, stdout is silenced */
+
+/******************************************************************************
+ * Utility: timing / output
+ ******************************************************************************/
+static double nowSec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static double threadCpuSec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static void benchSilence(void) {
+    fflush(stdout);
+    g_out = fdopen(dup(STDOUT_FILENO), "w");
+    if (!g_out) g_out = stderr;
+    if (!freopen("/dev/null", "w", stdout)) {
+        perror("[ERROR] freopen(/dev/null)");
+    }
+    setvbuf(g_out, NULL, _IOLBF, 0);
+}
+
+/* 10.x.y.z address for index i, avoids .0 and .255 octets */
+static void benchIP(char* out, size_t len, unsigned prefix, unsigned i) {
+    snprintf(out, len, "%u.%u.%u.%u", prefix, (i / 254 / 254) % 254 + 1,
+             (i / 254) % 254 + 1, i % 254 + 1);
+}
+
+/******************************************************************************
+ * routes
+ *   S senders each advertise R/S destinations, DV_TUPLES per message.
+ *   Time re-processing the same DVs (lookups only) and with changed
+ *   distances (lookup + update).
+ ******************************************************************************/
+#define ROUTES_SENDERS   16
+#define ROUTES_DV_TUPLES 20
+
+static char** buildRouteDVs(unsigned routes, unsigned distBase, unsigned* outCount) {
+    unsigned dests = routes / ROUTES_SENDERS;
+    unsigned perSender = (dests + ROUTES_DV_TUPLES - 1) / ROUTES_DV_TUPLES;
+    unsigned count = perSender * ROUTES_SENDERS;
+    char** dvs = (char**) calloc(count, sizeof(char*));
+    unsigned n = 0;
+
+    for (unsigned s = 0; s < ROUTES_SENDERS; s++) {
+        char sender[32];
+        benchIP(sender, sizeof(sender), 192, s);
+        for (unsigned d = 0; d < dests; d += ROUTES_DV_TUPLES) {
+            char* dv = (char*) malloc(1024);
+            int off = snprintf(dv, 1024, "%s:DV:", sender);
+            for (unsigned k = d; k < d + ROUTES_DV_TUPLES && k < dests; k++) {
+                char dest[32];
+                benchIP(dest, sizeof(dest), 10, k);
+                off += snprintf(dv + off, 1024 - off, "(%s,%u):", dest, distBase + (k + s) % 7);
+            }
+            dvs[n++] = dv;
+        }
+    }
+    *outCount = n;
+    return dvs;
+}
+
+static void freeDVs(char** dvs, unsigned count) {
+    for (unsigned i = 0; i < count; i++) free(dvs[i]);
+    free(dvs);
+}
+
+static void benchRoutes(void) {
+    static const unsigned sizes[] = { 1000, 10000, 100000 };
+    const int reps = 5;
+
+    fprintf(g_out, "routes: processDistanceVector, %d senders, %d tuples/DV\n",
+            ROUTES_SENDERS, ROUTES_DV_TUPLES);
+    fprintf(g_out, "  %10s %14s %14s\n", "routes", "ns/tuple(hit)", "ns/tuple(upd)");
+
+    Router* router = routerCreate(0);
+    if (!router) return;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        unsigned nA, nB;
+        char** dvA = buildRouteDVs(sizes[i], 1, &nA);
+        char** dvB = buildRouteDVs(sizes[i], 2, &nB);
+        double tuples = (double) (sizes[i] / ROUTES_SENDERS) * ROUTES_SENDERS;
+
+        for (unsigned k = 0; k < nA; k++) processDistanceVector(router, dvA[k]);
+
+        double t0 = nowSec();
+        for (int r = 0; r < reps; r++) {
+            for (unsigned k = 0; k < nA; k++) processDistanceVector(router, dvA[k]);
+        }
+        double hit = (nowSec() - t0) / (reps * tuples) * 1e9;
+
+        t0 = nowSec();
+        for (int r = 0; r < reps; r++) {
+            char** dvs = (r & 1) ? dvA : dvB;
+            for (unsigned k = 0; k < nA; k++) processDistanceVector(router, dvs[k]);
+        }
+        double upd = (nowSec() - t0) / (reps * tuples) * 1e9;
+
+        fprintf(g_out, "  %10u %14.1f %14.1f\n", sizes[i], hit, upd);
+
+        distanceCleanup(router);
+        freeDVs(dvA, nA);
+        freeDVs(dvB, nB);
+    }
+    routerDestroy(router);
+}
+
+/******************************************************************************
+ * codec
+ *   Encode/decode n entries in each wire format.
+ ******************************************************************************/
+static void countTuple(void* ctx, uint32_t sender, uint32_t dest, uint32_t metric) {
+    (void) sender;
+    *(uint64_t*) ctx += dest ^ metric;
+}
+
+static void benchCodec(void) {
+    static const size_t sizes[] = { 100, 1000, 10000 };
+    const size_t budget = 2000000; /* entries per measurement */
+
+    fprintf(g_out, "codec: DV wire formats\n");
+    fprintf(g_out, "  %8s %6s %10s %10s %10s\n", "entries", "format",
+            "bytes/ent", "enc ns/ent", "dec ns/ent");
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t n = sizes[i];
+        size_t reps = budget / n;
+        DVEntry* entries = (DVEntry*) malloc(n * sizeof(DVEntry));
+        for (size_t k = 0; k < n; k++) {
+            char ip[32];
+            benchIP(ip, sizeof(ip), 10, (unsigned) k);
+            ipParse(ip, &entries[k].dest);
+            entries[k].metric = (uint32_t)(k % 300) + 1; /* mix of 1- and 2-byte metrics */
+        }
+        uint32_t sender = 0xC0A80101;
+        size_t used;
+        uint64_t sink = 0;
+
+        size_t textCap = 32 + n * 32;
+        char* text = (char*) malloc(textCap);
+        double t0 = nowSec();
+        size_t textLen = 0;
+        for (size_t r = 0; r < reps; r++) {
+            textLen = dvEncodeText(sender, NULL, entries, n, text, textCap, &used);
+        }
+        double encText = (nowSec() - t0) / (reps * n) * 1e9;
+        t0 = nowSec();
+        for (size_t r = 0; r < reps; r++) {
+            dvDecodeText(text, textLen, NULL, countTuple, &sink);
+        }
+        double decText = (nowSec() - t0) / (reps * n) * 1e9;
+
+        size_t binCap = DVB_HDR_LEN + n * DVB_ENTRY_MAX;
+        unsigned char* bin = (unsigned char*) malloc(binCap);
+        t0 = nowSec();
+        size_t binLen = 0;
+        for (size_t r = 0; r < reps; r++) {
+            binLen = dvEncodeBinary(sender, NULL, entries, n, bin, binCap, &used);
+        }
+        double encBin = (nowSec() - t0) / (reps * n) * 1e9;
+        t0 = nowSec();
+        for (size_t r = 0; r < reps; r++) {
+            dvDecodeBinary(bin, binLen, NULL, countTuple, &sink);
+        }
+        double decBin = (nowSec() - t0) / (reps * n) * 1e9;
+
+        fprintf(g_out, "  %8zu %6s %10.2f %10.1f %10.1f\n", n, "ascii",
+                (double) textLen / n, encText, decText);
+        fprintf(g_out, "  %8zu %6s %10.2f %10.1f %10.1f\n", n, "binary",
+                (double) binLen / n, encBin, decBin);
+        if (sink == 42) fprintf(g_out, " ");
+
+        free(entries);
+        free(text);
+        free(bin);
+    }
+}
+
+/******************************************************************************
+ * recv
+ *   A flood thread blasts HELLO-sized datagrams at a loopback socket with
+ *   sendmmsg(); the receiver counts what it gets in a fixed window using
+ *   the old per-packet path (memset + recvfrom) or recvBatchRead().
+ *   Receiver CPU per packet is reported too, since the flood thread competes
+ *   for the same cores.
+ ******************************************************************************/
+#define FLOOD_BATCH    64
+#define RECV_WINDOW_S  1.0
+
+typedef struct Flood {
+    int fd;
+    volatile int stop;
+} Flood;
+
+static void* floodThread(void* arg) {
+    Flood* f = (Flood*) arg;
+    static const char msg[] = "10.0.0.1:HELLO:123:C1";
+    struct mmsghdr msgs[FLOOD_BATCH];
+    struct iovec iov = { (void*) msg, sizeof(msg) - 1 };
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < FLOOD_BATCH; i++) {
+        msgs[i].msg_hdr.msg_iov    = &iov;
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    while (!f->stop) {
+        sendmmsg(f->fd, msgs, FLOOD_BATCH, 0);
+    }
+    return NULL;
+}
+
+static int floodSockets(int* rx, int* tx) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    *rx = socket(AF_INET, SOCK_DGRAM, 0);
+    *tx = socket(AF_INET, SOCK_DGRAM, 0);
+    if (*rx < 0 || *tx < 0) return -1;
+    int rcvbuf = 4 << 20;
+    setsockopt(*rx, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct timeval tv = { 0, 100000 };
+    setsockopt(*rx, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (bind(*rx, (struct sockaddr*) &addr, sizeof(addr)) < 0) return -1;
+    if (getsockname(*rx, (struct sockaddr*) &addr, &len) < 0) return -1;
+    if (connect(*tx, (struct sockaddr*) &addr, sizeof(addr)) < 0) return -1;
+    return 0;
+}
+
+static void benchRecvOne(int batched) {
+    int rx, tx;
+    if (floodSockets(&rx, &tx) != 0) {
+        perror("[ERROR] recv bench sockets");
+        return;
+    }
+
+    Flood flood = { tx, 0 };
+    pthread_t th;
+    pthread_create(&th, NULL, floodThread, &flood);
+
+    RecvBatch batch;
+    char buffer[512];
+    struct sockaddr_in from;
+    socklen_t fromLen = sizeof(from);
+    if (batched) recvBatchInit(&batch, DV_MAX_DATAGRAM);
+
+    uint64_t packets = 0, calls = 0;
+    double cpu0 = threadCpuSec();
+    double t0 = nowSec(), t;
+    while ((t = nowSec()) - t0 < RECV_WINDOW_S) {
+        if (batched) {
+            int n = recvBatchRead(&batch, rx);
+            calls++;
+            if (n > 0) packets += (uint64_t) n;
+        } else {
+            memset(buffer, 0, sizeof(buffer));
+            ssize_t bytes = recvfrom(rx, buffer, sizeof(buffer) - 1, 0,
+                                     (struct sockaddr*) &from, &fromLen);
+            calls++;
+            if (bytes >= 0) packets++;
+        }
+    }
+    double cpu = threadCpuSec() - cpu0;
+    flood.stop = 1;
+    pthread_join(th, NULL);
+
+    fprintf(g_out, "  %-10s %12.0f %14.2f %12.0f\n", batched ? "recvmmsg" : "recvfrom",
+            packets / (t - t0), calls ? (double) packets / calls : 0.0,
+            packets ? cpu / packets * 1e9 : 0.0);
+
+    if (batched) recvBatchFree(&batch);
+    close(rx);
+    close(tx);
+}
+
+static void benchRecv(void) {
+    fprintf(g_out, "recv: loopback UDP flood, %.1f s window, batch %d\n",
+            RECV_WINDOW_S, NETIO_RECV_BATCH);
+    fprintf(g_out, "  %-10s %12s %14s %12s\n", "path", "packets/s", "packets/call",
+            "rx cpu ns/pkt");
+    benchRecvOne(0);
+    benchRecvOne(1);
+}
+
+/******************************************************************************
+ * snapshot
+ *   A reader thread does distanceLookup() over every destination while the
+ *   main thread re-applies DVs (alternating distances) and publishes after
+ *   each one, as the receiver does per batch.
+ ******************************************************************************/
+#define SNAPSHOT_ROUTES   10000
+#define SNAPSHOT_WINDOW_S 1.0
+
+typedef struct Lookups {
+    Router* router;
+    const uint32_t* dests;
+    unsigned count;
+    volatile int stop;
+    uint64_t done;
+    uint64_t missed;
+} Lookups;
+
+static void* lookupThread(void* arg) {
+    Lookups* l = (Lookups*) arg;
+    uint64_t done = 0, missed = 0;
+    while (!l->stop) {
+        for (unsigned i = 0; i < l->count; i++) {
+            uint32_t via;
+            int dist;
+            if (distanceLookup(l->router, l->dests[i], &via, &dist) != 0) missed++;
+        }
+        done += l->count;
+    }
+    l->done   = done;
+    l->missed = missed;
+    return NULL;
+}
+
+static double runLookups(Lookups* l, int withWriter, char** dvA, char** dvB,
+                         unsigned n, uint64_t* publishes, double* publishSec) {
+    pthread_t th;
+    l->stop = 0;
+    pthread_create(&th, NULL, lookupThread, l);
+
+    uint64_t pubs = 0;
+    double pubTime = 0;
+    double t0 = nowSec(), t;
+    while ((t = nowSec()) - t0 < SNAPSHOT_WINDOW_S) {
+        if (!withWriter) {
+            usleep(10000);
+            continue;
+        }
+        char** dvs = (pubs / n) & 1 ? dvA : dvB;
+        processDistanceVector(l->router, dvs[pubs % n]);
+        double p0 = nowSec();
+        distancePublish(l->router);
+        pubTime += nowSec() - p0;
+        pubs++;
+    }
+    l->stop = 1;
+    pthread_join(th, NULL);
+    if (publishes) *publishes = pubs;
+    if (publishSec) *publishSec = pubTime;
+    return l->done / (t - t0);
+}
+
+static void benchSnapshot(void) {
+    Router* router = routerCreate(0);
+    if (!router) return;
+    unsigned nA, nB;
+    char** dvA = buildRouteDVs(SNAPSHOT_ROUTES, 1, &nA);
+    char** dvB = buildRouteDVs(SNAPSHOT_ROUTES, 2, &nB);
+    unsigned dests = SNAPSHOT_ROUTES / ROUTES_SENDERS;
+    uint32_t* ips = (uint32_t*) malloc(dests * sizeof(uint32_t));
+    for (unsigned i = 0; i < dests; i++) {
+        char ip[32];
+        benchIP(ip, sizeof(ip), 10, i);
+        ipParse(ip, &ips[i]);
+    }
+    for (unsigned k = 0; k < nA; k++) processDistanceVector(router, dvA[k]);
+    distancePublish(router);
+
+    fprintf(g_out, "snapshot: distanceLookup() over %u dests, %u routes\n",
+            dests, SNAPSHOT_ROUTES);
+    Lookups l = { router, ips, dests, 0, 0, 0 };
+    double idle = runLookups(&l, 0, dvA, dvB, nA, NULL, NULL);
+    fprintf(g_out, "  reader alone:       %12.0f lookups/s  (%llu missed)\n",
+            idle, (unsigned long long) l.missed);
+
+    uint64_t pubs;
+    double pubSec;
+    double busy = runLookups(&l, 1, dvA, dvB, nA, &pubs, &pubSec);
+    fprintf(g_out, "  reader with writer: %12.0f lookups/s  (%llu missed)\n",
+            busy, (unsigned long long) l.missed);
+    fprintf(g_out, "  writer: %llu DVs+publishes/s, %.1f us/publish, %zu retired pending\n",
+            (unsigned long long) (pubs / SNAPSHOT_WINDOW_S),
+            pubs ? pubSec / pubs * 1e6 : 0.0, rcuPending());
+
+    routerDestroy(router);
+    rcuCleanup();
+    free(ips);
+    freeDVs(dvA, nA);
+    freeDVs(dvB, nB);
+}
+
+/******************************************************************************
+ * slab
+ *   Keep `live` route-sized objects allocated, then repeatedly free a random
+ *   one and allocate a replacement (touching it, as createRoute() does).
+ *   Teardown frees everything: one by one for malloc, slabRelease() for
+ *   the pool.
+ ******************************************************************************/
+#define SLAB_OBJ_SIZE 24   /* sizeof(Route) on LP64 */
+#define SLAB_CHURN_OPS 5000000
+
+static uint32_t benchRand(uint32_t* s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static void benchSlabOne(size_t live, int pooled) {
+    SlabPool pool;
+    slabInit(&pool, SLAB_OBJ_SIZE, 256);
+    void** objs = (void**) malloc(live * sizeof(void*));
+    uint32_t seed = 12345;
+
+    for (size_t i = 0; i < live; i++) {
+        objs[i] = pooled ? slabAlloc(&pool) : malloc(SLAB_OBJ_SIZE);
+        memset(objs[i], (int) i, SLAB_OBJ_SIZE);
+    }
+
+    double t0 = nowSec();
+    for (size_t op = 0; op < SLAB_CHURN_OPS; op++) {
+        size_t k = benchRand(&seed) % live;
+        if (pooled) {
+            slabFree(&pool, objs[k]);
+            objs[k] = slabAlloc(&pool);
+        } else {
+            free(objs[k]);
+            objs[k] = malloc(SLAB_OBJ_SIZE);
+        }
+        memset(objs[k], (int) op, SLAB_OBJ_SIZE);
+    }
+    double churn = (nowSec() - t0) / SLAB_CHURN_OPS * 1e9;
+
+    SlabStats st;
+    slabStats(&pool, &st);
+    t0 = nowSec();
+    if (pooled) {
+        slabRelease(&pool);
+    } else {
+        for (size_t i = 0; i < live; i++) free(objs[i]);
+    }
+    double teardown = (nowSec() - t0) * 1e6;
+
+    fprintf(g_out, "  %8zu %-7s %12.1f %12.0f", live, pooled ? "slab" : "malloc",
+            churn, teardown);
+    if (pooled) {
+        fprintf(g_out, "   %zu/%zu in %zu slabs", st.peakInUse, st.capacity, st.chunks);
+    }
+    fprintf(g_out, "\n");
+    free(objs);
+}
+
+static void benchSlab(void) {
+    static const size_t sizes[] = { 1000, 100000, 1000000 };
+    fprintf(g_out, "slab: %d-byte object churn, %d free+alloc pairs\n",
+            SLAB_OBJ_SIZE, SLAB_CHURN_OPS);
+    fprintf(g_out, "  %8s %-7s %12s %12s   %s\n", "live", "alloc", "ns/pair",
+            "teardown us", "pool peak/capacity");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        benchSlabOne(sizes[i], 0);
+        benchSlabOne(sizes[i], 1);
+    }
+}
+
+/******************************************************************************
+ * parse
+ *   legacyDecodeText() is the ASCII decoder as it was before the single-pass
+ *   rewrite (copy, strtok_r, strncpy into a tuple buffer, atoi). It is the
+ *   reference for the fuzz check and the baseline for the throughput run.
+ ******************************************************************************/
+static int legacyDecodeText(const char* DV, DVHeaderFn hdr, DVTupleFn fn, void* ctx) {
+    size_t len = strlen(DV);
+    char* msg = (char*) malloc(len + 1);
+    if (!msg) return -1;
+    memcpy(msg, DV, len + 1);
+    int rc = -1;
+
+    char* saveptr = NULL;
+    char* senderIP = strtok_r(msg, ":", &saveptr);
+    uint32_t sender;
+    if (!senderIP || ipParse(senderIP, &sender) != 0) goto out;
+    char* dvMarker = strtok_r(NULL, ":", &saveptr);
+    if (!dvMarker || strcmp(dvMarker, "DV") != 0) goto out;
+
+    rc = 0;
+    char* tuple = strtok_r(NULL, ":", &saveptr);
+    DVFragInfo frag;
+    int hasFrag = 0;
+    if (tuple && tuple[0] == 'F') {
+        char* end;
+        unsigned long seq = strtoul(tuple + 1, &end, 10);
+        if (*end == '.') {
+            unsigned long idx = strtoul(end + 1, &end, 10);
+            if (*end == '/') {
+                unsigned long cnt = strtoul(end + 1, &end, 10);
+                frag.seq   = (uint16_t) seq;
+                frag.index = (uint16_t) idx;
+                frag.count = (uint16_t) cnt;
+                hasFrag = 1;
+            }
+        }
+        tuple = strtok_r(NULL, ":", &saveptr);
+    }
+    if (hdr && hdr(ctx, sender, hasFrag ? &frag : NULL) != 0) goto out;
+
+    for (; tuple; tuple = strtok_r(NULL, ":", &saveptr)) {
+        if (tuple[0] != '(') continue;
+        char inside[128];
+        strncpy(inside, tuple + 1, sizeof(inside)-1);
+        inside[sizeof(inside)-1] = '\0';
+        char* rp = strchr(inside, ')');
+        if (rp) *rp = '\0';
+        char* comma = strchr(inside, ',');
+        if (!comma) continue;
+        *comma = '\0';
+        int distVal = atoi(comma + 1);
+        if (distVal < 0) continue;
+        uint32_t destIP;
+        if (ipParse(inside, &destIP) != 0) continue;
+        fn(ctx, sender, destIP, (uint32_t) distVal);
+    }
+out:
+    free(msg);
+    return rc;
+}
+
+/* Everything a decoder reported, for comparing two of them. */
+#define FUZZ_MAX_EVENTS 256
+
+typedef struct DecodeLog {
+    uint32_t ev[FUZZ_MAX_EVENTS][4];
+    size_t n;
+} DecodeLog;
+
+static int logHeader(void* ctx, uint32_t sender, const DVFragInfo* frag) {
+    DecodeLog* l = (DecodeLog*) ctx;
+    if (l->n < FUZZ_MAX_EVENTS) {
+        l->ev[l->n][0] = 0xFFFFFFFF;
+        l->ev[l->n][1] = sender;
+        l->ev[l->n][2] = frag ? ((uint32_t) frag->seq << 16 | frag->index) : 0xFFFFFFFF;
+        l->ev[l->n][3] = frag ? frag->count : 0xFFFFFFFF;
+        l->n++;
+    }
+    return 0;
+}
+
+static void logTuple(void* ctx, uint32_t sender, uint32_t dest, uint32_t metric) {
+    DecodeLog* l = (DecodeLog*) ctx;
+    if (l->n < FUZZ_MAX_EVENTS) {
+        l->ev[l->n][0] = 0;
+        l->ev[l->n][1] = sender;
+        l->ev[l->n][2] = dest;
+        l->ev[l->n][3] = metric;
+        l->n++;
+    }
+}
+
+/* Random DV text, mostly well-formed: optional F token, 0..20 tuples. */
+static size_t fuzzMessage(char* buf, size_t cap, uint32_t* seed) {
+    char ip[IPV4_STR_LEN];
+    size_t off = (size_t) snprintf(buf, cap, "%s:DV:",
+                                   ipFormat(benchRand(seed), ip));
+    if (benchRand(seed) & 1) {
+        off += (size_t) snprintf(buf + off, cap - off, "F%u.%u/%u:", benchRand(seed) % 70000,
+                                 benchRand(seed) % 8, benchRand(seed) % 8);
+    }
+    unsigned tuples = benchRand(seed) % 21;
+    for (unsigned t = 0; t < tuples && off + 40 < cap; t++) {
+        off += (size_t) snprintf(buf + off, cap - off, "(%s,%u):",
+                                 ipFormat(benchRand(seed), ip), benchRand(seed) % 1000);
+    }
+    return off;
+}
+
+/* A few byte-level edits biased towards the delimiters. */
+static size_t fuzzMutate(char* buf, size_t len, size_t cap, uint32_t* seed) {
+    static const char alphabet[] = "():,.F/0123456789 +-x\t";
+    unsigned edits = benchRand(seed) % 6;
+    for (unsigned e = 0; e < edits && len > 0; e++) {
+        size_t at = benchRand(seed) % len;
+        char c = alphabet[benchRand(seed) % (sizeof(alphabet) - 1)];
+        switch (benchRand(seed) % 4) {
+        case 0: buf[at] = c; break;
+        case 1: memmove(buf + at, buf + at + 1, len - at - 1); len--; break;
+        case 2:
+            if (len + 1 < cap) {
+                memmove(buf + at + 1, buf + at, len - at);
+                buf[at] = c;
+                len++;
+            }
+            break;
+        default: len = at; break;
+        }
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static const char* const g_textImplNames[] = { "auto", "scalar", "sse2", "avx2" };
+
+static void benchParseFuzz(void) {
+    const unsigned cases = 200000;
+    static DecodeLog a, b;
+    char msg[1024];
+    uint32_t seed = 0xC0FFEE;
+    unsigned mismatches = 0, tuples = 0;
+
+    for (unsigned i = 0; i < cases; i++) {
+        size_t len = fuzzMessage(msg, sizeof(msg), &seed);
+        len = fuzzMutate(msg, len, sizeof(msg), &seed);
+        a.n = b.n = 0;
+        int ra = legacyDecodeText(msg, logHeader, logTuple, &a);
+        int rb = dvDecodeText(msg, len, logHeader, logTuple, &b);
+        tuples += (unsigned) a.n;
+        if (ra != rb || a.n != b.n || memcmp(a.ev, b.ev, a.n * sizeof(a.ev[0])) != 0) {
+            if (mismatches++ < 5) fprintf(g_out, "  MISMATCH: \"%s\"\n", msg);
+        }
+    }
+    fprintf(g_out, "  fuzz %-6s: %u mutated DVs, %u events, %u mismatches\n",
+            g_textImplNames[dvTextImpl()], cases, tuples, mismatches);
+}
+
+static double benchParseRate(const char* text, size_t len, size_t reps, int legacy) {
+    uint64_t sink = 0;
+    double t0 = nowSec();
+    for (size_t r = 0; r < reps; r++) {
+        if (legacy) legacyDecodeText(text, NULL, countTuple, &sink);
+        else        dvDecodeText(text, len, NULL, countTuple, &sink);
+    }
+    double t = (nowSec() - t0) / reps;
+    if (sink == 42) fprintf(g_out, " ");
+    return len / t / 1e6;
+}
+
+static void benchParse(void) {
+    static const size_t sizes[] = { 20, 1000, 10000, 100000 };
+    static const DVTextImpl impls[] = { DV_TEXT_SCALAR, DV_TEXT_SSE2, DV_TEXT_AVX2 };
+    const size_t nImpls = sizeof(impls) / sizeof(impls[0]);
+    const size_t budget = 4000000; /* tuples per measurement */
+    DVTextImpl saved = dvTextImpl();
+
+    fprintf(g_out, "parse: ASCII DV decode, single pass vs copy + strtok_r\n");
+    for (size_t k = 0; k < nImpls; k++) {
+        if (dvSetTextImpl(impls[k]) != 0) {
+            fprintf(g_out, "  fuzz %-6s: not supported on this CPU\n", g_textImplNames[impls[k]]);
+            continue;
+        }
+        benchParseFuzz();
+    }
+    fprintf(g_out, "  %8s %10s %12s", "tuples", "bytes", "legacy MB/s");
+    for (size_t k = 0; k < nImpls; k++) fprintf(g_out, " %7s MB/s", g_textImplNames[impls[k]]);
+    fprintf(g_out, "\n");
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t n = sizes[i];
+        size_t reps = budget / n;
+        DVEntry* entries = (DVEntry*) malloc(n * sizeof(DVEntry));
+        for (size_t k = 0; k < n; k++) {
+            char ip[32];
+            benchIP(ip, sizeof(ip), 10, (unsigned) k);
+            ipParse(ip, &entries[k].dest);
+            entries[k].metric = (uint32_t)(k % 300) + 1;
+        }
+        size_t cap = 32 + n * 32, used;
+        char* text = (char*) malloc(cap);
+        size_t len = dvEncodeText(0xC0A80101, NULL, entries, n, text, cap, &used);
+
+        fprintf(g_out, "  %8zu %10zu %12.1f", n, len, benchParseRate(text, len, reps, 1));
+        for (size_t k = 0; k < nImpls; k++) {
+            if (dvSetTextImpl(impls[k]) != 0) {
+                fprintf(g_out, " %12s", "-");
+                continue;
+            }
+            fprintf(g_out, " %12.1f", benchParseRate(text, len, reps, 0));
+        }
+        fprintf(g_out, "\n");
+        free(entries);
+        free(text);
+    }
+    dvSetTextImpl(saved);
+}
+
+/******************************************************************************
+ * converge
+ *   Each router is a child process running the real distance module on its
+ *   own UDP socket on 127.0.0.1; DVs go to each topology neighbor with
+ *   emitDistanceVectorPeers() as soon as the table changes. Router i owns
+ *   stub destination 10.1.0.i+1 (learned from a host that is not a router).
+ *   Events, injected by the parent:
+ *     withdraw - router 0 loses its stub, so the destination is gone
+ *     cut      - the link between routers 0 and 1 fails
+ *   Converged = no DV sent for CONV_QUIET_S, reported as the time of the
+ *   last DV; runs still busy at CONV_CAP_S are cut off. Without split
+ *   horizon a withdrawal counts to infinity (DV_DEFAULT_INFINITY unless
+ *   set lower); split horizon stops that between two routers but not
+ *   around a loop (ring, grid).
+ ******************************************************************************/
+#define CONV_MAX_NODES  16
+#define CONV_MAX_DEGREE 4
+#define CONV_QUIET_S    0.2
+#define CONV_CAP_S      3.0
+
+typedef struct ConvShared {
+    uint64_t messages;     /* DV datagrams sent by all routers */
+    int64_t lastSendUs;    /* CLOCK_MONOTONIC of the last one */
+    int stubGone;          /* routers that see stub 0 withdrawn at exit */
+    int reachable;         /* routers that still reach every other stub */
+} ConvShared;
+
+typedef struct ConvTopo {
+    const char* name;
+    int nodes;
+    int degree[CONV_MAX_NODES];
+    int adj[CONV_MAX_NODES][CONV_MAX_DEGREE];
+} ConvTopo;
+
+static int64_t nowUs(void) {
+    return (int64_t) (nowSec() * 1e6);
+}
+
+static void topoLink(ConvTopo* t, int a, int b) {
+    t->adj[a][t->degree[a]++] = b;
+    t->adj[b][t->degree[b]++] = a;
+}
+
+static void topoBuild(ConvTopo* t, const char* name) {
+    memset(t, 0, sizeof(*t));
+    t->name = name;
+    if (strcmp(name, "grid") == 0) {
+        t->nodes = 16; /* 4x4; 0-1 is an edge link */
+        for (int i = 0; i < 16; i++) {
+            if (i % 4 != 3) topoLink(t, i, i + 1);
+            if (i < 12) topoLink(t, i, i + 4);
+        }
+        return;
+    }
+    t->nodes = 8;
+    for (int i = 0; i + 1 < t->nodes; i++) topoLink(t, i, i + 1);
+    if (strcmp(name, "ring") == 0) topoLink(t, t->nodes - 1, 0);
+}
+
+static uint32_t convRouterIP(int i) { return 0x0A000001u + (uint32_t) i; } /* 10.0.0.i+1 */
+static uint32_t convStubIP(int i)   { return 0x0A010001u + (uint32_t) i; } /* 10.1.0.i+1 */
+
+typedef struct ConvSend {
+    int fd;
+    const struct sockaddr_in* addrs;
+    const int* peerNode;
+    ConvShared* shared;
+} ConvSend;
+
+static void convSendFragment(void* arg, size_t peer, const void* buf, size_t len) {
+    ConvSend* s = (ConvSend*) arg;
+    sendto(s->fd, buf, len, 0, (const struct sockaddr*) &s->addrs[s->peerNode[peer]],
+           sizeof(struct sockaddr_in));
+    __atomic_fetch_add(&s->shared->messages, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->shared->lastSendUs, nowUs(), __ATOMIC_RELAXED);
+}
+
+static void convRouter(const ConvTopo* t, int self, int fd, const struct sockaddr_in* addrs,
+                       DVHorizon horizon, unsigned infinity, ConvShared* shared) {
+    DVPeer peers[CONV_MAX_DEGREE];
+    int peerNode[CONV_MAX_DEGREE];
+    size_t peerCount = 0;
+    for (int k = 0; k < t->degree[self]; k++) {
+        peerNode[peerCount]    = t->adj[self][k];
+        peers[peerCount].ip    = convRouterIP(t->adj[self][k]);
+        peers[peerCount].fmt   = DV_FORMAT_BINARY;
+        peerCount++;
+    }
+    ConvSend send = { fd, addrs, peerNode, shared };
+
+    Router* router = routerCreate(convRouterIP(self));
+    if (!router) _exit(1);
+    distanceSetInfinity(router, infinity);
+    char stub[32], seed[64];
+    ipFormat(convStubIP(self), stub);
+    int seedLen = snprintf(seed, sizeof(seed), "%s:DV:(%s,0)", stub, stub);
+    processDistanceVectorText(router, seed, (size_t) seedLen);
+    distancePublish(router);
+
+    unsigned char buf[DV_MAX_DATAGRAM + 1];
+    int full = 1;
+    for (;;) {
+        if (full || dvPending(router)) {
+            emitDistanceVectorPeers(router, horizon, peers, peerCount, DV_DEFAULT_MTU, full,
+                                    convSendFragment, &send);
+            dvSent(router);
+            full = 0;
+        }
+
+        struct timeval tv = { 0, 20000 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        ssize_t n = recv(fd, buf, DV_MAX_DATAGRAM, 0);
+        if (n <= 0) continue;
+        buf[n] = '\0';
+
+        if (buf[0] != '!') {
+            if (dvIsBinary(buf, (size_t) n)) {
+                processDistanceVectorBinary(router, buf, (size_t) n);
+            } else {
+                processDistanceVectorText(router, (const char*) buf, (size_t) n);
+            }
+            distancePublish(router);
+            continue;
+        }
+
+        /* control from the parent: "!W" withdraw stub, "!C" cut 0-1, "!Q" */
+        if (buf[1] == 'W' && self == 0) {
+            distanceNeighborLost(router, convStubIP(0));
+        } else if (buf[1] == 'C' && (self == 0 || self == 1)) {
+            int other = 1 - self;
+            for (size_t k = 0; k < peerCount; k++) {
+                if (peerNode[k] != other) continue;
+                peers[k]    = peers[--peerCount];
+                peerNode[k] = peerNode[peerCount];
+                break;
+            }
+            distanceNeighborLost(router, convRouterIP(other));
+        } else if (buf[1] == 'Q') {
+            uint32_t via;
+            int dist, reach = 1;
+            if (distanceLookup(router, convStubIP(0), &via, &dist) != 0) {
+                __atomic_fetch_add(&shared->stubGone, 1, __ATOMIC_RELAXED);
+            }
+            for (int i = 1; i < t->nodes; i++) {
+                if (i != self && distanceLookup(router, convStubIP(i), &via, &dist) != 0) {
+                    reach = 0;
+                }
+            }
+            if (reach) __atomic_fetch_add(&shared->reachable, 1, __ATOMIC_RELAXED);
+            routerDestroy(router);
+            _exit(0);
+        }
+    }
+}
+
+/* Wait until no DV was sent for CONV_QUIET_S; seconds from start to the
+   last DV, or -1 if still busy at CONV_CAP_S. */
+static double convWait(ConvShared* shared, int64_t startUs) {
+    for (;;) {
+        usleep(10000);
+        int64_t now  = nowUs();
+        int64_t last = __atomic_load_n(&shared->lastSendUs, __ATOMIC_RELAXED);
+        if (last < startUs) last = startUs;
+        if (now - last >= (int64_t) (CONV_QUIET_S * 1e6)) return (double) (last - startUs) / 1e6;
+        if (now - startUs >= (int64_t) (CONV_CAP_S * 1e6)) return -1.0;
+    }
+}
+
+static void convControl(int fd, const struct sockaddr_in* addrs, int nodes, const char* msg) {
+    for (int i = 0; i < nodes; i++) {
+        sendto(fd, msg, strlen(msg), 0, (const struct sockaddr*) &addrs[i], sizeof(addrs[i]));
+    }
+}
+
+static void convReport(double sec, uint64_t msgs) {
+    if (sec < 0) {
+        fprintf(g_out, " %10s %10llu", "capped", (unsigned long long) msgs);
+    } else {
+        fprintf(g_out, " %10.2f %10llu", sec * 1e3, (unsigned long long) msgs);
+    }
+}
+
+static void benchConvergeOne(const char* topoName, const char* event, DVHorizon horizon,
+                             unsigned infinity) {
+    static const char* const horizonNames[] = { "none", "split", "poison" };
+    ConvTopo t;
+    topoBuild(&t, topoName);
+
+    ConvShared* shared = (ConvShared*) mmap(NULL, sizeof(ConvShared), PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) return;
+    memset(shared, 0, sizeof(*shared));
+
+    int fds[CONV_MAX_NODES];
+    struct sockaddr_in addrs[CONV_MAX_NODES];
+    for (int i = 0; i < t.nodes; i++) {
+        socklen_t len = sizeof(addrs[i]);
+        memset(&addrs[i], 0, sizeof(addrs[i]));
+        addrs[i].sin_family      = AF_INET;
+        addrs[i].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fds[i] = socket(AF_INET, SOCK_DGRAM, 0);
+        int rcvbuf = 4 << 20;
+        setsockopt(fds[i], SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        if (fds[i] < 0 || bind(fds[i], (struct sockaddr*) &addrs[i], sizeof(addrs[i])) < 0 ||
+            getsockname(fds[i], (struct sockaddr*) &addrs[i], &len) < 0) {
+            perror("[ERROR] converge socket");
+            return;
+        }
+    }
+
+    fflush(g_out);
+    pid_t pids[CONV_MAX_NODES];
+    int64_t startUs = nowUs();
+    for (int i = 0; i < t.nodes; i++) {
+        pids[i] = fork();
+        if (pids[i] == 0) convRouter(&t, i, fds[i], addrs, horizon, infinity, shared);
+    }
+
+    int ctl = socket(AF_INET, SOCK_DGRAM, 0);
+    double initSec = convWait(shared, startUs);
+    uint64_t initMsgs = __atomic_load_n(&shared->messages, __ATOMIC_RELAXED);
+
+    startUs = nowUs();
+    convControl(ctl, addrs, t.nodes, event[0] == 'w' ? "!W" : "!C");
+    double evSec = convWait(shared, startUs);
+    uint64_t evMsgs = __atomic_load_n(&shared->messages, __ATOMIC_RELAXED) - initMsgs;
+
+    /* a router still flooded may drop "!Q", so repeat it until all exit */
+    int running = t.nodes;
+    for (int tries = 0; running && tries < 200; tries++) {
+        for (int i = 0; i < t.nodes; i++) {
+            if (pids[i] <= 0) continue;
+            sendto(ctl, "!Q", 2, 0, (const struct sockaddr*) &addrs[i], sizeof(addrs[i]));
+        }
+        usleep(10000);
+        for (int i = 0; i < t.nodes; i++) {
+            if (pids[i] > 0 && waitpid(pids[i], NULL, WNOHANG) == pids[i]) {
+                pids[i] = 0;
+                running--;
+            }
+        }
+    }
+    for (int i = 0; i < t.nodes; i++) {
+        if (pids[i] <= 0) continue;
+        kill(pids[i], SIGKILL);
+        waitpid(pids[i], NULL, 0);
+    }
+    close(ctl);
+    for (int i = 0; i < t.nodes; i++) close(fds[i]);
+
+    fprintf(g_out, "  %-5s %-9s %-7s %6u", topoName, event, horizonNames[horizon], infinity);
+    convReport(initSec, initMsgs);
+    convReport(evSec, evMsgs);
+    /* withdraw: every router must drop the stub; cut: all still reachable */
+    int ok = event[0] == 'w' ? shared->stubGone == t.nodes : shared->reachable == t.nodes;
+    fprintf(g_out, " %7s\n", evSec < 0 ? "-" : ok ? "ok" : "WRONG");
+    munmap(shared, sizeof(*shared));
+}
+
+static void benchConverge(void) {
+    static const char* const topos[] = { "line", "ring", "grid" };
+    static const char* const events[] = { "withdraw", "cut" };
+    fprintf(g_out, "converge: routers in child processes, DVs over 127.0.0.1, "
+                   "quiet %.1f s, cap %.1f s\n", CONV_QUIET_S, CONV_CAP_S);
+    fprintf(g_out, "  %-5s %-9s %-7s %6s %10s %10s %10s %10s %7s\n", "topo", "event",
+            "horizon", "inf", "init ms", "init msgs", "event ms", "event msgs", "tables");
+    for (size_t i = 0; i < sizeof(topos) / sizeof(topos[0]); i++) {
+        for (size_t e = 0; e < sizeof(events) / sizeof(events[0]); e++) {
+            /* cutting a line partitions it */
+            if (i == 0 && e == 1) continue;
+            benchConvergeOne(topos[i], events[e], DV_HORIZON_NONE, DV_DEFAULT_INFINITY);
+            benchConvergeOne(topos[i], events[e], DV_HORIZON_SPLIT, DV_DEFAULT_INFINITY);
+            benchConvergeOne(topos[i], events[e], DV_HORIZON_POISON, DV_DEFAULT_INFINITY);
+            benchConvergeOne(topos[i], events[e], DV_HORIZON_NONE, 16);
+        }
+    }
+}
+
+/******************************************************************************
+ * sim
+ *   The in-process simulator (sim.h) from cold start to settled tables on
+ *   each topology at 10, 100 and 1000 routers: virtual time to converge,
+ *   DV/HELLO datagrams, and CPU per router. Then SIM_THREADS copies of one
+ *   simulation at once, one per thread: routers share no state, so each
+ *   copy must match the serial run exactly.
+ ******************************************************************************/
+#define SIM_THREADS 4
+
+typedef struct SimJob {
+    SimConfig cfg;
+    SimStats stats;
+    int rc;
+} SimJob;
+
+static void* simThread(void* arg) {
+    SimJob* job = (SimJob*) arg;
+    Sim* sim = simCreate(&job->cfg);
+    job->rc = sim ? simRun(sim, &job->stats) : -1;
+    simDestroy(sim);
+    return NULL;
+}
+
+#define SIM_MEASURE_S 600
+
+static int simSameResult(const SimStats* a, const SimStats* b) {
+    return a->settledMs == b->settledMs && a->messages == b->messages &&
+           a->bytes == b->bytes && a->events == b->events &&
+           a->converged == b->converged;
+}
+
+static void benchSimParallel(SimTopology topo, const char* name, unsigned nodes) {
+    SimJob serial, jobs[SIM_THREADS];
+    pthread_t th[SIM_THREADS];
+    simDefaults(&serial.cfg, topo, nodes);
+
+    double t0 = nowSec();
+    simThread(&serial);
+    double serialWall = nowSec() - t0;
+
+    int started = 0;
+    t0 = nowSec();
+    for (int i = 0; i < SIM_THREADS; i++) {
+        jobs[i].cfg = serial.cfg;
+        if (pthread_create(&th[i], NULL, simThread, &jobs[i]) != 0) break;
+        started++;
+    }
+    for (int i = 0; i < started; i++) pthread_join(th[i], NULL);
+    double parallelWall = nowSec() - t0;
+
+    int same = (serial.rc == 0 && started == SIM_THREADS);
+    for (int i = 0; same && i < SIM_THREADS; i++) {
+        same = (jobs[i].rc == 0 && simSameResult(&serial.stats, &jobs[i].stats));
+    }
+    fprintf(g_out, "  %-8s %6u   one: %6.2f s   %d at once: %6.2f s   %s\n",
+            name, serial.stats.nodes, serialWall, SIM_THREADS, parallelWall,
+            same ? "identical" : "DIFFERENT");
+}
+
+static void benchSim(void) {
+    static const char* const topos[] = { "ring", "grid", "random", "fattree" };
+    static const unsigned sizes[] = { 10, 100, 1000 };
+    fprintf(g_out, "sim: cold start to settled tables, 1 ms links, poisoned reverse\n");
+    fprintf(g_out, "  %-8s %6s %6s %10s %10s %10s %12s %12s %8s %6s\n", "topo", "nodes",
+            "links", "settled s", "msgs", "msgs/node", "cpu us/node", "max cpu ms",
+            "wall s", "tables");
+    for (size_t t = 0; t < sizeof(topos) / sizeof(topos[0]); t++) {
+        for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+            SimConfig cfg;
+            SimTopology topo;
+            simTopologyParse(topos[t], &topo);
+            simDefaults(&cfg, topo, sizes[k]);
+
+            double t0 = nowSec();
+            Sim* sim = simCreate(&cfg);
+            SimStats st;
+            if (!sim || simRun(sim, &st) != 0) {
+                fprintf(g_out, "  %-8s %6u failed\n", topos[t], sizes[k]);
+                simDestroy(sim);
+                continue;
+            }
+            double wall = nowSec() - t0;
+            simDestroy(sim);
+
+            fprintf(g_out, "  %-8s %6u %6u %10.3f %10llu %10.1f %12.1f %12.2f %8.2f %6s\n",
+                    topos[t], st.nodes, st.links, (double) st.settledMs / 1e3,
+                    (unsigned long long) st.messages, (double) st.messages / st.nodes,
+                    st.cpuSec / st.nodes * 1e6, st.maxNodeCpuSec * 1e3, wall,
+                    st.converged ? "ok" : "WRONG");
+        }
+    }
+
+    fprintf(g_out, "sim: %d simulations on %d threads vs one, same config and seed\n",
+            SIM_THREADS, SIM_THREADS);
+    benchSimParallel(SIM_TOPO_GRID, "grid", 100);
+    benchSimParallel(SIM_TOPO_RANDOM, "random", 100);
+
+    static const struct { unsigned latencyMs, jitterMs; double loss; } links[] = {
+        { 1, 0, 0.0 }, { 10, 4, 0.0 }, { 10, 4, 0.05 }, { 50, 20, 0.20 },
+    };
+    fprintf(g_out, "sim: HELLO measurements, random 100, %d s, mean over neighbors\n",
+            SIM_MEASURE_S);
+    fprintf(g_out, "  %10s %9s %6s %12s %10s %10s %10s\n", "latency ms", "jitter ms",
+            "loss", "expected rtt", "rtt ms", "jitter ms", "loss");
+    for (size_t i = 0; i < sizeof(links) / sizeof(links[0]); i++) {
+        SimConfig cfg;
+        SimStats st;
+        simDefaults(&cfg, SIM_TOPO_RANDOM, 100);
+        cfg.latencyMs = links[i].latencyMs;
+        cfg.jitterMs  = links[i].jitterMs;
+        cfg.loss      = links[i].loss;
+        cfg.minMs     = SIM_MEASURE_S * 1000;
+        Sim* sim = simCreate(&cfg);
+        if (!sim || simRun(sim, &st) != 0) {
+            fprintf(g_out, "  failed\n");
+            simDestroy(sim);
+            continue;
+        }
+        simDestroy(sim);
+        /* each way: latency plus uniform 0..jitter */
+        double expected = 2.0 * (links[i].latencyMs + links[i].jitterMs / 2.0);
+        fprintf(g_out, "  %10u %9u %5.0f%% %12.1f %10.2f %10.2f %9.1f%%\n",
+                links[i].latencyMs, links[i].jitterMs, links[i].loss * 100.0, expected,
+                st.helloRttMs, st.helloJitterMs, st.helloLoss * 100.0);
+    }
+}
+
+/******************************************************************************
+ * churn
+ *   Router 0's first link flaps every CHURN_FLAP_MS for CHURN_FLAP_S, then
+ *   is left alone. Triggered DVs and messages with the token bucket off
+ *   and at a few rates; "settle" is the time from the last flap to the
+ *   last route change.
+ ******************************************************************************/
+#define CHURN_FLAP_MS 300
+#define CHURN_FLAP_S  60
+
+static void benchChurn(void) {
+    static const struct { unsigned rate, burst; } buckets[] = {
+        { 0, 0 }, { 5, 20 }, { DV_TRIGGER_RATE, DV_TRIGGER_BURST }, { 2, 10 }, { 1, 5 },
+    };
+    static const SimTopology topos[] = { SIM_TOPO_RING, SIM_TOPO_RANDOM };
+    static const char* const names[] = { "ring", "random" };
+    fprintf(g_out, "churn: one link flapping every %d ms for %d s, 100 routers\n",
+            CHURN_FLAP_MS, CHURN_FLAP_S);
+    fprintf(g_out, "  %-8s %8s %12s %10s %10s %8s %9s %8s %6s\n", "topo", "bucket",
+            "triggered", "limited", "msgs", "merged", "settle s", "wall s", "tables");
+    for (size_t t = 0; t < sizeof(topos) / sizeof(topos[0]); t++) {
+        for (size_t b = 0; b < sizeof(buckets) / sizeof(buckets[0]); b++) {
+            SimConfig cfg;
+            SimStats st;
+            simDefaults(&cfg, topos[t], 100);
+            cfg.triggerRate  = buckets[b].rate;
+            cfg.triggerBurst = buckets[b].burst;
+            cfg.flapMs       = CHURN_FLAP_MS;
+            cfg.minMs        = CHURN_FLAP_S * 1000;
+
+            double t0 = nowSec();
+            Sim* sim = simCreate(&cfg);
+            if (!sim || simRun(sim, &st) != 0) {
+                fprintf(g_out, "  %-8s failed\n", names[t]);
+                simDestroy(sim);
+                continue;
+            }
+            double wall = nowSec() - t0;
+            simDestroy(sim);
+
+            char bucket[24];
+            if (buckets[b].rate) {
+                snprintf(bucket, sizeof(bucket), "%u/%u", buckets[b].rate, buckets[b].burst);
+            } else {
+                snprintf(bucket, sizeof(bucket), "off");
+            }
+            double settle = st.settledMs > cfg.minMs ? (double) (st.settledMs - cfg.minMs) / 1e3
+                                                     : 0.0;
+            fprintf(g_out, "  %-8s %8s %12llu %10llu %10llu %7.1f%% %9.3f %8.2f %6s\n",
+                    names[t], bucket, (unsigned long long) st.triggered,
+                    (unsigned long long) st.limited, (unsigned long long) st.messages,
+                    st.updates ? 100.0 * (double) st.merged / (double) st.updates : 0.0,
+                    settle, wall, st.converged ? "ok" : "WRONG");
+        }
+    }
+}
+
+/******************************************************************************
+ * detect
+ *   One router fed HELLOs from n neighbors at their interval on a virtual
+ *   clock stepped by 1 ms, expiring at neighborNextTimeout() as main.c
+ *   does. At DETECT_FAIL_MS every tenth neighbor goes silent.
+ ******************************************************************************/
+#define DETECT_FAIL_MS 5000
+#define DETECT_RUN_MS  (DETECT_FAIL_MS + 20000)
+
+typedef struct DetectRun {
+    uint64_t now;
+    unsigned detected;
+    unsigned falseDown;     /* live neighbors declared down */
+    uint64_t sumMs;
+    uint64_t maxMs;
+} DetectRun;
+
+static uint64_t detectClock(void* ctx) {
+    return ((DetectRun*) ctx)->now;
+}
+
+static void detectLost(Router* router, uint32_t ip) {
+    DetectRun* run = (DetectRun*) router->user;
+    if ((ip & 0xFFFF) % 10 != 0 || run->now < DETECT_FAIL_MS) {
+        run->falseDown++;
+        return;
+    }
+    uint64_t ms = run->now - DETECT_FAIL_MS;
+    run->detected++;
+    run->sumMs += ms;
+    if (ms > run->maxMs) run->maxMs = ms;
+}
+
+static void benchDetectOne(unsigned n, unsigned intervalMs, unsigned mult) {
+    DetectRun run;
+    memset(&run, 0, sizeof(run));
+    Router* r = routerCreate(0x0A000001);
+    if (!r) return;
+    r->clockFn  = detectClock;
+    r->clockCtx = &run;
+    r->user     = &run;
+    neighborSetLossHandler(r, detectLost);
+
+    uint64_t hellos = 0, passes = 0;
+    double helloSec = 0, expirySec = 0;
+    for (run.now = 0; run.now < DETECT_RUN_MS; run.now++) {
+        double t0 = threadCpuSec();
+        uint64_t sent = hellos;
+        for (unsigned i = 0; i < n; i++) {
+            if ((run.now + i * 7) % intervalMs != 0) continue;
+            if (i % 10 == 0 && run.now >= DETECT_FAIL_MS) continue;
+            NeighborHello h;
+            memset(&h, 0, sizeof(h));
+            h.seq        = (unsigned short) ((run.now + i * 7) / intervalMs);
+            h.caps       = NEIGHBOR_LOCAL_CAPS;
+            h.detectMs   = mult ? intervalMs : 0;
+            h.detectMult = mult;
+            neighborProcessHELLO(r, 0, 0x0A010000 + i, &h, NULL);
+            hellos++;
+        }
+        if (hellos != sent) helloSec += threadCpuSec() - t0;
+        neighborPublish(r);
+        double t1 = threadCpuSec();
+        if (neighborNextTimeout(r) <= run.now) {
+            neighborRemoveStale(r);
+            passes++;
+            expirySec += threadCpuSec() - t1;
+        }
+    }
+    routerDestroy(r);
+
+    char detect[32];
+    if (mult) snprintf(detect, sizeof(detect), "%u ms x %u", intervalMs, mult);
+    else      snprintf(detect, sizeof(detect), "%u ms, 10 s", intervalMs);
+    fprintf(g_out, "  %9u %-15s %5u/%-4u %9.1f %9llu %6u %10.0f %8llu %10.1f\n", n, detect,
+            run.detected, (n + 9) / 10,
+            run.detected ? (double) run.sumMs / run.detected : 0.0,
+            (unsigned long long) run.maxMs, run.falseDown,
+            hellos ? helloSec / (double) hellos * 1e9 : 0.0,
+            (unsigned long long) passes, passes ? expirySec / (double) passes * 1e6 : 0.0);
+}
+
+/*
+ * Restart check: each neighbor sends RESTART_HELLOS HELLOs a second apart
+ * starting at seq 2*i, goes quiet for RESTART_GAP_MS (under the 10 s
+ * detect time) and starts again at seq 0. HELLOs 5, 15, ... of each run
+ * are lost, so every entry should show exactly that loss.
+ */
+#define RESTART_NEIGHBORS 100
+#define RESTART_HELLOS    40
+#define RESTART_GAP_MS    2000
+
+static void restartLost(Router* router, uint32_t ip) {
+    (void) ip;
+    ((DetectRun*) router->user)->falseDown++;
+}
+
+static void benchDetectRestart(void) {
+    DetectRun run;
+    memset(&run, 0, sizeof(run));
+    Router* r = routerCreate(0x0A000001);
+    if (!r) return;
+    r->clockFn  = detectClock;
+    r->clockCtx = &run;
+    r->user     = &run;
+    neighborSetLossHandler(r, restartLost);
+
+    uint64_t restartMs = RESTART_HELLOS * 1000 + RESTART_GAP_MS;
+    for (run.now = 0; run.now < 2 * restartMs; run.now++) {
+        uint64_t t = run.now < restartMs ? run.now : run.now - restartMs;
+        for (unsigned i = 0; i < RESTART_NEIGHBORS; i++) {
+            if (t < i || (t - i) % 1000 != 0) continue;
+            unsigned k = (unsigned) ((t - i) / 1000);
+            if (k >= RESTART_HELLOS || k % 10 == 5) continue;
+            NeighborHello h;
+            memset(&h, 0, sizeof(h));
+            h.seq  = (unsigned short) ((run.now < restartMs ? 2 * i : 0) + k);
+            h.caps = NEIGHBOR_LOCAL_CAPS;
+            neighborProcessHELLO(r, 0, 0x0A010000 + i, &h, NULL);
+        }
+        if (neighborNextTimeout(r) <= run.now) neighborRemoveStale(r);
+    }
+    neighborPublish(r);
+
+    size_t count = 0, wrong = 0;
+    double loss = 0;
+    uint32_t wantLost = 2 * (RESTART_HELLOS / 10);
+    NeighborStats* st = neighborGetStats(r, &count);
+    for (size_t i = 0; i < count; i++) {
+        if (st[i].received != 2 * RESTART_HELLOS - wantLost || st[i].lost != wantLost) wrong++;
+        loss += st[i].loss;
+    }
+    free(st);
+    routerDestroy(r);
+
+    fprintf(g_out, "detect: %d neighbors restarting after %d ms (seq back to 0), "
+            "%d of %d HELLOs lost per run\n", RESTART_NEIGHBORS, RESTART_GAP_MS,
+            RESTART_HELLOS / 10, RESTART_HELLOS);
+    fprintf(g_out, "  %9zu entries, %zu with wrong received/lost, %u dropped, "
+            "mean loss %.1f%%  %s\n", count, wrong, run.falseDown,
+            count ? loss / (double) count * 100.0 : 0.0,
+            count == RESTART_NEIGHBORS && !wrong && !run.falseDown ? "ok" : "WRONG");
+}
+
+static void benchDetect(void) {
+    static const struct { unsigned n, intervalMs, mult; } cases[] = {
+        { 100, 5000, 0 },
+        { 100, 50, 3 },
+        { 500, 50, 3 },
+        { 500, 20, 3 },
+        { 500, 10, 5 },
+    };
+    fprintf(g_out, "detect: every tenth neighbor silent at %d s, virtual clock\n",
+            DETECT_FAIL_MS / 1000);
+    fprintf(g_out, "  %9s %-15s %10s %9s %9s %6s %10s %8s %10s\n", "neighbors", "hello/detect",
+            "detected", "mean ms", "max ms", "false", "ns/hello", "passes", "us/pass");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        benchDetectOne(cases[i].n, cases[i].intervalMs, cases[i].mult);
+    }
+    benchDetectRestart();
+}
+
+/******************************************************************************
+ * clock
+ *   Cost of one reading from each time source the routers could use.
+ ******************************************************************************/
+#define CLOCK_READS 10000000
+
+static uint64_t readTimeNull(void) { return (uint64_t) time(NULL); }
+
+static uint64_t readRealtime(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+}
+
+static void benchClock(void) {
+    static const struct {
+        const char* name;
+        uint64_t (*read)(void);
+        const char* note;
+    } sources[] = {
+        { "time(NULL)",         readTimeNull,     "wall clock, 1 s" },
+        { "CLOCK_REALTIME",     readRealtime,     "wall clock, steps with NTP" },
+        { "clockNowMs",         clockNowMs,       "CLOCK_MONOTONIC" },
+        { "clockNowCoarseMs",   clockNowCoarseMs, "coarse path" },
+    };
+    struct timespec res = { 0, 0 };
+#ifdef CLOCK_MONOTONIC_COARSE
+    clock_getres(CLOCK_MONOTONIC_COARSE, &res);
+#endif
+    fprintf(g_out, "clock: %d reads per source, coarse resolution %.3f ms\n",
+            CLOCK_READS, (double) res.tv_sec * 1e3 + (double) res.tv_nsec / 1e6);
+    fprintf(g_out, "  %-18s %10s   %s\n", "source", "ns/read", "clock");
+    for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); i++) {
+        volatile uint64_t sink = 0;
+        double t0 = nowSec();
+        for (int k = 0; k < CLOCK_READS; k++) sink += sources[i].read();
+        double ns = (nowSec() - t0) / CLOCK_READS * 1e9;
+        (void) sink;
+        fprintf(g_out, "  %-18s %10.1f   %s\n", sources[i].name, ns, sources[i].note);
+    }
+}
+
+/******************************************************************************
+ * log
+ *   ns per line: printf as the modules used to, LOG_* formatted
+ *   synchronously (no writer), a line below the runtime level, and queued
+ *   from 1 and LOG_BENCH_THREADS threads. Queued lines go in bursts that
+ *   fit a ring, each followed by a logFlush(): "call" is the burst alone,
+ *   "written" includes formatting and writing. Output is /dev/null.
+ ******************************************************************************/
+#define LOG_BENCH_LINES   1000000
+#define LOG_BENCH_BURST   (LOG_RING_RECORDS / 4)
+#define LOG_BENCH_THREADS 4
+
+static const char* const g_logBenchIp = "10.0.0.1";
+
+typedef struct LogBenchJob {
+    unsigned lines;
+    double callSec;
+} LogBenchJob;
+
+static void* logBenchThread(void* arg) {
+    LogBenchJob* job = (LogBenchJob*) arg;
+    for (unsigned i = 0; i < job->lines; ) {
+        double t0 = nowSec();
+        for (unsigned k = 0; k < LOG_BENCH_BURST && i < job->lines; k++, i++) {
+            LOG_INFO("Link cost to %s %u => %u", g_logBenchIp, i, i + 1);
+        }
+        job->callSec += nowSec() - t0;
+        logFlush();
+    }
+    return NULL;
+}
+
+static void benchLogQueued(int threads) {
+    LogBenchJob jobs[LOG_BENCH_THREADS];
+    pthread_t th[LOG_BENCH_THREADS];
+    logStart();
+    double t0 = nowSec();
+    int started = 0;
+    for (int i = 0; i < threads; i++) {
+        jobs[i].lines   = LOG_BENCH_LINES / (unsigned) threads;
+        jobs[i].callSec = 0.0;
+        if (pthread_create(&th[i], NULL, logBenchThread, &jobs[i]) != 0) break;
+        started++;
+    }
+    double callSec = 0.0;
+    uint64_t lines = 0;
+    for (int i = 0; i < started; i++) {
+        pthread_join(th[i], NULL);
+        callSec += jobs[i].callSec;
+        lines   += jobs[i].lines;
+    }
+    logStop();
+    double total = nowSec() - t0;
+    char name[32];
+    snprintf(name, sizeof(name), "queued, %d thread(s)", threads);
+    fprintf(g_out, "  %-22s %10.1f %10.1f %10llu\n", name, callSec / (double) lines * 1e9,
+            total / (double) lines * 1e9, (unsigned long long) logDropped());
+}
+
+static void benchLog(void) {
+    fprintf(g_out, "log: %d lines like \"Link cost to %%s %%u => %%u\", ns per line\n",
+            LOG_BENCH_LINES);
+    fprintf(g_out, "  %-22s %10s %10s %10s\n", "", "call", "written", "dropped");
+
+    double t0 = nowSec();
+    for (unsigned i = 0; i < LOG_BENCH_LINES; i++) {
+        printf("[INFO] Link cost to %s %u => %u\n", g_logBenchIp, i, i + 1);
+    }
+    fflush(stdout);
+    double ns = (nowSec() - t0) / LOG_BENCH_LINES * 1e9;
+    fprintf(g_out, "  %-22s %10.1f %10.1f %10d\n", "printf", ns, ns, 0);
+
+    t0 = nowSec();
+    for (unsigned i = 0; i < LOG_BENCH_LINES; i++) {
+        LOG_INFO("Link cost to %s %u => %u", g_logBenchIp, i, i + 1);
+    }
+    fflush(stdout);
+    ns = (nowSec() - t0) / LOG_BENCH_LINES * 1e9;
+    fprintf(g_out, "  %-22s %10.1f %10.1f %10d\n", "LOG_INFO, no writer", ns, ns, 0);
+
+    t0 = nowSec();
+    for (unsigned i = 0; i < LOG_BENCH_LINES; i++) {
+        LOG_DEBUG("Link cost to %s %u => %u", g_logBenchIp, i, i + 1);
+    }
+    ns = (nowSec() - t0) / LOG_BENCH_LINES * 1e9;
+    fprintf(g_out, "  %-22s %10.1f %10s %10s\n", "LOG_DEBUG, level info", ns, "-", "-");
+
+    benchLogQueued(1);
+    benchLogQueued(LOG_BENCH_THREADS);
+}
+
+/******************************************************************************
+ * main
+ ******************************************************************************/
+typedef struct Bench {
+    const char* name;
+    void (*run)(void);
+} Bench;
+
+static const Bench g_benches[] = {
+    { "routes",   benchRoutes },
+    { "codec",    benchCodec },
+    { "recv",     benchRecv },
+    { "snapshot", benchSnapshot },
+    { "slab",     benchSlab },
+    { "parse",    benchParse },
+    { "converge", benchConverge },
+    { "sim",      benchSim },
+    { "churn",    benchChurn },
+    { "detect",   benchDetect },
+    { "clock",    benchClock },
+    { "log",      benchLog },
+};
+
+int main(int argc, char* argv[]) {
+    const char* only = (argc > 1) ? argv[1] : NULL;
+    int ran = 0;
+
+    benchSilence();
+    for (size_t i = 0; i < sizeof(g_benches) / sizeof(g_benches[0]); i++) {
+        if (only && strcmp(only, g_benches[i].name) != 0) continue;
+        g_benches[i].run();
+        ran++;
+    }
+    if (!ran) {
+        fprintf(stderr, "[ERROR] unknown benchmark: %s\n", only);
+        return 1;
+    }
+    return 0;
+}
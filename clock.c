@@ -0,0 +1,87 @@
+/******************************************************************************
+ * File: clock.c
+ *
+ * CLOCK_MONOTONIC by default; clockSetSource() swaps in another one.
+ * The coarse clock is checked once (clock_getres()) and used only when it
+ * exists and is fine enough, else clockNowCoarseMs() reads the precise
+ * one.
+ ******************************************************************************/
+
+#include "clock.h"
+#include <stddef.h>
+
+#define CLOCK_COARSE_MAX_RES_NS 10000000L /* coarser => use CLOCK_MONOTONIC */
+
+static ClockFn g_clockFn = NULL;
+static void* g_clockCtx = NULL;
+static int g_coarseId = -1; /* clockid_t for the coarse path, -1 => not probed */
+static unsigned g_coarseResMs = 0; /* its resolution, rounded up; set before g_coarseId */
+
+/******************************************************************************
+ * readMs
+ ******************************************************************************/
+static inline uint64_t readMs(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+}
+
+/******************************************************************************
+ * coarseClock
+ *   Probed on first use; threads racing here store the same answer.
+ ******************************************************************************/
+static clockid_t coarseClock(void) {
+    int id = __atomic_load_n(&g_coarseId, __ATOMIC_ACQUIRE);
+    if (id >= 0) return (clockid_t) id;
+
+    id = CLOCK_MONOTONIC;
+#ifdef CLOCK_MONOTONIC_COARSE
+    struct timespec res;
+    if (clock_getres(CLOCK_MONOTONIC_COARSE, &res) == 0 && res.tv_sec == 0 &&
+        res.tv_nsec <= CLOCK_COARSE_MAX_RES_NS) {
+        id = CLOCK_MONOTONIC_COARSE;
+        __atomic_store_n(&g_coarseResMs, (unsigned) ((res.tv_nsec + 999999) / 1000000),
+                         __ATOMIC_RELAXED);
+    }
+#endif
+    __atomic_store_n(&g_coarseId, id, __ATOMIC_RELEASE);
+    return (clockid_t) id;
+}
+
+/******************************************************************************
+ * clockNowMs
+ ******************************************************************************/
+uint64_t clockNowMs(void) {
+    return g_clockFn ? g_clockFn(g_clockCtx) : readMs(CLOCK_MONOTONIC);
+}
+
+/******************************************************************************
+ * clockNowCoarseMs
+ ******************************************************************************/
+uint64_t clockNowCoarseMs(void) {
+    return g_clockFn ? g_clockFn(g_clockCtx) : readMs(coarseClock());
+}
+
+/******************************************************************************
+ * clockCoarseResMs
+ ******************************************************************************/
+unsigned clockCoarseResMs(void) {
+    if (g_clockFn) return 0;
+    coarseClock();
+    return __atomic_load_n(&g_coarseResMs, __ATOMIC_RELAXED);
+}
+
+/******************************************************************************
+ * clockNowSec
+ ******************************************************************************/
+time_t clockNowSec(void) {
+    return (time_t) (clockNowMs() / 1000);
+}
+
+/******************************************************************************
+ * clockSetSource
+ ******************************************************************************/
+void clockSetSource(ClockFn fn, void* ctx) {
+    g_clockCtx = ctx;
+    g_clockFn  = fn;
+}
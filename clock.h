@@ -0,0 +1,71 @@
+/******************************************************************************
+ * File: clock.h
+ *
+ * Time source for the routing modules.
+ *
+ *   - clockNowMs()        -> milliseconds on CLOCK_MONOTONIC unless replaced
+ *   - clockNowCoarseMs()  -> the same from the cheaper coarse clock, for
+ *                            timeouts that tolerate a tick of lag
+ *   - clockCoarseResMs()  -> how far behind clockNowCoarseMs() may be
+ *   - clockNowSec()       -> clockNowMs() in whole seconds (time_t)
+ *   - clockSetSource()    -> replace the process-wide source; NULL restores
+ *                            the system clock
+ *
+ * The system clock is monotonic: it does not jump when the wall clock is
+ * set, so an NTP step neither expires every neighbor at once nor keeps a
+ * dead one alive. Its epoch is arbitrary (boot), so values only mean
+ * something relative to each other.
+ *
+ * A Router (router.h) reads this clock unless it was given its own, as
+ * the simulator's routers are (sim.h).
+ ******************************************************************************/
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Returns the current time in ms. */
+typedef uint64_t (*ClockFn)(void* ctx);
+
+/**
+ * @brief Current time in milliseconds from the active source.
+ */
+uint64_t clockNowMs(void);
+
+/**
+ * @brief clockNowMs() from CLOCK_MONOTONIC_COARSE when the kernel has it
+ *        at 10 ms resolution or better: no counter read, but up to that
+ *        resolution behind, never ahead. Same as clockNowMs() when the
+ *        source was replaced.
+ */
+uint64_t clockNowCoarseMs(void);
+
+/**
+ * @brief Resolution of clockNowCoarseMs() in ms, rounded up: it may be
+ *        that far behind clockNowMs(). 0 when it reads the precise clock
+ *        or the source was replaced.
+ */
+unsigned clockCoarseResMs(void);
+
+/**
+ * @brief Current time in whole seconds from the active source.
+ */
+time_t clockNowSec(void);
+
+/**
+ * @brief Take time from fn(ctx) from now on; fn == NULL => system clock.
+ *        Set it before other threads start reading the clock.
+ */
+void clockSetSource(ClockFn fn, void* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CLOCK_H */
@@ -11,69 +11,606 @@
  *
  * The DV format is:
  *   "senderIP:DV:(dest1,dist1):(dest2,dist2):...:"
- * We'll store routes in a linked list: (dest, viaNeighbor, distance).
+ * We'll store routes in a hash table keyed on (dest, viaNeighbor).
  * If table changes => dvUpdate() => updatedDV=1
  * After broadcasting => dvSent() => updatedDV=0
+ *
+ * Destinations whose best route changed are queued in a dirty list; a DV
+ * carries only those (delta), a full snapshot carries every reachable one.
+ *
+ * Metrics: a route's metric is the advertised one plus the cost of the
+ * link to the neighbor (distanceSetLinkCost), held as a 16-bit DVMetric.
+ * Sums saturate at the router's infinity (distanceSetInfinity, default
+ * DV_DEFAULT_INFINITY); a metric at infinity means unreachable, and goes
+ * out as DV_INFINITY, what legacy ASCII peers take as unreachable (binary
+ * DVs clamp it to DVB_METRIC_INF). Received metrics at or above our
+ * infinity are unreachable too.
+ *
+ * Withdrawal: when a neighbor is lost (distanceNeighborLost) its routes go
+ * to infinity. A destination whose best is infinite is still advertised,
+ * with DV_INFINITY, until distanceGarbageCollect() drops its routes
+ * DV_ROUTE_HOLD_MS later, so neighbors hear the withdrawal instead of
+ * counting to infinity. Each route going to infinity arms a HoldTimer in
+ * a timer wheel (timerwheel.h), so collecting costs O(expired) instead
+ * of a pass over the table. The timer names the route by key and by the
+ * heldSince it was armed for and is not cancelled when the route comes
+ * back: one that no longer matches a held route just frees itself.
+ *
+ * Per-neighbor DVs (emitDistanceVectorPeers) apply split horizon or
+ * poisoned reverse using each destination's best viaNeighbor: a route is
+ * not advertised (split) or advertised as DV_INFINITY (poison) back to the
+ * neighbor it was learned from. Split horizon still poisons in deltas: a
+ * destination that just moved onto that neighbor may have been advertised
+ * to it before, and routes only expire with the neighbor.
+ *
+ * All of it lives in the Router's DistanceState (router.h); nothing is
+ * shared between instances. Times come from the Router's coarse clock
+ * (routerNowCoarseMs()): they only time the hold.
+ *
+ * Threading: the mutable tables are owned by writers serialized on the lock
+ * (receiver applying DVs, sender taking the dirty set). Readers (full DV,
+ * getDistanceVector, distanceLookup, printDistanceTable) never lock: they
+ * use the immutable RouteSnapshot last published by distancePublish(),
+ * which the receiver calls once per batch. Old snapshots are freed through
+ * rcu.h once no reader can still hold them.
  ******************************************************************************/
 
 #include "distance.h"
+#include "dvcodec.h"
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "clock.h"
+#include "ipaddr.h"
+#include "log.h"
+#include "rcu.h"
+#include "slab.h"
+#include "timerwheel.h"
 
-#define IP_STR_LEN 32
+#define ROUTE_TABLE_INIT_CAP 64   /* must be a power of two */
+#define DEST_INDEX_INIT_CAP  64   /* must be a power of two */
+#define ROUTES_PER_SLAB      256
+#define DV_INFINITY          999999 /* unreachable on the wire */
+#define DV_SEQ_REORDER_WINDOW 64  /* older fragments within this are stale */
+#define DV_ROUTE_HOLD_MS     60000 /* advertise a withdrawn route this long */
+#define DV_TIMER_TICK_MS     10
+#define HOLD_TIMERS_PER_SLAB 64
 
 typedef struct Route {
-    char destIP[IP_STR_LEN];
-    char viaNeighbor[IP_STR_LEN];
-    int distance;
-    struct Route* next;
+    uint32_t destIP;        /* (destIP, viaNeighbor) => hash key */
+    uint32_t viaNeighbor;
+    DVMetric distance;
+    uint32_t heldSince;     /* when distance became infinite (ms, never 0),
+                               0 => finite */
+    struct Route* nextSameDest; /* chain of all routes to destIP */
 } Route;
 
-static Route* g_routes = NULL; /* Head of route list */
-int updatedDV = 0;
+/*
+ * Open-addressing hash table of Route* keyed on the binary (dest, via) pair.
+ * Linear probing, grown at 70% load.
+ */
+typedef struct RouteTable {
+    Route** slots;
+    size_t capacity;
+    size_t count;
+} RouteTable;
+
+/*
+ * Destination index: one entry per destIP holding the current best
+ * (distance, via) and the chain of candidate routes. Kept up to date by
+ * destRouteChanged() so getDistanceVector() is a single pass over it.
+ */
+typedef struct DestEntry {
+    uint32_t destIP;
+    uint32_t bestVia;
+    DVMetric bestDist;  /* infinity => unreachable, advertised as such
+                           until its routes are garbage-collected */
+    int dirty;          /* best changed since last dvSent() => in the dirty list */
+    Route* routes;      /* NULL => empty slot */
+} DestEntry;
+
+typedef struct DestIndex {
+    DestEntry* slots;
+    size_t capacity;
+    size_t count;
+} DestIndex;
+
+/*
+ * Immutable copy of the tables for lock-free readers, one allocation.
+ */
+typedef struct SnapRoute {
+    uint32_t destIP;
+    uint32_t viaNeighbor;
+    DVMetric distance;
+} SnapRoute;
+
+typedef struct RouteSnapshot {
+    size_t destCount;   /* destinations, withdrawn ones at DV_INFINITY */
+    DVEntry* entries;   /* (dest, bestDist), a full DV as-is: unreachable
+                           ones at DV_INFINITY */
+    uint32_t* vias;     /* best next hop, parallel to entries */
+    uint32_t* index;    /* dest hash => entries slot + 1, 0 => empty */
+    size_t indexMask;
+    size_t routeCount;
+    SnapRoute* routes;  /* every candidate route, for printing */
+} RouteSnapshot;
+
+/*
+ * Hold time of one route, armed when it went to infinity (holdRoute()).
+ */
+typedef struct HoldTimer {
+    TimerNode node;
+    uint32_t destIP;
+    uint32_t viaNeighbor;
+    uint32_t heldSince;     /* the route's heldSince it was armed for */
+} HoldTimer;
+
+/*
+ * Last DV sequence number seen per sender, so a fragment of an older DV that
+ * arrives after a newer one doesn't roll routes back.
+ */
+typedef struct PeerSeq {
+    uint32_t sender;
+    uint16_t lastSeq;
+    uint16_t fragsSeen;  /* fragments of lastSeq received */
+    uint16_t fragCount;  /* fragments lastSeq was split into */
+} PeerSeq;
+
+/* Cost of the link to a neighbor, added to the metrics it advertises. */
+typedef struct LinkCost {
+    uint32_t via;
+    unsigned cost;
+} LinkCost;
+
+/* Our DV sequence number per unicast peer (emitDistanceVectorPeers). */
+typedef struct TxSeq {
+    uint32_t peer;
+    uint16_t seq;
+} TxSeq;
+
+/* A router's distance tables and DV state (Router.dv). */
+struct DistanceState {
+    pthread_mutex_t lock;
+    RouteTable routes;
+    DestIndex dests;
+    SlabPool routePool;
+    TimerWheel holdWheel;      /* HoldTimers, from holdTimerPool */
+    SlabPool holdTimerPool;
+    RouteSnapshot* snapshot;   /* published, read under rcuReadLock() */
+    int snapshotStale;         /* tables changed since publish */
+    int updatedDV;             /* accessed with __atomic builtins */
+    DVMetric infinity;         /* metrics >= it are unreachable */
+
+    uint16_t dvSeq;            /* sequence number of our next DV */
+
+    /* Destinations whose best route changed since the last dvSent(). */
+    uint32_t* dirty;
+    size_t dirtyCount;
+    size_t dirtyCap;
+    int fullRequested;         /* first DV is always a full snapshot */
+
+    void (*gapHandler)(Router* router, uint32_t sender);
+    int notifyFd;              /* eventfd written when updatedDV goes 0 -> 1 */
+    uint64_t updates;          /* DVUpdateStats, __atomic builtins */
+    uint64_t merged;
+
+    PeerSeq* peerSeqs;
+    size_t peerSeqCount;
+    size_t peerSeqCap;
 
-static char g_myIP[IP_STR_LEN] = "0.0.0.0"; /* store sender IP */
+    LinkCost* linkCosts;       /* neighbors not listed cost ROUTER_DEFAULT_COST */
+    size_t linkCostCount;
+    size_t linkCostCap;
+
+    TxSeq* txSeqs;             /* sender thread only */
+    size_t txSeqCount;
+    size_t txSeqCap;
+};
 
 /******************************************************************************
- * Utility: findRoute or create
+ * Utility: hashing
+ ******************************************************************************/
+static inline size_t routeHash(uint32_t dest, uint32_t via) {
+    /* 64-bit finalizer (murmur3 fmix64) over the packed pair */
+    uint64_t k = ((uint64_t)dest << 32) | via;
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return (size_t) k;
+}
+
+static int routeTableGrow(DistanceState* d) {
+    size_t newCap = d->routes.capacity ? d->routes.capacity * 2 : ROUTE_TABLE_INIT_CAP;
+    Route** slots = (Route**) calloc(newCap, sizeof(Route*));
+    if (!slots) {
+        LOG_ERROR("Out of memory growing route table.");
+        return -1;
+    }
+    for (size_t i = 0; i < d->routes.capacity; i++) {
+        Route* r = d->routes.slots[i];
+        if (!r) continue;
+        size_t j = routeHash(r->destIP, r->viaNeighbor) & (newCap - 1);
+        while (slots[j]) j = (j + 1) & (newCap - 1);
+        slots[j] = r;
+    }
+    free(d->routes.slots);
+    d->routes.slots    = slots;
+    d->routes.capacity = newCap;
+    return 0;
+}
+
+/******************************************************************************
+ * Destination index
  ******************************************************************************/
-static Route* findRoute(const char* dest, const char* via) {
-    for (Route* r = g_routes; r; r = r->next) {
-        if (strcmp(r->destIP, dest) == 0 &&
-            strcmp(r->viaNeighbor, via) == 0) {
-            return r;
+static inline size_t destHash(uint32_t dest) {
+    uint32_t k = dest;
+    k ^= k >> 16;
+    k *= 0x7feb352dU;
+    k ^= k >> 15;
+    k *= 0x846ca68bU;
+    k ^= k >> 16;
+    return (size_t) k;
+}
+
+static int destIndexGrow(DistanceState* d) {
+    size_t newCap = d->dests.capacity ? d->dests.capacity * 2 : DEST_INDEX_INIT_CAP;
+    DestEntry* slots = (DestEntry*) calloc(newCap, sizeof(DestEntry));
+    if (!slots) {
+        LOG_ERROR("Out of memory growing destination index.");
+        return -1;
+    }
+    for (size_t i = 0; i < d->dests.capacity; i++) {
+        DestEntry* e = &d->dests.slots[i];
+        if (!e->routes) continue;
+        size_t j = destHash(e->destIP) & (newCap - 1);
+        while (slots[j].routes) j = (j + 1) & (newCap - 1);
+        slots[j] = *e;
+    }
+    free(d->dests.slots);
+    d->dests.slots    = slots;
+    d->dests.capacity = newCap;
+    return 0;
+}
+
+static DestEntry* findDest(DistanceState* d, uint32_t dest) {
+    if (!d->dests.capacity) return NULL;
+    size_t mask = d->dests.capacity - 1;
+    for (size_t i = destHash(dest) & mask; d->dests.slots[i].routes; i = (i + 1) & mask) {
+        if (d->dests.slots[i].destIP == dest) {
+            return &d->dests.slots[i];
         }
     }
     return NULL;
 }
 
-static Route* createRoute(const char* dest, const char* via, int dist) {
-    Route* r = (Route*) malloc(sizeof(Route));
+/* Backward-shift delete of dests.slots[i]; no tombstones. */
+static void destIndexRemoveAt(DistanceState* d, size_t i) {
+    size_t mask = d->dests.capacity - 1;
+    size_t hole = i;
+    d->dests.slots[i].routes = NULL;
+    d->dests.count--;
+    for (size_t j = (i + 1) & mask; d->dests.slots[j].routes; j = (j + 1) & mask) {
+        size_t home = destHash(d->dests.slots[j].destIP) & mask;
+        /* move j into the hole unless its home lies in (hole, j] */
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            d->dests.slots[hole] = d->dests.slots[j];
+            d->dests.slots[j].routes = NULL;
+            hole = j;
+        }
+    }
+}
+
+/* Queue e for the next delta DV. */
+static void markDirty(DistanceState* d, DestEntry* e) {
+    if (e->dirty) return;
+    if (d->dirtyCount == d->dirtyCap) {
+        size_t newCap = d->dirtyCap ? d->dirtyCap * 2 : 64;
+        uint32_t* grown = (uint32_t*) realloc(d->dirty, newCap * sizeof(uint32_t));
+        if (!grown) {
+            /* can't track it => make the next DV a full one */
+            d->fullRequested = 1;
+            return;
+        }
+        d->dirty    = grown;
+        d->dirtyCap = newCap;
+    }
+    d->dirty[d->dirtyCount++] = e->destIP;
+    e->dirty = 1;
+}
+
+/* Link a freshly created route into its destination entry. */
+static int destAddRoute(DistanceState* d, Route* r) {
+    DestEntry* e = findDest(d, r->destIP);
+    if (!e) {
+        if ((d->dests.count + 1) * 10 > d->dests.capacity * 7) {
+            if (destIndexGrow(d) != 0) return -1;
+        }
+        size_t mask = d->dests.capacity - 1;
+        size_t i = destHash(r->destIP) & mask;
+        while (d->dests.slots[i].routes) i = (i + 1) & mask;
+        e = &d->dests.slots[i];
+        e->destIP   = r->destIP;
+        e->bestVia  = 0;
+        e->bestDist = d->infinity;
+        e->dirty    = 0;
+        e->routes   = NULL;
+        d->dests.count++;
+    }
+    r->nextSameDest = e->routes;
+    e->routes = r;
+    if (r->distance < e->bestDist) {
+        e->bestDist = r->distance;
+        e->bestVia  = r->viaNeighbor;
+        markDirty(d, e);
+    }
+    return 0;
+}
+
+/* Re-evaluate the best route after r->distance changed. */
+static void destRouteChanged(DistanceState* d, const Route* r) {
+    DestEntry* e = findDest(d, r->destIP);
+    if (!e) return;
+
+    DVMetric oldDist = e->bestDist;
+    uint32_t oldVia = e->bestVia;
+    if (r->distance < e->bestDist) {
+        e->bestDist = r->distance;
+        e->bestVia  = r->viaNeighbor;
+    } else if (r->viaNeighbor == e->bestVia && r->distance != e->bestDist) {
+        /* current best got worse => rescan this destination's routes */
+        e->bestDist = d->infinity;
+        e->bestVia  = 0;
+        for (const Route* c = e->routes; c; c = c->nextSameDest) {
+            if (c->distance < e->bestDist) {
+                e->bestDist = c->distance;
+                e->bestVia  = c->viaNeighbor;
+            }
+        }
+    }
+    if (e->bestDist != oldDist || e->bestVia != oldVia) {
+        markDirty(d, e);
+    }
+}
+
+/******************************************************************************
+ * Utility: metrics
+ ******************************************************************************/
+/* metric + cost, saturating at inf; metric may be any received value. */
+static inline DVMetric metricAdd(uint32_t metric, unsigned cost, DVMetric inf) {
+    if (metric >= inf || cost >= (unsigned) (inf - metric)) return inf;
+    return (DVMetric) (metric + cost);
+}
+
+/* What a DV carries for dist. */
+static inline uint32_t metricToWire(const DistanceState* d, DVMetric dist) {
+    return dist >= d->infinity ? DV_INFINITY : dist;
+}
+
+/******************************************************************************
+ * Utility: findRoute or create
+ ******************************************************************************/
+static size_t findRouteSlot(DistanceState* d, uint32_t dest, uint32_t via) {
+    if (!d->routes.capacity) return SIZE_MAX;
+    size_t mask = d->routes.capacity - 1;
+    for (size_t i = routeHash(dest, via) & mask; d->routes.slots[i]; i = (i + 1) & mask) {
+        Route* r = d->routes.slots[i];
+        if (r->destIP == dest && r->viaNeighbor == via) {
+            return i;
+        }
+    }
+    return SIZE_MAX;
+}
+
+static Route* findRoute(DistanceState* d, uint32_t dest, uint32_t via) {
+    size_t i = findRouteSlot(d, dest, via);
+    return i == SIZE_MAX ? NULL : d->routes.slots[i];
+}
+
+/******************************************************************************
+ * holdRoute
+ *   r just went to infinity at nowMs: stamp it and arm its hold timer.
+ ******************************************************************************/
+static void holdRoute(DistanceState* d, Route* r, uint64_t nowMs) {
+    r->heldSince = (uint32_t) nowMs ? (uint32_t) nowMs : 1;
+    HoldTimer* h = (HoldTimer*) slabAlloc(&d->holdTimerPool);
+    if (!h) {
+        /* the route stays held until it is withdrawn again or comes back */
+        LOG_ERROR("Out of memory arming a route hold timer.");
+        return;
+    }
+    memset(&h->node, 0, sizeof(h->node));
+    h->destIP      = r->destIP;
+    h->viaNeighbor = r->viaNeighbor;
+    h->heldSince   = r->heldSince;
+    timerSchedule(&d->holdWheel, &h->node, nowMs, nowMs + DV_ROUTE_HOLD_MS);
+}
+
+static Route* createRoute(DistanceState* d, uint32_t dest, uint32_t via, DVMetric dist,
+                          uint64_t now) {
+    if ((d->routes.count + 1) * 10 > d->routes.capacity * 7) {
+        if (routeTableGrow(d) != 0) return NULL;
+    }
+    Route* r = (Route*) slabAlloc(&d->routePool);
     if (!r) {
-        fprintf(stderr, "[ERROR] Out of memory in createRoute.\n");
+        LOG_ERROR("Out of memory in createRoute.");
         return NULL;
     }
-    strncpy(r->destIP, dest, IP_STR_LEN - 1);
-    r->destIP[IP_STR_LEN - 1] = '\0';
-    strncpy(r->viaNeighbor, via, IP_STR_LEN - 1);
-    r->viaNeighbor[IP_STR_LEN - 1] = '\0';
-    r->distance = dist;
-    r->next = g_routes;
-    g_routes = r;
+    r->destIP      = dest;
+    r->viaNeighbor = via;
+    r->distance    = dist;
+    r->heldSince   = 0;
+    if (destAddRoute(d, r) != 0) {
+        slabFree(&d->routePool, r);
+        return NULL;
+    }
+
+    size_t mask = d->routes.capacity - 1;
+    size_t i = routeHash(dest, via) & mask;
+    while (d->routes.slots[i]) i = (i + 1) & mask;
+    d->routes.slots[i] = r;
+    d->routes.count++;
+    if (dist >= d->infinity) holdRoute(d, r, now);
     return r;
 }
 
-static int findBestDistance(const char* dest) {
-    int best = 999999;
-    for (Route* r = g_routes; r; r = r->next) {
-        if (strcmp(r->destIP, dest) == 0) {
-            if (r->distance < best) {
-                best = r->distance;
-            }
+/******************************************************************************
+ * setRouteDistance
+ *   Change r->distance, track the hold timer and re-evaluate the best route.
+ ******************************************************************************/
+static void setRouteDistance(DistanceState* d, Route* r, DVMetric dist, uint64_t now) {
+    r->distance = dist;
+    if (dist < d->infinity) {
+        r->heldSince = 0;
+    } else if (!r->heldSince) {
+        holdRoute(d, r, now);
+    }
+    destRouteChanged(d, r);
+}
+
+/******************************************************************************
+ * removeRouteAt
+ *   Drop routes.slots[i]: backward-shift delete from the route table,
+ *   unlink from its destination (dropping that too when it was the last
+ *   route) and return it to the pool.
+ ******************************************************************************/
+static void removeRouteAt(DistanceState* d, size_t i) {
+    Route* r = d->routes.slots[i];
+    size_t mask = d->routes.capacity - 1;
+    size_t hole = i;
+    d->routes.slots[i] = NULL;
+    d->routes.count--;
+    for (size_t j = (i + 1) & mask; d->routes.slots[j]; j = (j + 1) & mask) {
+        Route* next = d->routes.slots[j];
+        size_t home = routeHash(next->destIP, next->viaNeighbor) & mask;
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            d->routes.slots[hole] = next;
+            d->routes.slots[j] = NULL;
+            hole = j;
         }
     }
-    return best;
+
+    DestEntry* e = findDest(d, r->destIP);
+    if (e) {
+        Route** pp = &e->routes;
+        while (*pp && *pp != r) pp = &(*pp)->nextSameDest;
+        if (*pp) *pp = r->nextSameDest;
+        if (!e->routes) destIndexRemoveAt(d, (size_t)(e - d->dests.slots));
+    }
+    slabFree(&d->routePool, r);
+}
+
+/******************************************************************************
+ * buildSnapshot
+ *   Copy the current tables into a fresh RouteSnapshot. Caller holds the lock.
+ ******************************************************************************/
+static RouteSnapshot* buildSnapshot(DistanceState* d) {
+    size_t reachable = 0;
+    for (size_t i = 0; i < d->dests.capacity; i++) {
+        if (d->dests.slots[i].routes) reachable++;
+    }
+    size_t indexCap = 16;
+    while (indexCap < reachable * 2) indexCap *= 2;
+
+    size_t size = sizeof(RouteSnapshot)
+                + reachable * sizeof(DVEntry)
+                + d->routes.count * sizeof(SnapRoute)
+                + reachable * sizeof(uint32_t)
+                + indexCap * sizeof(uint32_t);
+    RouteSnapshot* s = (RouteSnapshot*) malloc(size);
+    if (!s) {
+        LOG_ERROR("Out of memory building route snapshot.");
+        return NULL;
+    }
+    s->entries   = (DVEntry*) (s + 1);
+    s->routes    = (SnapRoute*) (s->entries + reachable);
+    s->vias      = (uint32_t*) (s->routes + d->routes.count);
+    s->index     = s->vias + reachable;
+    s->indexMask = indexCap - 1;
+    memset(s->index, 0, indexCap * sizeof(uint32_t));
+
+    size_t n = 0;
+    for (size_t i = 0; i < d->dests.capacity; i++) {
+        const DestEntry* e = &d->dests.slots[i];
+        if (!e->routes) continue;
+        s->entries[n].dest   = e->destIP;
+        s->entries[n].metric = metricToWire(d, e->bestDist);
+        s->vias[n]           = e->bestVia;
+        size_t j = destHash(e->destIP) & s->indexMask;
+        while (s->index[j]) j = (j + 1) & s->indexMask;
+        s->index[j] = (uint32_t) (n + 1);
+        n++;
+    }
+    s->destCount = n;
+
+    size_t r = 0;
+    for (size_t i = 0; i < d->routes.capacity; i++) {
+        const Route* rt = d->routes.slots[i];
+        if (!rt) continue;
+        s->routes[r].destIP      = rt->destIP;
+        s->routes[r].viaNeighbor = rt->viaNeighbor;
+        s->routes[r].distance    = rt->distance;
+        r++;
+    }
+    s->routeCount = r;
+    return s;
+}
+
+/******************************************************************************
+ * publishLocked
+ *   Swap in a new snapshot if the tables changed. Caller holds the lock.
+ ******************************************************************************/
+static void publishLocked(DistanceState* d) {
+    if (!d->snapshotStale) return;
+    RouteSnapshot* s = buildSnapshot(d);
+    if (!s) return; /* readers keep the old one, retry next publish */
+    RouteSnapshot* old = __atomic_exchange_n(&d->snapshot, s, __ATOMIC_SEQ_CST);
+    rcuRetire(old, free);
+    d->snapshotStale = 0;
+}
+
+/* Current snapshot; call between rcuReadLock() and rcuReadUnlock(). */
+static const RouteSnapshot* readSnapshot(DistanceState* d) {
+    return __atomic_load_n(&d->snapshot, __ATOMIC_ACQUIRE);
+}
+
+/******************************************************************************
+ * collectDelta
+ *   Current best for every destination in the dirty list, unreachable ones with
+ *   DV_INFINITY so neighbors drop them, into *out and the best next hops
+ *   into *vias (one allocation, caller frees *out), then empties the dirty list.
+ *   Caller holds the lock.
+ *   Returns 0 on success, -1 on allocation failure.
+ ******************************************************************************/
+static int collectDelta(DistanceState* d, DVEntry** out, uint32_t** vias, size_t* n) {
+    DVEntry* entries = (DVEntry*) malloc((d->dirtyCount + 1) *
+                                         (sizeof(DVEntry) + sizeof(uint32_t)));
+    if (!entries) {
+        LOG_ERROR("Out of memory building DV.");
+        return -1;
+    }
+    uint32_t* via = (uint32_t*) (entries + d->dirtyCount + 1);
+    size_t count = 0;
+    for (size_t i = 0; i < d->dirtyCount; i++) {
+        DestEntry* e = findDest(d, d->dirty[i]);
+        if (!e) continue;
+        entries[count].dest   = e->destIP;
+        entries[count].metric = metricToWire(d, e->bestDist);
+        via[count]            = e->bestVia;
+        e->dirty = 0;
+        count++;
+    }
+    d->dirtyCount = 0;
+    *out  = entries;
+    *vias = via;
+    *n    = count;
+    return 0;
 }
 
 /******************************************************************************
@@ -82,50 +619,269 @@ static int findBestDistance(const char* dest) {
  * Format:
  *   senderIPAddress:DV:(dest1,dist1):(dest2,dist2):...:
  *
- * We'll store "senderIPAddress" in g_myIP the first time or let the caller set it.
+ * The whole table (as of the last distancePublish()) in one string,
+ * without fragment token; broadcasting goes through emitDistanceVector().
+ * "senderIPAddress" is router->ip.
  ******************************************************************************/
-char* getDistanceVector(void) {
-    /* If g_myIP is "0.0.0.0", we just keep it for demonstration,
-       or you can set it from main. */
+char* getDistanceVector(Router* router) {
+    DistanceState* d = router->dv;
+    size_t used;
+    rcuReadLock();
+    const RouteSnapshot* s = readSnapshot(d);
+    size_t n = s ? s->destCount : 0;
 
-    /* We'll build in a static buffer. But let's do dynamic to be safe. */
-    char* dvBuf = (char*) calloc(1, 2048);
-    if (!dvBuf) return NULL;
+    /* "(255.255.255.255,4294967295):" is 29 chars */
+    size_t cap = IPV4_STR_LEN + 8 + n * 32;
+    char* dvBuf = (char*) malloc(cap);
+    if (dvBuf) {
+        dvEncodeText(router->ip, NULL, s ? s->entries : NULL, n, dvBuf, cap, &used);
+    }
+    rcuReadUnlock();
+    return dvBuf; 
+}
 
-    /* Start with "myIP:DV:" */
-    snprintf(dvBuf, 2047, "%s:DV:", g_myIP);
+/******************************************************************************
+ * roundBegin / roundEnd
+ *   What one DV round sends: the published snapshot for a full DV (encoded
+ *   in place, under rcuReadLock()), else a private copy of the changed
+ *   destinations, which are taken off the dirty list.
+ ******************************************************************************/
+typedef struct DVRound {
+    int full;
+    const DVEntry* entries;
+    const uint32_t* vias;   /* best next hop per entry */
+    size_t n;
+    DVEntry* delta;         /* owned copy when !full */
+} DVRound;
 
-    /* We'll keep track of unique destinations so we don't duplicate. */
-    char usedDest[100][IP_STR_LEN];
-    int usedCount = 0;
+/* 1 => something to send, 0 => nothing changed, -1 => error. */
+static int roundBegin(DistanceState* d, DVRound* rd, int full) {
+    uint32_t* deltaVias;
+    rd->delta = NULL;
 
-    for (Route* r = g_routes; r; r = r->next) {
-        /* see if we already appended r->destIP */
-        int found = 0;
-        for (int i = 0; i < usedCount; i++) {
-            if (strcmp(usedDest[i], r->destIP) == 0) {
-                found = 1;
-                break;
+    pthread_mutex_lock(&d->lock);
+    rd->full = full || d->fullRequested;
+    if (rd->full) {
+        /* Encode straight from the snapshot. Changes not yet published stay
+           in the dirty list and go out in the next delta. */
+        rcuReadLock();
+        const RouteSnapshot* s = readSnapshot(d);
+        rd->entries = s ? s->entries : NULL;
+        rd->vias    = s ? s->vias : NULL;
+        rd->n       = s ? s->destCount : 0;
+        if (!d->snapshotStale) {
+            for (size_t i = 0; i < d->dirtyCount; i++) {
+                DestEntry* e = findDest(d, d->dirty[i]);
+                if (e) e->dirty = 0;
             }
+            d->dirtyCount = 0;
         }
-        if (found) continue;
+        d->fullRequested = 0;
+    } else {
+        if (!d->dirtyCount || collectDelta(d, &rd->delta, &deltaVias, &rd->n) != 0) {
+            int rc = d->dirtyCount ? -1 : 0;
+            pthread_mutex_unlock(&d->lock);
+            return rc;
+        }
+        rd->entries = rd->delta;
+        rd->vias    = deltaVias;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return 1;
+}
+
+static void roundEnd(Router* router, DVRound* rd, int failed) {
+    if (rd->full) rcuReadUnlock();
+    free(rd->delta);
+    if (failed) dvRequestFull(router); /* what was taken is lost => resync */
+}
 
-        /* find best distance for this dest */
-        int bestDist = findBestDistance(r->destIP);
-        if (bestDist < 999999) {
-            /* Append "(dest,dist):" */
-            char tuple[128];
-            snprintf(tuple, sizeof(tuple), "(%s,%d):", r->destIP, bestDist);
-            strncat(dvBuf, tuple, 2047 - strlen(dvBuf));
+/******************************************************************************
+ * emitDistanceVector
+ ******************************************************************************/
+int emitDistanceVector(Router* router, DVFormat fmt, size_t mtu, int full,
+                       DVEmitFn emit, void* ctx) {
+    DistanceState* d = router->dv;
+    DVRound rd;
+    int rc = roundBegin(d, &rd, full);
+    if (rc <= 0) return rc;
+
+    int frags = dvEncodeFragments(fmt, router->ip, d->dvSeq, rd.entries, rd.n, mtu, emit, ctx);
+    if (frags > 0) d->dvSeq++;
+    roundEnd(router, &rd, frags < 0);
+    return frags;
+}
+
+/******************************************************************************
+ * emitDistanceVectorPeers
+ *   One DV per peer from the same round, each with the peer's own sequence
+ *   numbers (the DVs are unicast, so every peer sees a gap-free series).
+ ******************************************************************************/
+typedef struct PeerEmit {
+    DVPeerEmitFn fn;
+    void* ctx;
+    size_t peer;
+} PeerEmit;
+
+static void peerEmit(void* arg, const void* buf, size_t len) {
+    PeerEmit* pe = (PeerEmit*) arg;
+    pe->fn(pe->ctx, pe->peer, buf, len);
+}
+
+static uint16_t* peerTxSeq(DistanceState* d, uint32_t peer) {
+    for (size_t i = 0; i < d->txSeqCount; i++) {
+        if (d->txSeqs[i].peer == peer) return &d->txSeqs[i].seq;
+    }
+    if (d->txSeqCount == d->txSeqCap) {
+        size_t newCap = d->txSeqCap ? d->txSeqCap * 2 : 16;
+        TxSeq* t = (TxSeq*) realloc(d->txSeqs, newCap * sizeof(TxSeq));
+        if (!t) return &d->dvSeq; /* share the broadcast sequence instead */
+        d->txSeqs   = t;
+        d->txSeqCap = newCap;
+    }
+    d->txSeqs[d->txSeqCount].peer = peer;
+    d->txSeqs[d->txSeqCount].seq  = 0;
+    return &d->txSeqs[d->txSeqCount++].seq;
+}
+
+int emitDistanceVectorPeers(Router* router, DVHorizon horizon, const DVPeer* peers,
+                            size_t count, size_t mtu, int full, DVPeerEmitFn emit, void* ctx) {
+    DistanceState* d = router->dv;
+    DVRound rd;
+    int rc = roundBegin(d, &rd, full);
+    if (rc <= 0) return rc;
+
+    DVEntry* scratch = NULL;
+    if (horizon != DV_HORIZON_NONE && count) {
+        scratch = (DVEntry*) malloc((rd.n + 1) * sizeof(DVEntry));
+        if (!scratch) {
+            LOG_ERROR("Out of memory building DV.");
+            roundEnd(router, &rd, 1);
+            return -1;
         }
+    }
 
-        /* Mark dest used */
-        strncpy(usedDest[usedCount], r->destIP, IP_STR_LEN - 1);
-        usedDest[usedCount][IP_STR_LEN - 1] = '\0';
-        usedCount++;
+    int total = 0;
+    for (size_t p = 0; p < count; p++) {
+        const DVEntry* entries = rd.entries;
+        size_t n = rd.n;
+        if (scratch) {
+            n = 0;
+            for (size_t i = 0; i < rd.n; i++) {
+                if (rd.vias[i] != peers[p].ip || rd.entries[i].metric >= DV_INFINITY) {
+                    scratch[n++] = rd.entries[i];
+                } else if (horizon == DV_HORIZON_POISON || !rd.full) {
+                    scratch[n].dest   = rd.entries[i].dest;
+                    scratch[n].metric = DV_INFINITY;
+                    n++;
+                }
+            }
+            entries = scratch;
+        }
+
+        PeerEmit pe = { emit, ctx, p };
+        uint16_t* seq = peerTxSeq(d, peers[p].ip);
+        int frags = dvEncodeFragments(peers[p].fmt, router->ip, *seq, entries, n, mtu,
+                                      peerEmit, &pe);
+        if (frags < 0) {
+            total = -1;
+            break;
+        }
+        (*seq)++;
+        total += frags;
     }
 
-    return dvBuf; 
+    free(scratch);
+    roundEnd(router, &rd, total < 0);
+    return total;
+}
+
+/******************************************************************************
+ * acceptHeader
+ *   DV header callback: drop our own DVs (we hear our broadcasts) and
+ *   fragments of a DV older than the newest seen from that sender.
+ ******************************************************************************/
+typedef struct ApplyCtx {
+    Router* router;
+    uint64_t now;        /* ms */
+    unsigned cost;       /* of the link to the sender */
+    int changed;
+} ApplyCtx;
+
+static unsigned linkCostOf(const DistanceState* d, uint32_t via) {
+    for (size_t i = 0; i < d->linkCostCount; i++) {
+        if (d->linkCosts[i].via == via) return d->linkCosts[i].cost;
+    }
+    return ROUTER_DEFAULT_COST;
+}
+
+static int acceptHeader(void* ctx, uint32_t sender, const DVFragInfo* frag) {
+    /* runs from dvDecode*() with the lock held */
+    ApplyCtx* ac = (ApplyCtx*) ctx;
+    Router* router = ac->router;
+    DistanceState* d = router->dv;
+    if (sender == router->ip) return 1;
+    ac->cost = linkCostOf(d, sender);
+    if (!frag) return 0;
+
+    for (size_t i = 0; i < d->peerSeqCount; i++) {
+        PeerSeq* p = &d->peerSeqs[i];
+        if (p->sender != sender) continue;
+        int16_t delta = (int16_t)(frag->seq - p->lastSeq);
+        /* a large backwards jump is a restarted sender, not reordering */
+        if (delta < 0 && delta > -DV_SEQ_REORDER_WINDOW) return 1;
+        if (delta == 0) {
+            p->fragsSeen++;
+            return 0;
+        }
+        /* a skipped DV or missing fragments => a delta may be lost */
+        if ((delta > 1 || p->fragsSeen < p->fragCount) && d->gapHandler) {
+            d->gapHandler(router, sender);
+        }
+        p->lastSeq   = frag->seq;
+        p->fragsSeen = 1;
+        p->fragCount = frag->count;
+        return 0;
+    }
+
+    if (d->peerSeqCount == d->peerSeqCap) {
+        size_t newCap = d->peerSeqCap ? d->peerSeqCap * 2 : 16;
+        PeerSeq* p = (PeerSeq*) realloc(d->peerSeqs, newCap * sizeof(PeerSeq));
+        if (!p) return 0;
+        d->peerSeqs   = p;
+        d->peerSeqCap = newCap;
+    }
+    d->peerSeqs[d->peerSeqCount].sender    = sender;
+    d->peerSeqs[d->peerSeqCount].lastSeq   = frag->seq;
+    d->peerSeqs[d->peerSeqCount].fragsSeen = 1;
+    d->peerSeqs[d->peerSeqCount].fragCount = frag->count;
+    d->peerSeqCount++;
+    return 0;
+}
+
+/******************************************************************************
+ * applyTuple
+ *   DV tuple callback: (dest, metric) from sender => route (dest, via=sender)
+ ******************************************************************************/
+static void applyTuple(void* ctx, uint32_t sender, uint32_t destIP, uint32_t metric) {
+    ApplyCtx* ac = (ApplyCtx*) ctx;
+    DistanceState* d = ac->router->dv;
+
+    // newDist = distVal + cost of the link to sender, saturating at infinity
+    DVMetric newDist = metricAdd(metric, ac->cost, d->infinity);
+
+    // find or create route => (destIP, senderIP)
+    Route* r = findRoute(d, destIP, sender);
+    if (!r) {
+        r = createRoute(d, destIP, sender, newDist, ac->now);
+        if (r) ac->changed = 1;
+    } else {
+        if (r->distance != newDist) {
+            setRouteDistance(d, r, newDist, ac->now);
+            ac->changed = 1;
+        }
+    }
+    if (ac->changed) d->snapshotStale = 1;
 }
 
 /******************************************************************************
@@ -133,110 +889,475 @@ char* getDistanceVector(void) {
  * 
  * Format: "senderIP:DV:(dest,dist):(dest2,dist2):...:"
  * 
- * For each (dest,dist), we do dist+1 => store route with via=senderIP
+ * For each (dest,dist), we do dist+cost of the link to sender (saturating
+ * at infinity) => store route with via=senderIP
  * If table changes => dvUpdate().
  ******************************************************************************/
-void processDistanceVector(char* DV) {
+void processDistanceVector(Router* router, char* DV) {
     if (!DV) return;
+    processDistanceVectorText(router, DV, strlen(DV));
+}
 
-    /* We'll parse in place */
-    char buf[1024];
-    strncpy(buf, DV, sizeof(buf)-1);
-    buf[sizeof(buf)-1] = '\0';
+/******************************************************************************
+ * processDistanceVectorText
+ *   Parsed straight out of the receive buffer, no copy.
+ ******************************************************************************/
+void processDistanceVectorText(Router* router, const char* msg, size_t len) {
+    DistanceState* d = router->dv;
+    ApplyCtx ac = { router, routerNowCoarseMs(router), ROUTER_DEFAULT_COST, 0 };
+    pthread_mutex_lock(&d->lock);
+    dvDecodeText(msg, len, acceptHeader, applyTuple, &ac);
+    pthread_mutex_unlock(&d->lock);
+    if (ac.changed) {
+        dvUpdate(router);
+    }
+}
 
-    char* saveptr = NULL;
-    char* senderIP = strtok_r(buf, ":", &saveptr);
-    if (!senderIP) return;
+/******************************************************************************
+ * processDistanceVectorBinary
+ ******************************************************************************/
+void processDistanceVectorBinary(Router* router, const unsigned char* buf, size_t len) {
+    DistanceState* d = router->dv;
+    ApplyCtx ac = { router, routerNowCoarseMs(router), ROUTER_DEFAULT_COST, 0 };
+    pthread_mutex_lock(&d->lock);
+    dvDecodeBinary(buf, len, acceptHeader, applyTuple, &ac);
+    pthread_mutex_unlock(&d->lock);
+    if (ac.changed) {
+        dvUpdate(router);
+    }
+}
 
-    /* store senderIP in g_myIP if we haven't set it yet, or skip if logic needed. */
-    /* But the assignment states 'senderIPAddress' is the IP of the router that created the DV.
-       We will just parse it, won't overwrite tho */
+/******************************************************************************
+ * notifyUpdate
+ *   updatedDV=1, and wake the sender's event loop on the 0 -> 1 edge.
+ *   count => a new change (not dvSent() re-raising older ones).
+ ******************************************************************************/
+static void notifyUpdate(DistanceState* d, int count) {
+    int wasSet = __atomic_exchange_n(&d->updatedDV, 1, __ATOMIC_ACQ_REL);
+    if (count) {
+        __atomic_add_fetch(&d->updates, 1, __ATOMIC_RELAXED);
+        if (wasSet) __atomic_add_fetch(&d->merged, 1, __ATOMIC_RELAXED);
+    }
+    if (!wasSet && d->notifyFd >= 0) {
+        uint64_t one = 1;
+        if (write(d->notifyFd, &one, sizeof(one)) < 0) {
+            LOG_ERROR("write(dv eventfd): %s", strerror(errno));
+        }
+    }
+}
 
-    char* dvMarker = strtok_r(NULL, ":", &saveptr);
-    if (!dvMarker) return;
-    if (strcmp(dvMarker, "DV") != 0) {
-        // not a valid DV
-        return;
+/******************************************************************************
+ * dvUpdate
+ *   Called when table changes => updatedDV=1
+ ******************************************************************************/
+void dvUpdate(Router* router) {
+    notifyUpdate(router->dv, 1);
+    LOG_DEBUG("dvUpdate() => updatedDV = 1");
+}
+
+/******************************************************************************
+ * dvSent
+ *   Called after we broadcast => updatedDV=0. emitDistanceVector() already
+ *   took what it sent; anything changed since re-raises updatedDV.
+ ******************************************************************************/
+void dvSent(Router* router) {
+    DistanceState* d = router->dv;
+    pthread_mutex_lock(&d->lock);
+    __atomic_store_n(&d->updatedDV, 0, __ATOMIC_RELEASE);
+    int pending = d->dirtyCount || d->fullRequested;
+    pthread_mutex_unlock(&d->lock);
+    LOG_DEBUG("dvSent() => updatedDV = 0");
+    if (pending) notifyUpdate(d, 0);
+}
+
+/******************************************************************************
+ * dvPending
+ ******************************************************************************/
+int dvPending(Router* router) {
+    return __atomic_load_n(&router->dv->updatedDV, __ATOMIC_ACQUIRE);
+}
+
+/******************************************************************************
+ * dvGetUpdateStats
+ ******************************************************************************/
+void dvGetUpdateStats(Router* router, DVUpdateStats* out) {
+    out->updates = __atomic_load_n(&router->dv->updates, __ATOMIC_RELAXED);
+    out->merged  = __atomic_load_n(&router->dv->merged, __ATOMIC_RELAXED);
+}
+
+/******************************************************************************
+ * dvRequestFull
+ *   Next DV goes out as a full snapshot.
+ ******************************************************************************/
+void dvRequestFull(Router* router) {
+    DistanceState* d = router->dv;
+    pthread_mutex_lock(&d->lock);
+    d->fullRequested = 1;
+    pthread_mutex_unlock(&d->lock);
+    notifyUpdate(d, 1);
+}
+
+/******************************************************************************
+ * dvFullRequested
+ ******************************************************************************/
+int dvFullRequested(Router* router) {
+    DistanceState* d = router->dv;
+    pthread_mutex_lock(&d->lock);
+    int full = d->fullRequested;
+    pthread_mutex_unlock(&d->lock);
+    return full;
+}
+
+/******************************************************************************
+ * dvSetNotifyFd
+ ******************************************************************************/
+void dvSetNotifyFd(Router* router, int fd) {
+    router->dv->notifyFd = fd;
+}
+
+/******************************************************************************
+ * dvSetGapHandler
+ ******************************************************************************/
+void dvSetGapHandler(Router* router, void (*handler)(Router* router, uint32_t sender)) {
+    router->dv->gapHandler = handler;
+}
+
+/******************************************************************************
+ * distancePublish
+ ******************************************************************************/
+void distancePublish(Router* router) {
+    DistanceState* d = router->dv;
+    pthread_mutex_lock(&d->lock);
+    publishLocked(d);
+    pthread_mutex_unlock(&d->lock);
+    rcuReclaim();
+}
+
+/******************************************************************************
+ * distanceLookup
+ ******************************************************************************/
+int distanceLookup(Router* router, uint32_t dest, uint32_t* via, int* dist) {
+    int found = -1;
+    rcuReadLock();
+    const RouteSnapshot* s = readSnapshot(router->dv);
+    if (s) {
+        for (size_t i = destHash(dest) & s->indexMask; s->index[i];
+             i = (i + 1) & s->indexMask) {
+            size_t k = s->index[i] - 1;
+            if (s->entries[k].dest == dest) {
+                if (s->entries[k].metric >= DV_INFINITY) break; /* withdrawn */
+                if (via)  *via  = s->vias[k];
+                if (dist) *dist = (int) s->entries[k].metric;
+                found = 0;
+                break;
+            }
+        }
+    }
+    rcuReadUnlock();
+    return found;
+}
+
+/******************************************************************************
+ * distanceNeighborLost
+ *   Every route via the lost neighbor goes to infinity; destinations
+ *   whose best route that was go out as withdrawn in the next DV.
+ ******************************************************************************/
+void distanceNeighborLost(Router* router, uint32_t via) {
+    DistanceState* d = router->dv;
+    int changed = 0;
+    uint64_t now = routerNowCoarseMs(router);
+
+    pthread_mutex_lock(&d->lock);
+    for (size_t i = 0; i < d->routes.capacity; i++) {
+        Route* r = d->routes.slots[i];
+        if (!r || r->viaNeighbor != via || r->distance >= d->infinity) continue;
+        setRouteDistance(d, r, d->infinity, now);
+        changed = 1;
+    }
+    /* a neighbor that comes back starts a new DV sequence, and its HELLO
+       sets the link cost again */
+    for (size_t i = 0; i < d->peerSeqCount; i++) {
+        if (d->peerSeqs[i].sender == via) {
+            d->peerSeqs[i] = d->peerSeqs[--d->peerSeqCount];
+            break;
+        }
+    }
+    for (size_t i = 0; i < d->linkCostCount; i++) {
+        if (d->linkCosts[i].via == via) {
+            d->linkCosts[i] = d->linkCosts[--d->linkCostCount];
+            break;
+        }
+    }
+    if (changed) {
+        d->snapshotStale = 1;
+        publishLocked(d);
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    if (changed) {
+        char ipStr[IPV4_STR_LEN];
+        LOG_INFO("Withdrew routes via lost neighbor %s", ipFormat(via, ipStr));
+        dvUpdate(router);
     }
+}
 
+/******************************************************************************
+ * distanceSetLinkCost
+ *   Routes already learned from via move by the difference, so a cheaper
+ *   or dearer link shows up without waiting for via's next DV.
+ ******************************************************************************/
+void distanceSetLinkCost(Router* router, uint32_t via, unsigned cost) {
+    DistanceState* d = router->dv;
+    if (!cost) cost = ROUTER_DEFAULT_COST;
+    if (cost > DV_METRIC_MAX) cost = DV_METRIC_MAX;
     int changed = 0;
-    while (1) {
-        char* tuple = strtok_r(NULL, ":", &saveptr);
-        if (!tuple) break;  // no more
-        // tuple looks like "(dest,dist)"
-        if (tuple[0] != '(') continue;
-        char inside[128];
-        strncpy(inside, tuple + 1, sizeof(inside)-1);
-        inside[sizeof(inside)-1] = '\0';
-        // remove trailing ')'
-        char* rp = strchr(inside, ')');
-        if (rp) *rp = '\0';
-
-        // inside => "destIP,dist"
-        char* comma = strchr(inside, ',');
-        if (!comma) continue;
-        *comma = '\0';
-        char* destIP = inside;
-        char* distStr= comma+1;
-        int distVal   = atoi(distStr);
-
-        // cost to sender is 1 => newDist = distVal+1
-        int newDist = distVal + 1;
-
-        // find or create route => (destIP, senderIP)
-        Route* r = findRoute(destIP, senderIP);
-        if (!r) {
-            r = createRoute(destIP, senderIP, newDist);
-            if (r) changed = 1;
-        } else {
-            if (r->distance != newDist) {
-                r->distance = newDist;
-                changed = 1;
+    uint64_t now = routerNowCoarseMs(router);
+
+    pthread_mutex_lock(&d->lock);
+    unsigned old = ROUTER_DEFAULT_COST;
+    size_t i = 0;
+    while (i < d->linkCostCount && d->linkCosts[i].via != via) i++;
+    if (i < d->linkCostCount) {
+        old = d->linkCosts[i].cost;
+    } else if (cost != ROUTER_DEFAULT_COST) {
+        if (d->linkCostCount == d->linkCostCap) {
+            size_t newCap = d->linkCostCap ? d->linkCostCap * 2 : 16;
+            LinkCost* lc = (LinkCost*) realloc(d->linkCosts, newCap * sizeof(LinkCost));
+            if (!lc) {
+                pthread_mutex_unlock(&d->lock);
+                LOG_ERROR("Out of memory setting link cost.");
+                return;
             }
+            d->linkCosts   = lc;
+            d->linkCostCap = newCap;
         }
+        d->linkCosts[d->linkCostCount].via = via;
+        d->linkCostCount++;
+    }
+    if (i < d->linkCostCount) d->linkCosts[i].cost = cost;
+
+    for (size_t k = 0; cost != old && k < d->routes.capacity; k++) {
+        Route* r = d->routes.slots[k];
+        if (!r || r->viaNeighbor != via || r->distance >= d->infinity) continue;
+        /* finite => distance = advertised + old, so this cannot underflow */
+        setRouteDistance(d, r, metricAdd(r->distance - old, cost, d->infinity), now);
+        changed = 1;
+    }
+    if (changed) {
+        d->snapshotStale = 1;
+        publishLocked(d);
     }
+    pthread_mutex_unlock(&d->lock);
 
     if (changed) {
-        dvUpdate();
+        char ipStr[IPV4_STR_LEN];
+        LOG_INFO("Link cost to %s %u => %u", ipFormat(via, ipStr), old, cost);
+        dvUpdate(router);
     }
 }
 
 /******************************************************************************
- * dvUpdate
- *   Called when table changes => updatedDV=1
+ * distanceSetInfinity
+ *   Routes at or above the new infinity become unreachable (held, then
+ *   collected); ones at the old infinity stay unreachable.
  ******************************************************************************/
-void dvUpdate(void) {
-    updatedDV = 1;
-    printf("[INFO] dvUpdate() => updatedDV = 1\n");
+void distanceSetInfinity(Router* router, unsigned infinity) {
+    DistanceState* d = router->dv;
+    if (infinity < 2) infinity = 2;
+    if (infinity > DV_METRIC_MAX) infinity = DV_METRIC_MAX;
+    uint64_t now = routerNowCoarseMs(router);
+
+    pthread_mutex_lock(&d->lock);
+    DVMetric old = d->infinity;
+    d->infinity = (DVMetric) infinity;
+    for (size_t i = 0; old != d->infinity && i < d->routes.capacity; i++) {
+        Route* r = d->routes.slots[i];
+        if (r && (r->distance >= old || r->distance >= d->infinity)) {
+            r->distance = d->infinity;
+            if (!r->heldSince) holdRoute(d, r, now);
+        }
+    }
+    /* then every destination's best, over the clamped routes */
+    for (size_t i = 0; old != d->infinity && i < d->dests.capacity; i++) {
+        DestEntry* e = &d->dests.slots[i];
+        if (!e->routes) continue;
+        e->bestDist = d->infinity;
+        e->bestVia  = 0;
+        for (const Route* c = e->routes; c; c = c->nextSameDest) {
+            if (c->distance < e->bestDist) {
+                e->bestDist = c->distance;
+                e->bestVia  = c->viaNeighbor;
+            }
+        }
+    }
+    int changed = (old != d->infinity);
+    if (changed) {
+        d->snapshotStale = 1;
+        publishLocked(d);
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    if (changed) dvRequestFull(router);
 }
 
 /******************************************************************************
- * dvSent
- *   Called after we broadcast => updatedDV=0
+ * collectRoute
+ *   Hold timer callback of distanceGarbageCollect(): drop the route if it
+ *   is still held from when the timer was armed.
  ******************************************************************************/
-void dvSent(void) {
-    updatedDV = 0;
-    printf("[INFO] dvSent() => updatedDV = 0\n");
+typedef struct CollectCtx {
+    DistanceState* d;
+    size_t removed;
+} CollectCtx;
+
+static void collectRoute(void* ctx, TimerNode* t) {
+    CollectCtx* cc = (CollectCtx*) ctx;
+    DistanceState* d = cc->d;
+    HoldTimer* h = (HoldTimer*) t;
+    size_t i = findRouteSlot(d, h->destIP, h->viaNeighbor);
+    if (i != SIZE_MAX && d->routes.slots[i]->heldSince == h->heldSince) {
+        removeRouteAt(d, i);
+        cc->removed++;
+    }
+    slabFree(&d->holdTimerPool, h);
+}
+
+/******************************************************************************
+ * distanceGarbageCollect
+ ******************************************************************************/
+size_t distanceGarbageCollect(Router* router) {
+    DistanceState* d = router->dv;
+    CollectCtx cc = { d, 0 };
+    uint64_t now = routerNowCoarseMs(router);
+
+    pthread_mutex_lock(&d->lock);
+    timerAdvance(&d->holdWheel, now, collectRoute, &cc);
+    if (cc.removed) {
+        d->snapshotStale = 1;
+        publishLocked(d);
+    }
+    pthread_mutex_unlock(&d->lock);
+    rcuReclaim();
+    return cc.removed;
+}
+
+/******************************************************************************
+ * distanceNextTimeout
+ ******************************************************************************/
+uint64_t distanceNextTimeout(Router* router) {
+    DistanceState* d = router->dv;
+    pthread_mutex_lock(&d->lock);
+    uint64_t next = timerNextExpiry(&d->holdWheel);
+    pthread_mutex_unlock(&d->lock);
+    return next;
 }
 
 /******************************************************************************
  * printDistanceTable
  ******************************************************************************/
-void printDistanceTable(void) {
+void printDistanceTable(Router* router) {
+    logFlush();  /* the table goes out after what is already queued */
     printf("=== Distance Table ===\n");
-    for (Route* r = g_routes; r; r = r->next) {
-        printf("  dest=%s via=%s dist=%d\n", r->destIP, r->viaNeighbor, r->distance);
+    rcuReadLock();
+    const RouteSnapshot* s = readSnapshot(router->dv);
+    for (size_t i = 0; s && i < s->routeCount; i++) {
+        const SnapRoute* r = &s->routes[i];
+        char destStr[IPV4_STR_LEN], viaStr[IPV4_STR_LEN];
+        printf("  dest=%s via=%s dist=%u\n", ipFormat(r->destIP, destStr),
+               ipFormat(r->viaNeighbor, viaStr), (unsigned) r->distance);
     }
+    rcuReadUnlock();
     printf("======================\n");
+
+    SlabStats st;
+    distanceRoutePoolStats(router, &st);
+    printf("  route pool: %zu/%zu in use (peak %zu), %zu slab(s), %zu bytes\n",
+           st.inUse, st.capacity, st.peakInUse, st.chunks, st.bytes);
 }
 
 /******************************************************************************
- * distanceCleanup
+ * distanceRoutePoolStats
  ******************************************************************************/
-void distanceCleanup(void) {
-    while (g_routes) {
-        Route* tmp = g_routes;
-        g_routes = tmp->next;
-        free(tmp);
+void distanceRoutePoolStats(Router* router, SlabStats* out) {
+    DistanceState* d = router->dv;
+    pthread_mutex_lock(&d->lock);
+    slabStats(&d->routePool, out);
+    pthread_mutex_unlock(&d->lock);
+}
+
+/******************************************************************************
+ * distanceClear
+ *   Free every route, table and snapshot of d; it starts over empty.
+ ******************************************************************************/
+static void distanceClear(DistanceState* d) {
+    pthread_mutex_lock(&d->lock);
+    free(__atomic_exchange_n(&d->snapshot, NULL, __ATOMIC_SEQ_CST));
+    d->snapshotStale = 1;
+    slabRelease(&d->routePool); /* every Route at once */
+    slabRelease(&d->holdTimerPool);
+    timerWheelInit(&d->holdWheel, DV_TIMER_TICK_MS);
+    free(d->routes.slots);
+    d->routes.slots    = NULL;
+    d->routes.capacity = 0;
+    d->routes.count    = 0;
+    free(d->dests.slots);
+    d->dests.slots    = NULL;
+    d->dests.capacity = 0;
+    d->dests.count    = 0;
+
+    free(d->peerSeqs);
+    d->peerSeqs     = NULL;
+    d->peerSeqCount = 0;
+    d->peerSeqCap   = 0;
+
+    free(d->linkCosts);
+    d->linkCosts     = NULL;
+    d->linkCostCount = 0;
+    d->linkCostCap   = 0;
+
+    free(d->txSeqs);
+    d->txSeqs     = NULL;
+    d->txSeqCount = 0;
+    d->txSeqCap   = 0;
+
+    free(d->dirty);
+    d->dirty         = NULL;
+    d->dirtyCount    = 0;
+    d->dirtyCap      = 0;
+    d->fullRequested = 1;
+    pthread_mutex_unlock(&d->lock);
+}
+
+/******************************************************************************
+ * distanceStateCreate / distanceStateDestroy
+ ******************************************************************************/
+DistanceState* distanceStateCreate(void) {
+    DistanceState* d = (DistanceState*) calloc(1, sizeof(DistanceState));
+    if (!d) {
+        LOG_ERROR("Out of memory creating distance state.");
+        return NULL;
     }
+    pthread_mutex_init(&d->lock, NULL);
+    slabInit(&d->routePool, sizeof(Route), ROUTES_PER_SLAB);
+    slabInit(&d->holdTimerPool, sizeof(HoldTimer), HOLD_TIMERS_PER_SLAB);
+    timerWheelInit(&d->holdWheel, DV_TIMER_TICK_MS);
+    d->snapshotStale = 1;
+    d->fullRequested = 1; /* first DV is always a full snapshot */
+    d->notifyFd      = -1;
+    d->infinity      = DV_DEFAULT_INFINITY;
+    return d;
+}
+
+void distanceStateDestroy(DistanceState* d) {
+    if (!d) return;
+    distanceClear(d);
+    pthread_mutex_destroy(&d->lock);
+    free(d);
+}
+
+/******************************************************************************
+ * distanceCleanup
+ ******************************************************************************/
+void distanceCleanup(Router* router) {
+    distanceClear(router->dv);
 }
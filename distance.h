@@ -11,47 +11,228 @@
  *
  * DV string format:
  *   senderIPAddress:DV:(dest1,dist1):(dest2,dist2):...:
+ * A compact binary encoding is also supported, see dvcodec.h.
+ *
+ * State is per router (Router.dv); every function takes the Router it
+ * works on. Instances share nothing and may run on different threads.
+ *
+ * Thread safety: all functions may be called from any thread. Readers
+ * (getDistanceVector, distanceLookup, printDistanceTable and full DVs) see
+ * the tables as of the last distancePublish() and never block.
  ******************************************************************************/
 
 #ifndef DISTANCE_H
 #define DISTANCE_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include "dvcodec.h"
+#include "router.h"
+#include "slab.h"
+
+/*
+ * Route metrics are 16 bits. Each one is the advertised metric plus the
+ * link cost, saturating at the router's infinity (unreachable).
+ */
+typedef uint16_t DVMetric;
+#define DV_METRIC_MAX        0x7FFF  /* highest infinity, DVB_METRIC_INF */
+#define DV_DEFAULT_INFINITY  DV_METRIC_MAX
+
 /**
  * @brief Build a string-encoded distance vector in the format:
- *   "myIP:DV:(dest1,dist1):(dest2,dist2):...:"
+ *   "routerIP:DV:(dest1,dist1):(dest2,dist2):...:"
+ * The whole published table in one string, no size limit.
  * Caller must free() the returned string.
  */
-char* getDistanceVector(void);
+char* getDistanceVector(Router* router);
 
 /**
- * @brief Parse and process a DV string
- *   "senderIP:DV:(dest,dist):(dest2,dist2):...:"
+ * @brief Encode our distance vector in fmt as datagrams of at most mtu
+ *        bytes, calling emit for each fragment. Bumps the DV sequence.
+ * @param full  1 => every destination in the published snapshot (withdrawn
+ *              ones with an infinite metric);
+ *              0 => only destinations changed since the last DV (unless a
+ *              full snapshot was requested with dvRequestFull()).
+ *              The changes sent are taken off the changed-destination set.
+ * @return Number of fragments (0 if there is nothing to send), -1 on error.
+ */
+int emitDistanceVector(Router* router, DVFormat fmt, size_t mtu, int full,
+                       DVEmitFn emit, void* ctx);
+
+/* Per-neighbor DV filtering, see emitDistanceVectorPeers(). */
+typedef enum DVHorizon {
+    DV_HORIZON_NONE = 0,  /* same DV for everyone */
+    DV_HORIZON_SPLIT,     /* omit routes learned from the peer (poisoned
+                             in deltas, see distance.c) */
+    DV_HORIZON_POISON     /* advertise them back as unreachable */
+} DVHorizon;
+
+/* A neighbor to build a DV for. */
+typedef struct DVPeer {
+    uint32_t ip;          /* host order, compared with the route's via */
+    DVFormat fmt;
+} DVPeer;
+
+/* Called once per encoded datagram for peers[peer]. */
+typedef void (*DVPeerEmitFn)(void* ctx, size_t peer, const void* buf, size_t len);
+
+/**
+ * @brief Like emitDistanceVector(), but one DV per peer, filtered by
+ *        horizon on each destination's best next hop and encoded in the
+ *        peer's format. Each peer gets its own DV sequence numbers.
+ * @return Total fragments (0 if nothing changed), -1 on error.
+ */
+int emitDistanceVectorPeers(Router* router, DVHorizon horizon, const DVPeer* peers,
+                            size_t count, size_t mtu, int full, DVPeerEmitFn emit, void* ctx);
+
+/**
+ * @brief Parse and process a DV string (one fragment or a whole DV)
+ *   "senderIP:DV:[F<seq>.<idx>/<cnt>:](dest,dist):(dest2,dist2):...:"
+ * Fragments of a DV older than one already seen from the sender are ignored.
  * If table changes => dvUpdate().
  */
-void processDistanceVector(char* DV);
+void processDistanceVector(Router* router, char* DV);
+
+/**
+ * @brief Same as processDistanceVector() for a datagram of len bytes that
+ *        need not be NUL-terminated; parsed in place, nothing is copied.
+ */
+void processDistanceVectorText(Router* router, const char* msg, size_t len);
+
+/**
+ * @brief Process a binary-encoded DV (dvcodec.h). If table changes => dvUpdate().
+ */
+void processDistanceVectorBinary(Router* router, const unsigned char* buf, size_t len);
 
 /**
  * @brief Called whenever the DV is updated => sets updatedDV=true
  */
-void dvUpdate(void);
+void dvUpdate(Router* router);
+
+/**
+ * @brief Called after we broadcast a DV => sets updatedDV=false.
+ *        If more changes arrived since emitDistanceVector() it calls
+ *        dvUpdate() again so they are not missed.
+ */
+void dvSent(Router* router);
+
+/**
+ * @brief Make the next DV a full snapshot (new neighbor, DVREQ, periodic).
+ *        Also sets updatedDV.
+ */
+void dvRequestFull(Router* router);
+
+/**
+ * @brief 1 if the next DV will be a full snapshot.
+ */
+int dvFullRequested(Router* router);
+
+/**
+ * @brief Register an eventfd that dvUpdate()/dvRequestFull() write to when
+ *        updatedDV goes from 0 to 1, so an event loop can send right away.
+ *        -1 disables.
+ */
+void dvSetNotifyFd(Router* router, int fd);
+
+/**
+ * @brief Register a callback run when a sender's DV sequence shows a lost
+ *        DV or fragment, so main can ask it for a full snapshot (DVREQ).
+ */
+void dvSetGapHandler(Router* router, void (*handler)(Router* router, uint32_t sender));
+
+/**
+ * @brief A neighbor was lost: every route through it becomes unreachable
+ *        and is advertised with an infinite metric (dvUpdate() if any).
+ */
+void distanceNeighborLost(Router* router, uint32_t via);
+
+/**
+ * @brief Cost of the link to neighbor via (0 => ROUTER_DEFAULT_COST), added
+ *        to every metric it advertises. Routes already learned from it are
+ *        re-costed at once (dvUpdate() if any changed).
+ */
+void distanceSetLinkCost(Router* router, uint32_t via, unsigned cost);
+
+/**
+ * @brief Metric from which a destination is unreachable, 2..DV_METRIC_MAX
+ *        (clamped; default DV_DEFAULT_INFINITY). A small one, as RIP's 16,
+ *        bounds counting to infinity but also the path length. Routes
+ *        already learned are clamped and a full DV follows.
+ */
+void distanceSetInfinity(Router* router, unsigned infinity);
+
+/**
+ * @brief Drop routes that have been unreachable for the hold time (60 s).
+ *        Costs O(routes due), not a pass over the table; call it at
+ *        distanceNextTimeout() or periodically.
+ * @return Number of routes removed.
+ */
+size_t distanceGarbageCollect(Router* router);
+
+/**
+ * @brief Router time at or before which the next held route may be due,
+ *        UINT64_MAX if none is; in routerNowCoarseMs() terms, the clock
+ *        distanceGarbageCollect() reads.
+ */
+uint64_t distanceNextTimeout(Router* router);
+
+/**
+ * @brief Publish the current tables as a new immutable snapshot for readers
+ *        (no-op if unchanged) and free snapshots no reader holds any more.
+ *        The receiver calls it once per receive batch.
+ */
+void distancePublish(Router* router);
+
+/**
+ * @brief Lock-free lookup of the best route to dest in the published snapshot.
+ * @return 0 and via and dist (either pointer may be NULL) if reachable,
+ *         -1 if unknown or withdrawn.
+ */
+int distanceLookup(Router* router, uint32_t dest, uint32_t* via, int* dist);
 
 /**
- * @brief Called after we broadcast a DV => sets updatedDV=false
+ * @brief Print the published distance table (debug) and route pool usage.
  */
-void dvSent(void);
+void printDistanceTable(Router* router);
 
 /**
- * @brief Print the distance table (debug).
+ * @brief Occupancy of the Route pool.
  */
-void printDistanceTable(void);
+void distanceRoutePoolStats(Router* router, SlabStats* out);
 
 /**
  * @brief Cleanup the distance table
  */
-void distanceCleanup(void);
+void distanceCleanup(Router* router);
+
+/**
+ * @brief The "updatedDV" flag: 1 => main should send a new DV.
+ *        Safe to call from any thread.
+ */
+int dvPending(Router* router);
+
+/* Table changes and how many of them shared a DV. */
+typedef struct DVUpdateStats {
+    uint64_t updates;   /* dvUpdate()/dvRequestFull() calls */
+    uint64_t merged;    /* of those, made while a DV was already pending */
+} DVUpdateStats;
 
-/* The "updatedDV" flag. main can check if updatedDV==true => broadcast new DV. */
-extern int updatedDV;
+/**
+ * @brief Counters since the router was created. Safe from any thread.
+ */
+void dvGetUpdateStats(Router* router, DVUpdateStats* out);
+
+/**
+ * @brief Empty distance tables for routerCreate(); the first DV sent will
+ *        be a full snapshot.
+ * @return NULL on allocation failure.
+ */
+DistanceState* distanceStateCreate(void);
+
+/**
+ * @brief Free tables made by distanceStateCreate(). NULL is a no-op.
+ */
+void distanceStateDestroy(DistanceState* d);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,577 @@
+/******************************************************************************
+ * File: dvcodec.c
+ *
+ * Encoders/decoders for the ASCII and binary DV wire formats (see dvcodec.h).
+ ******************************************************************************/
+
+#include "dvcodec.h"
+#include "ipaddr.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DV_HAVE_X86_SIMD 1
+#endif
+
+/******************************************************************************
+ * Utility: decimal formatting without snprintf
+ ******************************************************************************/
+static size_t formatUint(uint32_t v, char* out) {
+    char tmp[10];
+    size_t n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    for (size_t i = 0; i < n; i++) out[i] = tmp[n - 1 - i];
+    return n;
+}
+
+static size_t uintLen(uint32_t v) {
+    size_t n = 1;
+    while (v >= 10) {
+        v /= 10;
+        n++;
+    }
+    return n;
+}
+
+static inline void putU16(unsigned char* p, uint16_t v) {
+    p[0] = (unsigned char)(v >> 8);
+    p[1] = (unsigned char) v;
+}
+
+static inline uint16_t getU16(const unsigned char* p) {
+    return (uint16_t)(((unsigned) p[0] << 8) | p[1]);
+}
+
+/******************************************************************************
+ * Utility: per-entry encoded sizes, used to plan fragments
+ ******************************************************************************/
+static size_t textTupleLen(const DVEntry* e) {
+    /* "(" a.b.c.d "," metric "):" */
+    size_t len = 3 + 4;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        len += uintLen((e->dest >> shift) & 0xFF);
+    }
+    return len + uintLen(e->metric);
+}
+
+static size_t binaryEntryLen(const DVEntry* e) {
+    return (e->metric < 0x80) ? 5 : 6;
+}
+
+/* Number of entries (at least the ones that fit) starting at entries[0]. */
+static size_t planFragment(const DVEntry* entries, size_t n, size_t room,
+                           size_t (*entryLen)(const DVEntry*)) {
+    size_t count = 0;
+    while (count < n && count < 0xFFFF) {
+        size_t len = entryLen(&entries[count]);
+        if (len > room) break;
+        room -= len;
+        count++;
+    }
+    return count;
+}
+
+/******************************************************************************
+ * dvEncodeText
+ ******************************************************************************/
+size_t dvEncodeText(uint32_t sender, const DVFragInfo* frag,
+                    const DVEntry* entries, size_t n,
+                    char* buf, size_t cap, size_t* used) {
+    char hdr[IPV4_STR_LEN + 32];
+    size_t len = strlen(ipFormat(sender, hdr));
+    memcpy(hdr + len, ":DV:", 4);
+    len += 4;
+    if (frag) {
+        /* "F<seq>.<index>/<count>:" */
+        hdr[len++] = 'F';
+        len += formatUint(frag->seq, hdr + len);
+        hdr[len++] = '.';
+        len += formatUint(frag->index, hdr + len);
+        hdr[len++] = '/';
+        len += formatUint(frag->count, hdr + len);
+        hdr[len++] = ':';
+    }
+    *used = 0;
+
+    /* header + NUL */
+    if (cap < len + 1) return 0;
+    memcpy(buf, hdr, len);
+
+    for (size_t i = 0; i < n; i++) {
+        /* "(" ip "," metric "):" */
+        char tuple[IPV4_STR_LEN + 16];
+        size_t t = 0;
+        tuple[t++] = '(';
+        t += strlen(ipFormat(entries[i].dest, tuple + t));
+        tuple[t++] = ',';
+        t += formatUint(entries[i].metric, tuple + t);
+        tuple[t++] = ')';
+        tuple[t++] = ':';
+        if (len + t + 1 > cap) break;
+        memcpy(buf + len, tuple, t);
+        len += t;
+        (*used)++;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+/******************************************************************************
+ * dvEncodeBinary
+ ******************************************************************************/
+size_t dvEncodeBinary(uint32_t sender, const DVFragInfo* frag,
+                      const DVEntry* entries, size_t n,
+                      unsigned char* buf, size_t cap, size_t* used) {
+    *used = 0;
+    if (cap < DVB_HDR_LEN) return 0;
+
+    buf[0] = DVB_MAGIC;
+    buf[1] = DVB_VERSION;
+    buf[2] = 0;
+    buf[3] = 0;
+    buf[4] = (unsigned char)(sender >> 24);
+    buf[5] = (unsigned char)(sender >> 16);
+    buf[6] = (unsigned char)(sender >> 8);
+    buf[7] = (unsigned char) sender;
+    putU16(buf + 10, frag ? frag->seq : 0);
+    putU16(buf + 12, frag ? frag->index : 0);
+    putU16(buf + 14, frag ? frag->count : 1);
+
+    size_t len = DVB_HDR_LEN;
+    size_t count = 0;
+    for (size_t i = 0; i < n && count < 0xFFFF; i++) {
+        uint32_t m = entries[i].metric;
+        if (m > DVB_METRIC_INF) m = DVB_METRIC_INF;
+        size_t need = (m < 0x80) ? 5 : 6;
+        if (len + need > cap) break;
+
+        uint32_t d = entries[i].dest;
+        buf[len++] = (unsigned char)(d >> 24);
+        buf[len++] = (unsigned char)(d >> 16);
+        buf[len++] = (unsigned char)(d >> 8);
+        buf[len++] = (unsigned char) d;
+        if (m < 0x80) {
+            buf[len++] = (unsigned char) m;
+        } else {
+            buf[len++] = (unsigned char)(0x80 | (m >> 8));
+            buf[len++] = (unsigned char) m;
+        }
+        count++;
+    }
+    putU16(buf + 8, (uint16_t) count);
+    *used = count;
+    return len;
+}
+
+/******************************************************************************
+ * dvEncodeFragments
+ *   Two greedy passes with identical packing: the first counts fragments so
+ *   every header can carry the total, the second encodes and emits.
+ ******************************************************************************/
+int dvEncodeFragments(DVFormat fmt, uint32_t sender, uint16_t seq,
+                      const DVEntry* entries, size_t n, size_t mtu,
+                      DVEmitFn emit, void* ctx) {
+    size_t limit = mtu;
+    if (fmt == DV_FORMAT_TEXT && limit > DV_TEXT_MAX_DATAGRAM) limit = DV_TEXT_MAX_DATAGRAM;
+    if (limit > DV_MAX_DATAGRAM) limit = DV_MAX_DATAGRAM;
+
+    size_t (*entryLen)(const DVEntry*);
+    size_t hdrLen;
+    if (fmt == DV_FORMAT_TEXT) {
+        /* worst case "255.255.255.255:DV:F65535.65535/65535:" */
+        hdrLen   = (IPV4_STR_LEN - 1) + 4 + 19;
+        entryLen = textTupleLen;
+    } else {
+        hdrLen   = DVB_HDR_LEN;
+        entryLen = binaryEntryLen;
+    }
+    /* must fit at least one worst-case entry */
+    const DVEntry worst = { UINT32_MAX, UINT32_MAX };
+    if (limit < hdrLen + entryLen(&worst)) return -1;
+    size_t room = limit - hdrLen;
+
+    size_t frags = 0;
+    for (size_t i = 0; ; ) {
+        size_t take = planFragment(entries + i, n - i, room, entryLen);
+        if (take == 0 && i < n) return -1; /* no progress: never loop */
+        i += take;
+        frags++;
+        if (i >= n) break;
+    }
+    if (frags > 0xFFFF) return -1;
+
+    void* buf = malloc(limit + 1);
+    if (!buf) return -1;
+
+    size_t i = 0;
+    for (size_t f = 0; f < frags; f++) {
+        DVFragInfo frag = { seq, (uint16_t) f, (uint16_t) frags };
+        size_t take = planFragment(entries + i, n - i, room, entryLen);
+        size_t used, len;
+        if (fmt == DV_FORMAT_TEXT) {
+            len = dvEncodeText(sender, &frag, entries + i, take, (char*) buf, limit + 1, &used);
+        } else {
+            len = dvEncodeBinary(sender, &frag, entries + i, take,
+                                 (unsigned char*) buf, limit, &used);
+        }
+        emit(ctx, buf, len);
+        i += used;
+    }
+    free(buf);
+    return (int) frags;
+}
+
+/******************************************************************************
+ * Utility: in-place scanning for dvDecodeText
+ ******************************************************************************/
+/* Next ':'-separated token of [*p, end), skipping empty ones like strtok_r. */
+static const char* nextToken(const char** p, const char* end, const char** tokEnd) {
+    const char* s = *p;
+    while (s < end && *s == ':') s++;
+    if (s == end) return NULL;
+    const char* e = (const char*) memchr(s, ':', (size_t)(end - s));
+    if (!e) e = end;
+    *tokEnd = e;
+    *p = e;
+    return s;
+}
+
+static inline int isSpace(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/* strtoul(*s, s, 10) over [*s, end): spaces, sign, saturation and all. */
+static uint64_t scanDecimal(const char** s, const char* end) {
+    const char* p = *s;
+    while (p < end && isSpace(*p)) p++;
+    int neg = 0;
+    if (p < end && (*p == '+' || *p == '-')) neg = (*p++ == '-');
+    const char* digits = p;
+    uint64_t v = 0;
+    int overflow = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        unsigned d = (unsigned)(*p - '0');
+        if (v > (UINT64_MAX - d) / 10) overflow = 1;
+        else v = v * 10 + d;
+    }
+    if (p == digits) return 0; /* no number => *s unchanged */
+    *s = p;
+    if (overflow) return UINT64_MAX;
+    return neg ? (uint64_t) 0 - v : v;
+}
+
+/* atoi() over [s, end) for a tuple metric; -1 if negative or above INT_MAX. */
+static int64_t scanMetric(const char* s, const char* end) {
+    while (s < end && isSpace(*s)) s++;
+    int neg = 0;
+    if (s < end && (*s == '+' || *s == '-')) neg = (*s++ == '-');
+    uint64_t v = 0;
+    for (; s < end && *s >= '0' && *s <= '9' && v <= INT32_MAX; s++) {
+        v = v * 10 + (unsigned)(*s - '0');
+    }
+    if (v > INT32_MAX || (neg && v)) return -1;
+    return (int64_t) v;
+}
+
+/* One "(dest,dist)" token [tok, tokEnd), tok[0] == '('. 0 => use it. */
+static int parseTupleScalar(const char* tok, const char* tokEnd,
+                            uint32_t* dest, uint32_t* metric) {
+    const char* in = tok + 1;
+    const char* lim = (tokEnd - in > 127) ? in + 127 : tokEnd;
+    const char* rp = (const char*) memchr(in, ')', (size_t)(lim - in));
+    if (rp) lim = rp;
+
+    // in => "destIP,dist"
+    size_t n = ipScan(in, lim, dest);
+    if (!n || in + n == lim || in[n] != ',') return -1;
+    int64_t distVal = scanMetric(in + n + 1, lim);
+    if (distVal < 0) return -1;
+    *metric = (uint32_t) distVal;
+    return 0;
+}
+
+/******************************************************************************
+ * SIMD tuple kernels
+ *   A tuple token is at most 24 bytes ("(255.255.255.255,99999):"), so one
+ *   32-byte window normally holds it and its ':' terminator. The kernel
+ *   classifies the whole window at once (':', ')', ',', '.', digit) into
+ *   bitmasks; octet and metric boundaries then fall out of tzcnt on those
+ *   masks and the digit values are already in a vector (byte - '0'), so
+ *   no per-character branching is left. Anything the fast path can't decide
+ *   exactly (no ':' in the window, spaces, signs, long metrics, junk)
+ *   returns 0 and the caller takes the scalar path for that token, so both
+ *   paths accept exactly the same input.
+ ******************************************************************************/
+#define DV_SIMD_WINDOW 32
+
+typedef int (*TupleKernel)(const char* tok, uint32_t* dest, uint32_t* metric,
+                           const char** tokEnd);
+
+#ifdef DV_HAVE_X86_SIMD
+/* Value of a 1-3 digit octet whose digits (already minus '0') start at d. */
+static inline unsigned octetValue(const uint8_t* d, unsigned len) {
+    switch (len) {
+    case 1:  return d[0];
+    case 2:  return d[0] * 10u + d[1];
+    default: return d[0] * 100u + d[1] * 10u + d[2];
+    }
+}
+
+/*
+ * Shared tail of the kernels: masks have bit i set when window byte i is
+ * that character; dd holds every window byte minus '0'.
+ */
+static inline int tupleFromMasks(const uint8_t* dd, uint32_t colon, uint32_t close,
+                                 uint32_t comma, uint32_t dot, uint32_t digit,
+                                 const char* tok, uint32_t* dest, uint32_t* metric,
+                                 const char** tokEnd) {
+    if (!colon || !close || !comma) return 0;
+    unsigned c  = (unsigned) __builtin_ctz(colon);
+    unsigned rp = (unsigned) __builtin_ctz(close);
+    unsigned cm = (unsigned) __builtin_ctz(comma);
+    if (!(cm < rp && rp < c)) return 0;
+
+    /* [1, cm) must be digits and exactly three dots, each run 1-3 digits */
+    uint32_t quad = ((1u << cm) - 1) & ~1u;
+    uint32_t dots = dot & quad;
+    if (((digit | dots) & quad) != quad || __builtin_popcount(dots) != 3) return 0;
+    unsigned d1 = (unsigned) __builtin_ctz(dots);
+    dots &= dots - 1;
+    unsigned d2 = (unsigned) __builtin_ctz(dots);
+    dots &= dots - 1;
+    unsigned d3 = (unsigned) __builtin_ctz(dots);
+    unsigned l0 = d1 - 1, l1 = d2 - d1 - 1, l2 = d3 - d2 - 1, l3 = cm - d3 - 1;
+    if (l0 - 1 > 2 || l1 - 1 > 2 || l2 - 1 > 2 || l3 - 1 > 2) return 0;
+    unsigned o0 = octetValue(dd + 1, l0);
+    unsigned o1 = octetValue(dd + d1 + 1, l1);
+    unsigned o2 = octetValue(dd + d2 + 1, l2);
+    unsigned o3 = octetValue(dd + d3 + 1, l3);
+    if ((o0 | o1 | o2 | o3) > 255) return 0;
+
+    /* (cm, rp) must be 1-9 plain digits, so the value fits without checks */
+    unsigned ml = rp - cm - 1;
+    uint32_t mMask = ((1u << rp) - 1) & ~((1u << (cm + 1)) - 1);
+    if (ml - 1 > 8 || (digit & mMask) != mMask) return 0;
+    uint32_t v = 0;
+    for (unsigned i = cm + 1; i < rp; i++) v = v * 10 + dd[i];
+
+    *dest   = (o0 << 24) | (o1 << 16) | (o2 << 8) | o3;
+    *metric = v;
+    *tokEnd = tok + c;
+    return 1;
+}
+
+/* SSE2 is part of x86-64, so this needs no target attribute there. */
+__attribute__((target("sse2")))
+static int tupleSSE2(const char* tok, uint32_t* dest, uint32_t* metric,
+                     const char** tokEnd) {
+    uint8_t dd[DV_SIMD_WINDOW];
+    const __m128i zero  = _mm_set1_epi8('0');
+    const __m128i nine  = _mm_set1_epi8(9);
+    uint32_t colon = 0, close = 0, comma = 0, dot = 0, digit = 0;
+    for (int half = 0; half < 2; half++) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (tok + 16 * half));
+        __m128i d = _mm_sub_epi8(v, zero);
+        _mm_storeu_si128((__m128i*) (dd + 16 * half), d);
+        int sh = 16 * half;
+        colon |= (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(':'))) << sh;
+        close |= (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(')'))) << sh;
+        comma |= (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(','))) << sh;
+        dot   |= (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('.'))) << sh;
+        digit |= (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(d, nine), d)) << sh;
+    }
+    return tupleFromMasks(dd, colon, close, comma, dot, digit, tok, dest, metric, tokEnd);
+}
+
+__attribute__((target("avx2")))
+static int tupleAVX2(const char* tok, uint32_t* dest, uint32_t* metric,
+                     const char** tokEnd) {
+    uint8_t dd[DV_SIMD_WINDOW];
+    __m256i v = _mm256_loadu_si256((const __m256i*) tok);
+    __m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+    _mm256_storeu_si256((__m256i*) dd, d);
+    uint32_t colon = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')));
+    uint32_t close = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(')')));
+    uint32_t comma = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')));
+    uint32_t dot   = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('.')));
+    uint32_t digit = (uint32_t) _mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d));
+    return tupleFromMasks(dd, colon, close, comma, dot, digit, tok, dest, metric, tokEnd);
+}
+#endif /* DV_HAVE_X86_SIMD */
+
+static DVTextImpl g_textImpl = DV_TEXT_AUTO; /* resolved on first use */
+
+static int textImplSupported(DVTextImpl impl) {
+    switch (impl) {
+    case DV_TEXT_SCALAR: return 1;
+#ifdef DV_HAVE_X86_SIMD
+    case DV_TEXT_SSE2:   return __builtin_cpu_supports("sse2");
+    case DV_TEXT_AVX2:   return __builtin_cpu_supports("avx2");
+#endif
+    default:             return 0;
+    }
+}
+
+/******************************************************************************
+ * dvSetTextImpl / dvTextImpl
+ ******************************************************************************/
+int dvSetTextImpl(DVTextImpl impl) {
+    if (impl == DV_TEXT_AUTO) {
+        impl = textImplSupported(DV_TEXT_AVX2) ? DV_TEXT_AVX2
+             : textImplSupported(DV_TEXT_SSE2) ? DV_TEXT_SSE2
+             : DV_TEXT_SCALAR;
+    }
+    if (!textImplSupported(impl)) return -1;
+    __atomic_store_n(&g_textImpl, impl, __ATOMIC_RELAXED);
+    return 0;
+}
+
+DVTextImpl dvTextImpl(void) {
+    DVTextImpl impl = __atomic_load_n(&g_textImpl, __ATOMIC_RELAXED);
+    if (impl == DV_TEXT_AUTO) {
+        dvSetTextImpl(DV_TEXT_AUTO);
+        impl = __atomic_load_n(&g_textImpl, __ATOMIC_RELAXED);
+    }
+    return impl;
+}
+
+static TupleKernel tupleKernel(void) {
+    switch (dvTextImpl()) {
+#ifdef DV_HAVE_X86_SIMD
+    case DV_TEXT_AVX2: return tupleAVX2;
+    case DV_TEXT_SSE2: return tupleSSE2;
+#endif
+    default:           return NULL;
+    }
+}
+
+/******************************************************************************
+ * dvDecodeText
+ *   "senderIP:DV:(dest,dist):(dest2,dist2):...:"
+ *   One pass over the datagram, no copy. Tuples go through the SIMD kernel
+ *   selected by dvSetTextImpl(); otherwise (or when it declines) each ':'
+ *   token is found with memchr, the dest is parsed straight out of the
+ *   buffer by ipScan() and the tuple handed to fn. Accepts what the old strtok_r/atoi parser did
+ *   (at most 127 bytes of a tuple are looked at, the metric is atoi-like,
+ *   anything not starting with '(' is skipped), except that metrics above
+ *   INT_MAX are dropped instead of wrapping.
+ ******************************************************************************/
+int dvDecodeText(const char* msg, size_t len, DVHeaderFn hdr, DVTupleFn fn, void* ctx) {
+    if (!msg) return -1;
+    const char* nul = (const char*) memchr(msg, '\0', len);
+    const char* end = nul ? nul : msg + len;
+    const char* p = msg;
+    const char* tokEnd;
+
+    const char* tok = nextToken(&p, end, &tokEnd);
+    uint32_t sender;
+    if (!tok || ipParseN(tok, (size_t)(tokEnd - tok), &sender) != 0) return -1;
+
+    tok = nextToken(&p, end, &tokEnd);
+    if (!tok || tokEnd - tok != 2 || tok[0] != 'D' || tok[1] != 'V') {
+        // not a valid DV
+        return -1;
+    }
+
+    tok = nextToken(&p, end, &tokEnd);
+    DVFragInfo frag;
+    int hasFrag = 0;
+    if (tok && tok[0] == 'F') {
+        // fragment token "F<seq>.<index>/<count>"
+        const char* s = tok + 1;
+        uint64_t seq = scanDecimal(&s, tokEnd);
+        if (s < tokEnd && *s == '.') {
+            s++;
+            uint64_t idx = scanDecimal(&s, tokEnd);
+            if (s < tokEnd && *s == '/') {
+                s++;
+                uint64_t cnt = scanDecimal(&s, tokEnd);
+                frag.seq   = (uint16_t) seq;
+                frag.index = (uint16_t) idx;
+                frag.count = (uint16_t) cnt;
+                hasFrag = 1;
+            }
+        }
+        tok = nextToken(&p, end, &tokEnd);
+    }
+    if (hdr && hdr(ctx, sender, hasFrag ? &frag : NULL) != 0) return 0;
+
+    /* tok is still unconsumed: rewind so the loop below sees it */
+    if (tok) p = tok;
+    TupleKernel kernel = tupleKernel();
+    uint32_t destIP, metric;
+    for (;;) {
+        while (p < end && *p == ':') p++;
+        if (p == end) break;
+        tok = p;
+
+        // tuple looks like "(dest,dist)"
+        if (tok[0] == '(' && kernel && end - tok >= DV_SIMD_WINDOW &&
+            kernel(tok, &destIP, &metric, &p)) {
+            fn(ctx, sender, destIP, metric);
+            continue;
+        }
+        tokEnd = (const char*) memchr(tok, ':', (size_t)(end - tok));
+        if (!tokEnd) tokEnd = end;
+        p = tokEnd;
+        if (tok[0] == '(' && parseTupleScalar(tok, tokEnd, &destIP, &metric) == 0) {
+            fn(ctx, sender, destIP, metric);
+        }
+    }
+    return 0;
+}
+
+/******************************************************************************
+ * dvDecodeBinary
+ ******************************************************************************/
+int dvDecodeBinary(const unsigned char* buf, size_t len,
+                   DVHeaderFn hdr, DVTupleFn fn, void* ctx) {
+    if (!dvIsBinary(buf, len) || len < DVB_HDR_LEN_V1) return -1;
+
+    size_t off;
+    DVFragInfo frag;
+    const DVFragInfo* fragp = NULL;
+    if (buf[1] == 1) {
+        off = DVB_HDR_LEN_V1;
+    } else if (buf[1] == 2) {
+        if (len < DVB_HDR_LEN) return -1;
+        frag.seq   = getU16(buf + 10);
+        frag.index = getU16(buf + 12);
+        frag.count = getU16(buf + 14);
+        fragp = &frag;
+        off = DVB_HDR_LEN;
+    } else {
+        return -1;
+    }
+
+    uint32_t sender = ((uint32_t) buf[4] << 24) | ((uint32_t) buf[5] << 16) |
+                      ((uint32_t) buf[6] << 8)  |  (uint32_t) buf[7];
+    size_t count = getU16(buf + 8);
+    if (hdr && hdr(ctx, sender, fragp) != 0) return 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (off + 5 > len) break;
+        uint32_t dest = ((uint32_t) buf[off] << 24) | ((uint32_t) buf[off + 1] << 16) |
+                        ((uint32_t) buf[off + 2] << 8) | (uint32_t) buf[off + 3];
+        uint32_t m = buf[off + 4];
+        off += 5;
+        if (m & 0x80) {
+            if (off + 1 > len) break;
+            m = ((m & 0x7F) << 8) | buf[off++];
+        }
+        fn(ctx, sender, dest, (m == DVB_METRIC_INF) ? DV_METRIC_UNREACHABLE : m);
+    }
+    return 0;
+}
+
+/******************************************************************************
+ * dvIsBinary
+ ******************************************************************************/
+int dvIsBinary(const void* msg, size_t len) {
+    return msg && len > 0 && ((const unsigned char*) msg)[0] == DVB_MAGIC;
+}
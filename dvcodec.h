@@ -0,0 +1,169 @@
+/******************************************************************************
+ * File: dvcodec.h
+ *
+ * DV wire formats.
+ *
+ * ASCII (legacy, always understood):
+ *   senderIP:DV:F<seq>.<index>/<count>:(dest1,dist1):(dest2,dist2):...:
+ *   The F token is optional; old parsers skip tokens not starting with '('.
+ *
+ * Binary (only sent to neighbors that advertised it in HELLO):
+ *   offset size
+ *     0     1    DVB_MAGIC (0xDB, never a digit so it can't be ASCII)
+ *     1     1    version (1 or 2)
+ *     2     1    flags (reserved, 0)
+ *     3     1    reserved, 0
+ *     4     4    sender IPv4, network order
+ *     8     2    entry count, network order
+ *   version 2 only:
+ *    10     2    DV sequence number
+ *    12     2    fragment index
+ *    14     2    fragment count
+ *   then entries: dest IPv4 (4 bytes, network order) + metric
+ *   A metric < 0x80 takes one byte; otherwise two bytes with the top bit
+ *   set (15-bit value, big-endian). DVB_METRIC_INF means unreachable.
+ *
+ * A DV larger than one datagram is split into fragments that share a
+ * sequence number. Every fragment is a self-contained DV, so receivers
+ * can apply each one as it arrives.
+ ******************************************************************************/
+
+#ifndef DVCODEC_H
+#define DVCODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DVB_MAGIC       0xDB
+#define DVB_VERSION     2
+#define DVB_HDR_LEN_V1  10
+#define DVB_HDR_LEN     16
+#define DVB_ENTRY_MAX   6          /* 4-byte dest + 2-byte metric */
+#define DVB_METRIC_INF  0x7FFF
+
+/* Metric handed to DVTupleFn for a binary DVB_METRIC_INF entry. */
+#define DV_METRIC_UNREACHABLE UINT32_MAX
+
+/* Largest UDP payload over IPv4. */
+#define DV_MAX_DATAGRAM 65507
+
+/* Default fragment size: 1500-byte Ethernet MTU minus IPv4 + UDP headers. */
+#define DV_DEFAULT_MTU  1472
+
+/* ASCII fragments stay below the legacy receiver's 512-byte buffer. */
+#define DV_TEXT_MAX_DATAGRAM 511
+
+typedef enum DVFormat {
+    DV_FORMAT_TEXT = 0,
+    DV_FORMAT_BINARY
+} DVFormat;
+
+/* Fragment header shared by both formats. */
+typedef struct DVFragInfo {
+    uint16_t seq;     /* same for all fragments of one DV */
+    uint16_t index;   /* 0 .. count-1 */
+    uint16_t count;
+} DVFragInfo;
+
+typedef struct DVEntry {
+    uint32_t dest;    /* host order */
+    uint32_t metric;
+} DVEntry;
+
+/* Called once per decoded (dest, metric) tuple. */
+typedef void (*DVTupleFn)(void* ctx, uint32_t sender, uint32_t dest, uint32_t metric);
+
+/*
+ * Called once per message before any tuple. frag is NULL for DVs that carry
+ * no fragment header. Return non-zero to skip the message's tuples.
+ */
+typedef int (*DVHeaderFn)(void* ctx, uint32_t sender, const DVFragInfo* frag);
+
+/* Called once per encoded datagram. */
+typedef void (*DVEmitFn)(void* ctx, const void* buf, size_t len);
+
+/**
+ * @brief Encode entries as an ASCII DV into buf (NUL-terminated).
+ * Stops at the last tuple that fits in cap.
+ * @param frag  Fragment token to include, NULL for none.
+ * @param used  Out: number of entries encoded.
+ * @return Length of the string, 0 if not even the header fits.
+ */
+size_t dvEncodeText(uint32_t sender, const DVFragInfo* frag,
+                    const DVEntry* entries, size_t n,
+                    char* buf, size_t cap, size_t* used);
+
+/**
+ * @brief Encode entries as a binary DV into buf.
+ * Metrics above DVB_METRIC_INF are sent as DVB_METRIC_INF.
+ * Stops at the last entry that fits in cap (and at 65535 entries).
+ * @param frag  Fragment header, NULL => seq 0, single fragment.
+ * @param used  Out: number of entries encoded.
+ * @return Length in bytes, 0 if not even the header fits.
+ */
+size_t dvEncodeBinary(uint32_t sender, const DVFragInfo* frag,
+                      const DVEntry* entries, size_t n,
+                      unsigned char* buf, size_t cap, size_t* used);
+
+/**
+ * @brief Split entries into fragments of at most mtu bytes (capped at
+ *        DV_TEXT_MAX_DATAGRAM for ASCII) and call emit for each.
+ *        An empty table still produces one fragment.
+ * @return Number of fragments emitted, -1 on error.
+ */
+int dvEncodeFragments(DVFormat fmt, uint32_t sender, uint16_t seq,
+                      const DVEntry* entries, size_t n, size_t mtu,
+                      DVEmitFn emit, void* ctx);
+
+/* Tuple parser used by dvDecodeText(). */
+typedef enum DVTextImpl {
+    DV_TEXT_AUTO = 0,   /* best the CPU supports (the default) */
+    DV_TEXT_SCALAR,
+    DV_TEXT_SSE2,
+    DV_TEXT_AVX2
+} DVTextImpl;
+
+/**
+ * @brief Select the ASCII tuple parser; DV_TEXT_AUTO picks AVX2, then SSE2,
+ *        then scalar using __builtin_cpu_supports(). All give identical
+ *        results; this is for benchmarking and testing.
+ * @return 0 on success, -1 if the CPU (or build target) lacks impl.
+ */
+int dvSetTextImpl(DVTextImpl impl);
+
+/**
+ * @brief The tuple parser in use (never DV_TEXT_AUTO).
+ */
+DVTextImpl dvTextImpl(void);
+
+/**
+ * @brief Decode an ASCII DV of len bytes (or up to a NUL) in a single pass.
+ *        msg is not modified or copied and need not be NUL-terminated.
+ * @param hdr  Optional header callback, may be NULL.
+ * @return 0 if the header was valid, -1 otherwise (fn never called).
+ */
+int dvDecodeText(const char* msg, size_t len, DVHeaderFn hdr, DVTupleFn fn, void* ctx);
+
+/**
+ * @brief Decode a binary DV (version 1 or 2). A truncated trailing entry
+ *        is ignored.
+ * @param hdr  Optional header callback, may be NULL.
+ * @return 0 if the header was valid, -1 otherwise (fn never called).
+ */
+int dvDecodeBinary(const unsigned char* buf, size_t len,
+                   DVHeaderFn hdr, DVTupleFn fn, void* ctx);
+
+/**
+ * @brief 1 if msg looks like a binary DV (magic byte), else 0.
+ */
+int dvIsBinary(const void* msg, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DVCODEC_H */
@@ -0,0 +1,70 @@
+/******************************************************************************
+ * File: ipaddr.c
+ *
+ * IPv4 text <-> uint32_t conversion. Hand-rolled instead of inet_pton/ntop
+ * since this sits on the per-tuple DV path.
+ ******************************************************************************/
+
+#include "ipaddr.h"
+#include <string.h>
+
+/******************************************************************************
+ * ipScan
+ ******************************************************************************/
+size_t ipScan(const char* str, const char* end, uint32_t* ip) {
+    const char* p = str;
+    uint32_t addr = 0;
+    for (int octet = 0; octet < 4; octet++) {
+        unsigned val = 0;
+        int digits = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            val = val * 10 + (unsigned)(*p - '0');
+            if (++digits > 3 || val > 255) return 0;
+            p++;
+        }
+        if (!digits) return 0;
+        if (octet < 3) {
+            if (p == end || *p != '.') return 0;
+            p++;
+        }
+        addr = (addr << 8) | val;
+    }
+
+    *ip = addr;
+    return (size_t)(p - str);
+}
+
+/******************************************************************************
+ * ipParseN
+ ******************************************************************************/
+int ipParseN(const char* str, size_t len, uint32_t* ip) {
+    if (!str || !ip) return -1;
+    uint32_t addr;
+    if (ipScan(str, str + len, &addr) != len || !len) return -1;
+    *ip = addr;
+    return 0;
+}
+
+/******************************************************************************
+ * ipParse
+ ******************************************************************************/
+int ipParse(const char* str, uint32_t* ip) {
+    if (!str || !ip) return -1;
+    return ipParseN(str, strlen(str), ip);
+}
+
+/******************************************************************************
+ * ipFormat
+ ******************************************************************************/
+const char* ipFormat(uint32_t ip, char* buf) {
+    char* p = buf;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        unsigned val = (ip >> shift) & 0xFF;
+        if (val >= 100) *p++ = (char)('0' + val / 100);
+        if (val >= 10)  *p++ = (char)('0' + (val / 10) % 10);
+        *p++ = (char)('0' + val % 10);
+        if (shift) *p++ = '.';
+    }
+    *p = '\0';
+    return buf;
+}
@@ -0,0 +1,53 @@
+/******************************************************************************
+ * File: ipaddr.h
+ *
+ * IPv4 helpers. Addresses are kept as host-order uint32_t everywhere inside
+ * the router; text is only produced for logging and the ASCII wire formats.
+ *
+ *   - ipParse(str, &ip)   -> dotted-decimal => uint32_t
+ *   - ipParseN()/ipScan() -> same on a length-delimited span, no copy
+ *   - ipFormat(ip, buf)   -> uint32_t => dotted-decimal
+ ******************************************************************************/
+
+#ifndef IPADDR_H
+#define IPADDR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* "255.255.255.255" + NUL */
+#define IPV4_STR_LEN 16
+
+/**
+ * @brief Parse a NUL-terminated dotted-decimal IPv4 address.
+ * @return 0 on success, -1 if str is not exactly four octets 0..255.
+ */
+int ipParse(const char* str, uint32_t* ip);
+
+/**
+ * @brief Parse exactly str[0..len) as a dotted-decimal IPv4 address.
+ * @return 0 on success, -1 otherwise.
+ */
+int ipParseN(const char* str, size_t len, uint32_t* ip);
+
+/**
+ * @brief Parse a dotted-decimal IPv4 address at the start of [str, end).
+ * @return Characters consumed, 0 if there is no valid address there.
+ */
+size_t ipScan(const char* str, const char* end, uint32_t* ip);
+
+/**
+ * @brief Format ip into buf (at least IPV4_STR_LEN bytes).
+ * @return buf, for use directly in printf arguments.
+ */
+const char* ipFormat(uint32_t ip, char* buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IPADDR_H */
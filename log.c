@@ -0,0 +1,499 @@
+/******************************************************************************
+ * File: log.c
+ *
+ * Asynchronous logger (see log.h).
+ *
+ * Each thread claims one of LOG_MAX_THREADS rings on its first record and
+ * gives it back when it exits; the next thread to claim it carries on
+ * from its indices, so it is still one producer at a time. A ring is an
+ * array of fixed-size LogSlots: the producer fills slot head and
+ * publishes it by storing head + 1 (release); the consumer reads up to
+ * head (acquire) and frees slots by storing tail. Neither waits for the
+ * other.
+ *
+ * The consumer is whoever holds g_drainLock: the writer thread every
+ * LOG_DRAIN_MS, or logFlush()/logStop(). It takes the rings' heads once,
+ * then repeatedly writes the oldest of their first records, so lines from
+ * different threads come out in time order.
+ ******************************************************************************/
+
+#include "log.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LOG_RING_MASK  ((uint64_t) LOG_RING_RECORDS - 1)
+#define LOG_LINE_BYTES 1024
+
+typedef struct LogSlot {
+    uint64_t ns;                       /* CLOCK_MONOTONIC when logged */
+    const char* fmt;
+    uint8_t level;
+    uint8_t nargs;
+    uint8_t types[LOG_MAX_ARGS];       /* LogArgType */
+    uint16_t strBytes;                 /* used of strings[] */
+    union {
+        long long i;
+        unsigned long long u;
+        double d;
+        const void* p;
+        uint32_t str[2];               /* offset, length in strings[] */
+    } args[LOG_MAX_ARGS];
+    char strings[LOG_STR_BYTES];
+} LogSlot;
+
+typedef struct LogRing {
+    uint64_t head;       /* next slot to fill, written by the producer */
+    char pad0[64 - sizeof(uint64_t)];
+    uint64_t tail;       /* next slot to write out, by the consumer */
+    char pad1[64 - sizeof(uint64_t)];
+    uint64_t dropped;    /* records lost to a full ring */
+    int inUse;           /* claimed by a thread */
+    LogSlot* slots;      /* allocated on first claim, kept */
+} LogRing;
+
+int g_logLevel = LOG_LEVEL_INFO;
+
+static LogRing g_rings[LOG_MAX_THREADS];
+static int g_running = 0;               /* writer started, rings in use */
+static uint64_t g_droppedTotal = 0;
+
+static pthread_mutex_t g_drainLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_writerLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_writerCond;     /* on CLOCK_MONOTONIC, logStart() */
+static int g_stopping = 0;
+static pthread_t g_writer;
+
+static pthread_once_t g_keyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t g_ringKey;
+static __thread LogRing* t_ring = NULL;
+static __thread int t_noRing = 0;       /* all rings taken, write directly */
+
+static const char* const g_levelTags[] = { "[ERROR] ", "[WARN] ", "[INFO] ", "[DEBUG] " };
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+/******************************************************************************
+ * Ring ownership
+ *   releaseRing runs at thread exit (pthread key destructor).
+ ******************************************************************************/
+static void releaseRing(void* p) {
+    __atomic_store_n(&((LogRing*) p)->inUse, 0, __ATOMIC_RELEASE);
+}
+
+static void makeKey(void) {
+    pthread_key_create(&g_ringKey, releaseRing);
+}
+
+static LogRing* claimRing(void) {
+    pthread_once(&g_keyOnce, makeKey);
+    for (int i = 0; i < LOG_MAX_THREADS; i++) {
+        LogRing* r = &g_rings[i];
+        int expected = 0;
+        if (!__atomic_compare_exchange_n(&r->inUse, &expected, 1, 0,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        if (!__atomic_load_n(&r->slots, __ATOMIC_ACQUIRE)) {
+            LogSlot* s = (LogSlot*) malloc(LOG_RING_RECORDS * sizeof(LogSlot));
+            if (!s) {
+                __atomic_store_n(&r->inUse, 0, __ATOMIC_RELEASE);
+                return NULL;
+            }
+            __atomic_store_n(&r->slots, s, __ATOMIC_RELEASE);
+        }
+        pthread_setspecific(g_ringKey, r);
+        return r;
+    }
+    return NULL;
+}
+
+/******************************************************************************
+ * captureArgs
+ *   Copy args into slot s, strings into s->strings (truncated to fit).
+ ******************************************************************************/
+static void captureArgs(LogSlot* s, unsigned nargs, const LogArg* args) {
+    size_t used = 0;
+    if (nargs > LOG_MAX_ARGS) nargs = LOG_MAX_ARGS;
+    for (unsigned i = 0; i < nargs; i++) {
+        s->types[i] = (uint8_t) args[i].type;
+        if (args[i].type != LOG_ARG_STR) {
+            s->args[i].u = args[i].v.u;   /* all 8 bytes, whatever the type */
+            continue;
+        }
+        const char* str = args[i].v.s ? args[i].v.s : "(null)";
+        size_t len = strnlen(str, sizeof(s->strings) - used);
+        memcpy(s->strings + used, str, len);
+        s->args[i].str[0] = (uint32_t) used;
+        s->args[i].str[1] = (uint32_t) len;
+        used += len;
+    }
+    s->nargs    = (uint8_t) nargs;
+    s->strBytes = (uint16_t) used;
+}
+
+/* Plain %d/%u/%x/%o without snprintf: most conversions in the tree. */
+static void putDigits(char* out, size_t* len, size_t cap, unsigned long long v,
+                      unsigned base) {
+    char tmp[24];
+    int n = 0;
+    do {
+        tmp[n++] = "0123456789abcdef"[v % base];
+        v /= base;
+    } while (v);
+    while (n && *len + 1 < cap) out[(*len)++] = tmp[--n];
+}
+
+/******************************************************************************
+ * formatSlot
+ *   printf-format s into out (always NUL-terminated, truncated to fit).
+ *   Each conversion is rebuilt with the width of the captured value, so
+ *   the format's own length modifiers only narrow integers as printf
+ *   would have.
+ ******************************************************************************/
+static size_t formatSlot(const LogSlot* s, char* out, size_t cap) {
+    const char* f = s->fmt;
+    size_t len = 0;
+    unsigned next = 0;
+
+#define LOG_PUT(...) do {                                                   \
+        int n_ = snprintf(out + len, cap - len, __VA_ARGS__);               \
+        if (n_ > 0) len += ((size_t) n_ < cap - len) ? (size_t) n_ : cap - len - 1; \
+    } while (0)
+
+    while (*f && len + 1 < cap) {
+        if (*f != '%') {
+            out[len++] = *f++;
+            continue;
+        }
+        if (f[1] == '%') {
+            out[len++] = '%';
+            f += 2;
+            continue;
+        }
+
+        /* %[flags][width][.precision][length]conv, '*' from the arguments */
+        char spec[48];
+        size_t sl = 0;
+        const char* start = f++;
+        spec[sl++] = '%';
+        while (*f && strchr("-+ #0", *f) && sl < 8) spec[sl++] = *f++;
+        for (int part = 0; part < 2; part++) {
+            if (part == 1) {
+                if (*f != '.') break;
+                spec[sl++] = *f++;
+            }
+            if (*f == '*') {
+                long long v = (next < s->nargs) ? s->args[next++].i : 0;
+                sl += (size_t) snprintf(spec + sl, sizeof(spec) - sl, "%d", (int) v);
+                f++;
+            } else {
+                while (*f >= '0' && *f <= '9' && sl < 24) spec[sl++] = *f++;
+            }
+        }
+        int lenMod = 0;    /* -2 hh, -1 h, 0 none, 1 l/ll/z/j/t (64 bits) */
+        while (*f && strchr("hlLqjzt", *f)) {
+            if (*f == 'h') lenMod = (lenMod == -1) ? -2 : -1;
+            else if (*f != 'L') lenMod = 1;
+            f++;
+        }
+        char conv = *f;
+        if (!conv) break;
+        f++;
+
+        if (next >= s->nargs || conv == 'n') {
+            /* no argument left for it: write the conversion as is */
+            LOG_PUT("%.*s", (int) (f - start), start);
+            continue;
+        }
+        unsigned a = next++;
+        unsigned type = s->types[a];
+        spec[sl] = '\0';
+
+        switch (conv) {
+        case 'd': case 'i': {
+            long long v = (type == LOG_ARG_DOUBLE) ? (long long) s->args[a].d : s->args[a].i;
+            if (lenMod == 0)  v = (int) v;
+            if (lenMod == -1) v = (short) v;
+            if (lenMod == -2) v = (signed char) v;
+            if (sl == 1) {
+                if (v < 0 && len + 1 < cap) out[len++] = '-';
+                putDigits(out, &len, cap, v < 0 ? 0ull - (unsigned long long) v
+                                                : (unsigned long long) v, 10);
+                break;
+            }
+            strcat(spec, "lld");
+            spec[strlen(spec) - 1] = conv;
+            LOG_PUT(spec, v);
+            break;
+        }
+        case 'u': case 'x': case 'X': case 'o': {
+            unsigned long long v = s->args[a].u;
+            if (lenMod == 0)  v = (unsigned) v;
+            if (lenMod == -1) v = (unsigned short) v;
+            if (lenMod == -2) v = (unsigned char) v;
+            if (sl == 1 && conv != 'X') {
+                putDigits(out, &len, cap, v, conv == 'u' ? 10 : conv == 'x' ? 16 : 8);
+                break;
+            }
+            strcat(spec, "llu");
+            spec[strlen(spec) - 1] = conv;
+            LOG_PUT(spec, v);
+            break;
+        }
+        case 'c':
+            strcat(spec, "c");
+            LOG_PUT(spec, (int) s->args[a].i);
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+            double v = (type == LOG_ARG_DOUBLE) ? s->args[a].d : (double) s->args[a].i;
+            spec[sl] = conv;
+            spec[sl + 1] = '\0';
+            LOG_PUT(spec, v);
+            break;
+        }
+        case 's':
+            if (type == LOG_ARG_STR && sl == 1) {
+                size_t n = s->args[a].str[1];
+                if (n > cap - len - 1) n = cap - len - 1;
+                memcpy(out + len, s->strings + s->args[a].str[0], n);
+                len += n;
+            } else if (type == LOG_ARG_STR) {
+                /* precision on top of the captured length */
+                char sspec[56];
+                snprintf(sspec, sizeof(sspec), "%s.*s", spec);
+                int prec = (int) s->args[a].str[1];
+                const char* dot = strchr(spec, '.');
+                if (dot) {
+                    int p = atoi(dot + 1);
+                    if (p < prec) prec = p;
+                    spec[dot - spec] = '\0';
+                    snprintf(sspec, sizeof(sspec), "%s.*s", spec);
+                }
+                LOG_PUT(sspec, prec, s->strings + s->args[a].str[0]);
+            } else {
+                LOG_PUT("%.*s", (int) (f - start), start);
+            }
+            break;
+        case 'p':
+            strcat(spec, "p");
+            LOG_PUT(spec, s->args[a].p);
+            break;
+        default:
+            LOG_PUT("%.*s", (int) (f - start), start);
+            break;
+        }
+    }
+#undef LOG_PUT
+    out[len] = '\0';
+    return len;
+}
+
+/******************************************************************************
+ * writeSlot
+ *   "[LEVEL] line\n" to stderr for errors and warnings, else stdout.
+ ******************************************************************************/
+static void writeSlot(const LogSlot* s) {
+    char line[LOG_LINE_BYTES + 1];
+    size_t len = strlen(g_levelTags[s->level]);
+    memcpy(line, g_levelTags[s->level], len);
+    len += formatSlot(s, line + len, LOG_LINE_BYTES - len);
+    line[len++] = '\n';
+    fwrite(line, 1, len, (s->level <= LOG_LEVEL_WARN) ? stderr : stdout);
+}
+
+/******************************************************************************
+ * logRecord
+ ******************************************************************************/
+void logRecord(LogLevel level, const char* fmt, unsigned nargs, const LogArg* args) {
+    LogRing* r = t_ring;
+    if (!r && !t_noRing && __atomic_load_n(&g_running, __ATOMIC_ACQUIRE)) {
+        r = t_ring = claimRing();
+        if (!r) t_noRing = 1;
+    }
+
+    if (!r || !__atomic_load_n(&g_running, __ATOMIC_ACQUIRE)) {
+        /* no writer: as printf did */
+        LogSlot s;
+        s.fmt   = fmt;
+        s.level = (uint8_t) level;
+        captureArgs(&s, nargs, args);
+        writeSlot(&s);
+        return;
+    }
+
+    uint64_t head = r->head;
+    uint64_t queued = head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    if (queued == LOG_RING_RECORDS) {
+        __atomic_add_fetch(&r->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    /* a burst: drain now rather than at the next LOG_DRAIN_MS */
+    if (queued == LOG_RING_RECORDS / 2) pthread_cond_signal(&g_writerCond);
+    LogSlot* s = &r->slots[head & LOG_RING_MASK];
+    s->ns    = nowNs();
+    s->fmt   = fmt;
+    s->level = (uint8_t) level;
+    captureArgs(s, nargs, args);
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/******************************************************************************
+ * drain
+ *   Under g_drainLock: write every record published so far, oldest first.
+ ******************************************************************************/
+static void drain(void) {
+    uint64_t heads[LOG_MAX_THREADS];
+    int active[LOG_MAX_THREADS];   /* rings with records, merged below */
+    int nactive = 0;
+    for (int i = 0; i < LOG_MAX_THREADS; i++) {
+        heads[i] = __atomic_load_n(&g_rings[i].head, __ATOMIC_ACQUIRE);
+        if (heads[i] != g_rings[i].tail) active[nactive++] = i;
+    }
+
+    while (nactive > 0) {
+        int oldest = 0;
+        const LogSlot* first = NULL;
+        for (int k = 0; k < nactive; k++) {
+            LogRing* r = &g_rings[active[k]];
+            const LogSlot* s = &r->slots[r->tail & LOG_RING_MASK];
+            if (!first || s->ns < first->ns) {
+                oldest = k;
+                first  = s;
+            }
+        }
+        int i = active[oldest];
+        writeSlot(first);
+        __atomic_store_n(&g_rings[i].tail, g_rings[i].tail + 1, __ATOMIC_RELEASE);
+        if (g_rings[i].tail == heads[i]) active[oldest] = active[--nactive];
+    }
+
+    uint64_t dropped = 0;
+    for (int i = 0; i < LOG_MAX_THREADS; i++) {
+        dropped += __atomic_exchange_n(&g_rings[i].dropped, 0, __ATOMIC_RELAXED);
+    }
+    if (dropped) {
+        g_droppedTotal += dropped;
+        fprintf(stderr, "[WARN] %llu log line(s) dropped, ring full\n",
+                (unsigned long long) dropped);
+    }
+    fflush(stdout);
+    fflush(stderr);
+}
+
+/******************************************************************************
+ * writerThread
+ ******************************************************************************/
+static void* writerThread(void* arg) {
+    (void) arg;
+    pthread_mutex_lock(&g_writerLock);
+    while (!g_stopping) {
+        struct timespec until;
+        clock_gettime(CLOCK_MONOTONIC, &until);
+        until.tv_nsec += LOG_DRAIN_MS * 1000000L;
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&g_writerCond, &g_writerLock, &until);
+        pthread_mutex_unlock(&g_writerLock);
+        logFlush();
+        pthread_mutex_lock(&g_writerLock);
+    }
+    pthread_mutex_unlock(&g_writerLock);
+    return NULL;
+}
+
+/******************************************************************************
+ * logStart
+ ******************************************************************************/
+int logStart(void) {
+    pthread_mutex_lock(&g_writerLock);
+    if (g_running) {
+        pthread_mutex_unlock(&g_writerLock);
+        return 0;
+    }
+    g_stopping = 0;
+    g_droppedTotal = 0;
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_writerCond, &attr);
+    pthread_condattr_destroy(&attr);
+    int rc = pthread_create(&g_writer, NULL, writerThread, NULL);
+    if (rc == 0) __atomic_store_n(&g_running, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&g_writerLock);
+    if (rc != 0) {
+        pthread_cond_destroy(&g_writerCond);
+        fprintf(stderr, "[ERROR] pthread_create(log writer): %s\n", strerror(rc));
+        return -1;
+    }
+    return 0;
+}
+
+/******************************************************************************
+ * logStop
+ *   Joins the writer, then drains what it left. A record another thread
+ *   is filling at that moment stays queued until the next logFlush(),
+ *   so stop the threads that log first.
+ ******************************************************************************/
+void logStop(void) {
+    pthread_mutex_lock(&g_writerLock);
+    if (!g_running) {
+        pthread_mutex_unlock(&g_writerLock);
+        return;
+    }
+    __atomic_store_n(&g_running, 0, __ATOMIC_RELEASE);
+    g_stopping = 1;
+    pthread_cond_signal(&g_writerCond);
+    pthread_mutex_unlock(&g_writerLock);
+    pthread_join(g_writer, NULL);
+    pthread_cond_destroy(&g_writerCond);
+    logFlush();
+}
+
+/******************************************************************************
+ * logFlush
+ ******************************************************************************/
+void logFlush(void) {
+    pthread_mutex_lock(&g_drainLock);
+    drain();
+    pthread_mutex_unlock(&g_drainLock);
+}
+
+/******************************************************************************
+ * logSetLevel
+ ******************************************************************************/
+void logSetLevel(LogLevel level) {
+    __atomic_store_n(&g_logLevel, (int) level, __ATOMIC_RELAXED);
+}
+
+/******************************************************************************
+ * logLevelParse
+ ******************************************************************************/
+int logLevelParse(const char* name, LogLevel* out) {
+    static const char* const names[] = { "error", "warn", "info", "debug" };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *out = (LogLevel) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/******************************************************************************
+ * logDropped
+ ******************************************************************************/
+uint64_t logDropped(void) {
+    pthread_mutex_lock(&g_drainLock);
+    uint64_t n = g_droppedTotal;
+    pthread_mutex_unlock(&g_drainLock);
+    return n;
+}
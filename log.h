@@ -0,0 +1,201 @@
+/******************************************************************************
+ * File: log.h
+ *
+ * Leveled, asynchronous logging for the routing modules.
+ *
+ *   - LOG_ERROR/LOG_WARN/LOG_INFO/LOG_DEBUG(fmt, ...) -> one line, printf
+ *                            format, no trailing newline
+ *   - logStart()         -> start the background writer
+ *   - logStop()          -> drain everything and stop it
+ *   - logFlush()         -> write out what is queued now (before printing
+ *                           directly, e.g. a table dump)
+ *   - logSetLevel()      -> runtime level; logLevelParse() for -L
+ *
+ * A LOG_* call does not format or write: it copies the format pointer and
+ * its arguments (strings by value, up to LOG_STR_BYTES per record) into a
+ * fixed-size record of the calling thread's ring, a single-producer,
+ * single-consumer queue with no lock. The writer thread drains the rings
+ * every LOG_DRAIN_MS, merges them in time order, formats and writes the
+ * lines: errors and warnings to stderr, the rest to stdout. A full ring
+ * drops the record and counts it.
+ *
+ * Levels above LOG_LEVEL_MAX are compiled out (build with e.g.
+ * -DLOG_LEVEL_MAX=LOG_LEVEL_INFO); the others cost a load and compare
+ * when below the runtime level. Until logStart() (and after logStop(),
+ * or from a thread that got no ring) records are formatted and written
+ * synchronously, as printf did, so tools that never start the writer
+ * (sim.h, bench) need nothing.
+ *
+ * The format must be a string literal: only its pointer is queued.
+ * Arguments are captured by type (integers, doubles, pointers and
+ * strings), at most LOG_MAX_ARGS; %n and long double are not supported.
+ ******************************************************************************/
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum LogLevel {
+    LOG_LEVEL_ERROR = 0,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG
+} LogLevel;
+
+#ifndef LOG_LEVEL_MAX
+#define LOG_LEVEL_MAX LOG_LEVEL_DEBUG   /* compile-time ceiling */
+#endif
+
+#define LOG_MAX_ARGS       8
+#define LOG_STR_BYTES      160    /* string arguments per record, truncated */
+#define LOG_RING_RECORDS   1024   /* per thread, a power of two */
+#define LOG_MAX_THREADS    64     /* threads with a ring */
+#define LOG_DRAIN_MS       20
+
+/* One captured argument. */
+typedef enum LogArgType {
+    LOG_ARG_INT = 0,
+    LOG_ARG_UINT,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_PTR,
+    LOG_ARG_STR
+} LogArgType;
+
+typedef struct LogArg {
+    LogArgType type;
+    union {
+        long long i;
+        unsigned long long u;
+        double d;
+        const void* p;
+        const char* s;
+    } v;
+} LogArg;
+
+/* Runtime level, see logSetLevel(). */
+extern int g_logLevel;
+
+static inline int logEnabled(LogLevel level) {
+    return (int) level <= __atomic_load_n(&g_logLevel, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Queue (or, without a writer, print) one line. Use the LOG_*
+ *        macros, which check the level first and capture the arguments.
+ */
+void logRecord(LogLevel level, const char* fmt, unsigned nargs, const LogArg* args);
+
+/**
+ * @brief Start the writer thread. Threads get a ring on their first record.
+ * @return 0 on success (or already started), -1 on error.
+ */
+int logStart(void);
+
+/**
+ * @brief Stop the writer and write out every queued record. Call it once
+ *        the other threads have stopped logging; later records are
+ *        written synchronously. No-op if not started.
+ */
+void logStop(void);
+
+/**
+ * @brief Write out the records queued so far, from the calling thread.
+ */
+void logFlush(void);
+
+/**
+ * @brief Lines above level are skipped from now on (default
+ *        LOG_LEVEL_INFO). Safe from any thread.
+ */
+void logSetLevel(LogLevel level);
+
+/**
+ * @brief "error", "warn", "info" or "debug".
+ * @return 0 on success, -1 if unknown.
+ */
+int logLevelParse(const char* name, LogLevel* out);
+
+/**
+ * @brief Records dropped on full rings since logStart().
+ */
+uint64_t logDropped(void);
+
+/* Argument capture, by static type. */
+static inline LogArg logArgInt(long long x) {
+    LogArg a; a.type = LOG_ARG_INT; a.v.i = x; return a;
+}
+static inline LogArg logArgUint(unsigned long long x) {
+    LogArg a; a.type = LOG_ARG_UINT; a.v.u = x; return a;
+}
+static inline LogArg logArgDouble(double x) {
+    LogArg a; a.type = LOG_ARG_DOUBLE; a.v.d = x; return a;
+}
+static inline LogArg logArgPtr(const void* x) {
+    LogArg a; a.type = LOG_ARG_PTR; a.v.p = x; return a;
+}
+static inline LogArg logArgStr(const char* x) {
+    LogArg a; a.type = LOG_ARG_STR; a.v.s = x; return a;
+}
+
+#define LOG_ARG(x) _Generic((x),                                              \
+    char*: logArgStr, const char*: logArgStr,                                 \
+    float: logArgDouble, double: logArgDouble, long double: logArgDouble,     \
+    char: logArgInt, signed char: logArgInt, short: logArgInt,                \
+    int: logArgInt, long: logArgInt, long long: logArgInt,                    \
+    _Bool: logArgUint, unsigned char: logArgUint, unsigned short: logArgUint, \
+    unsigned: logArgUint, unsigned long: logArgUint,                          \
+    unsigned long long: logArgUint,                                           \
+    default: logArgPtr)(x)
+
+/* Argument count (0..LOG_MAX_ARGS) and the LogArg array for it. */
+#define LOG_CAT(a, b)  LOG_CAT_(a, b)
+#define LOG_CAT_(a, b) a##b
+#define LOG_COUNT(...) LOG_COUNT_(_, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_COUNT_(_, a1, a2, a3, a4, a5, a6, a7, a8, n, ...) n
+
+#define LOG_ARGS(...) LOG_CAT(LOG_ARGS_, LOG_COUNT(__VA_ARGS__))(__VA_ARGS__)
+#define LOG_ARGS_0() NULL
+#define LOG_ARGS_1(a) (const LogArg[]) { LOG_ARG(a) }
+#define LOG_ARGS_2(a, b) (const LogArg[]) { LOG_ARG(a), LOG_ARG(b) }
+#define LOG_ARGS_3(a, b, c) (const LogArg[]) { LOG_ARG(a), LOG_ARG(b), LOG_ARG(c) }
+#define LOG_ARGS_4(a, b, c, d) \
+    (const LogArg[]) { LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d) }
+#define LOG_ARGS_5(a, b, c, d, e) \
+    (const LogArg[]) { LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e) }
+#define LOG_ARGS_6(a, b, c, d, e, f) \
+    (const LogArg[]) { LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e), \
+                       LOG_ARG(f) }
+#define LOG_ARGS_7(a, b, c, d, e, f, g) \
+    (const LogArg[]) { LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e), \
+                       LOG_ARG(f), LOG_ARG(g) }
+#define LOG_ARGS_8(a, b, c, d, e, f, g, h) \
+    (const LogArg[]) { LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e), \
+                       LOG_ARG(f), LOG_ARG(g), LOG_ARG(h) }
+
+/* Never called: lets the compiler check the format against the arguments. */
+static inline void logCheckFormat(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+static inline void logCheckFormat(const char* fmt, ...) { (void) fmt; }
+
+#define LOG_AT(level, fmt, ...) do {                                            \
+    if ((level) <= LOG_LEVEL_MAX && logEnabled(level)) {                       \
+        if (0) logCheckFormat(fmt, ##__VA_ARGS__);                             \
+        logRecord((level), "" fmt, LOG_COUNT(__VA_ARGS__), LOG_ARGS(__VA_ARGS__)); \
+    }                                                                          \
+} while (0)
+
+#define LOG_ERROR(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define LOG_WARN(fmt, ...)  LOG_AT(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...)  LOG_AT(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOG_H */
@@ -3,14 +3,70 @@
  *
  * Part 3: Integration
  *   - Exactly one sending thread, one receiving thread:
- *       SenderThread: every 5s => neighborSendHELLO(), neighborRemoveStale()
- *                     if updatedDV => broadcast DV => dvSent()
- *       ReceiverThread: blocks on recvfrom() => parse => if HELLO => neighborProcessHELLO()
- *                                                   if DV => processDistanceVector()
+ *       SenderThread: epoll loop over timerfds/eventfds
+ *                     every 5s (or -F ms) => neighborSendHELLO() on each link
+ *                     next neighbor/route timeout => neighborRemoveStale()
+ *                       (lost neighbor => its routes withdrawn),
+ *                       distanceGarbageCollect(); both keep their timers
+ *                       in a timer wheel, so this touches only what expired;
+ *                       the receiver re-arms it when a HELLO brings the
+ *                       next timeout closer
+ *                     dvUpdate() eventfd => after the coalescing window (and
+ *                       at least the hold-down since the last triggered DV,
+ *                       and a token from the rate limiter; trigger.h)
+ *                       send DV (changes only) => dvSent()
+ *                     every 30s => send a full DV snapshot, print the
+ *                       neighbor table (RTT, jitter, loss per link)
+ *                     DVs go to each neighbor by unicast, filtered by split
+ *                     horizon / poisoned reverse (-s), or are broadcast
+ *                     as one DV with -s none
+ *                     HELLO + DV fragments are queued during the tick (one
+ *                     queue per link) and flushed with one sendmmsg() per
+ *                     NETIO_SEND_BATCH
+ *       ReceiverThread: epoll loop over every link's socket, recvmmsg() for
+ *                       a batch of datagrams from each ready one
+ *                       => messageDispatch() each, with the link it came in on
+ *                            if HELLO => neighborProcessHELLO()
+ *                            if DV => processDistanceVectorText()
+ *                            if DVREQ => full snapshot next
+ *                       => after each batch publish route/neighbor snapshots
+ *   - The sender reads those snapshots lock-free (see rcu.h).
+ *   - A third thread writes the log: the others only queue their lines
+ *     (log.h), so a DV storm does not wait on stdout.
+ *   - "ip:DVREQ:target" asks target for a full snapshot; we send one when a
+ *     neighbor's DV sequence shows we lost a delta.
  *   - main() waits until user hits ENTER, then stops everything.
  *
  * Usage:
- *   ./dv_routing [myIp]
+ *   ./dv_routing [-i ifname[:cost]]... [-n neighborIp:cost]... [-I infinity]
+ *                [-R ms] [-F ms] [-M mult] [-m mtu] [-c ms] [-H ms] [-r rate]
+ *                [-b burst] [-L level]
+ *                [-s none|split|poison] [myIp]
+ *     -i  run on this interface (repeatable): its own socket, HELLOs to
+ *         its subnet broadcast address, metrics learned on it cost +cost
+ *         (default 1); without -i one link on all interfaces and
+ *         255.255.255.255
+ *     -n  metrics learned from this neighbor cost +cost on any link
+ *         (repeatable)
+ *     -I  metric at which a destination is unreachable, 2..32767
+ *         (default 32767; 16 as in RIP bounds counting to infinity)
+ *     -R  measured link costs: +1 per ms of smoothed HELLO RTT, divided
+ *         by the fraction of HELLOs that arrive (default off)
+ *     -F  fast failure detection: HELLO every ms (>= 10) instead of 5 s,
+ *         announced so neighbors declare us down after -M missed ones
+ *     -M  detect multiplier for -F (default 3, 1..255)
+ *     -m  largest DV datagram in bytes (default 1472); bigger DVs are
+ *         sent as several fragments
+ *     -c  triggered-update coalescing window in ms (default 20)
+ *     -H  minimum ms between triggered DVs, hold-down (default 200)
+ *     -r  triggered DVs per second, sustained: a token bucket (default 3,
+ *         0 => no limit beyond -H)
+ *     -b  triggered DVs the bucket lets through at once (default 20)
+ *     -L  log level: error, warn, info (default) or debug, which adds a
+ *         line per HELLO, DV fragment and tick (log.h)
+ *     -s  routes learned from a neighbor are not sent back to it (split)
+ *         or sent back as unreachable (poison, default); none broadcasts
+ *         the same DV to everyone
  ******************************************************************************/
 
 #include <stdio.h>
@@ -18,132 +74,505 @@
 #include <string.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <arpa/inet.h>
 
 #include "neighbor.h"
 #include "distance.h"
+#include "router.h"
+#include "ipaddr.h"
+#include "dvcodec.h"
+#include "message.h"
+#include "netio.h"
+#include "log.h"
+#include "rcu.h"
+#include "trigger.h"
 
-#define HELLO_INTERVAL_SEC  5
-
-/* We use global g_sock, g_broadcastAddr from neighbor.h */
-extern int g_sock;
-extern struct sockaddr_in g_broadcastAddr;
-
-/* We use updatedDV from distance.h */
-extern int updatedDV;
+#define HELLO_INTERVAL_SEC   5
+#define DV_FULL_INTERVAL_SEC 30
+#define DV_COALESCE_MS       20
+#define DV_HOLDDOWN_MS       200
 
 /* A global flag to keep threads running */
 static volatile int g_running = 1;
 
+/* Largest DV datagram we send (-m) */
+static size_t g_dvMtu = DV_DEFAULT_MTU;
+
+/* Triggered-update timing (-c, -H) */
+static unsigned g_coalesceMs = DV_COALESCE_MS;
+static unsigned g_holdDownMs = DV_HOLDDOWN_MS;
+static unsigned g_triggerRate = DV_TRIGGER_RATE;   /* -r, 0 => no bucket */
+static unsigned g_triggerBurst = DV_TRIGGER_BURST; /* -b */
+
+/* Per-neighbor DV filtering (-s) */
+static DVHorizon g_horizon = DV_HORIZON_POISON;
+
+/* eventfds: dvUpdate() => g_dvEventFd, shutdown => g_stopFd */
+static int g_dvEventFd = -1;
+static int g_stopFd = -1;
+
+/* This process's router: address, socket, tables */
+static Router* g_router = NULL;
+
+/* Interfaces to run on (-i) */
+static const char* g_ifSpecs[ROUTER_MAX_LINKS];
+static unsigned g_ifSpecCount = 0;
+
+/* Configured neighbor costs (-n) and infinity (-I, 0 => default) */
+#define MAX_COST_SPECS 64
+static const char* g_costSpecs[MAX_COST_SPECS];
+static unsigned g_costSpecCount = 0;
+static unsigned g_infinity = 0;
+static unsigned g_rttCostMs = 0;   /* -R, 0 => configured costs only */
+
+/* HELLO interval and detect multiplier (-F, -M) */
+static unsigned g_helloMs = HELLO_INTERVAL_SEC * 1000;
+static unsigned g_detectMs = 0;    /* -F, 0 => neighbors time us out at 10 s */
+static unsigned g_detectMult = NEIGHBOR_DETECT_MULT;
+
+/* Neighbor/route expiry timerfd and the deadline it is armed for */
+static int g_expiryFd = -1;
+static uint64_t g_expiryAt = UINT64_MAX;
+static pthread_mutex_t g_expiryLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Outgoing datagrams: per thread and link, flushed per tick / batch. */
+static SendQueue g_txQueues[ROUTER_MAX_LINKS]; /* SenderThread */
+static SendQueue g_rxQueues[ROUTER_MAX_LINKS]; /* ReceiverThread (DVREQ) */
+
 /******************************************************************************
- * broadcastDV
- *   1) getDistanceVector() 
- *   2) send it to 255.255.255.255:5555
- *   3) dvSent()
+ * sendDVFragment
+ *   emitDistanceVector() callback: queue one datagram to every link's
+ *   broadcast address
+ ******************************************************************************/
+typedef struct BroadcastCtx {
+    DVFormat fmt;
+    int full;
+    int fragments;
+    int failed;
+} BroadcastCtx;
+
+static void sendDVFragment(void* arg, const void* buf, size_t len) {
+    BroadcastCtx* ctx = (BroadcastCtx*) arg;
+    for (unsigned l = 0; l < g_router->linkCount; l++) {
+        if (sendQueuePush(&g_txQueues[l], buf, len, &g_router->links[l].broadcastAddr) != 0) {
+            ctx->failed++;
+            return;
+        }
+    }
+    ctx->fragments++;
+    if (ctx->fmt == DV_FORMAT_TEXT) {
+        /* text fragments are NUL-terminated; the log keeps LOG_STR_BYTES */
+        LOG_DEBUG("Queued DV: %s", (const char*) buf);
+    }
+}
+
+/******************************************************************************
+ * sendPeerDVFragment
+ *   emitDistanceVectorPeers() callback: queue one datagram to a neighbor
  ******************************************************************************/
-static void broadcastDV(void) {
-    char* dvStr = getDistanceVector();
-    if (!dvStr) return;
+typedef struct PeerSendCtx {
+    const NeighborPeer* peers;
+    const DVPeer* dvPeers;
+    int fragments;
+    int failed;
+} PeerSendCtx;
 
-    if (g_sock < 0) {
-        free(dvStr);
+static void sendPeerDVFragment(void* arg, size_t peer, const void* buf, size_t len) {
+    PeerSendCtx* ctx = (PeerSendCtx*) arg;
+    const NeighborPeer* p = &ctx->peers[peer];
+    if (sendQueuePush(&g_txQueues[p->link], buf, len, &p->addr) != 0) {
+        ctx->failed++;
         return;
     }
+    ctx->fragments++;
+    if (ctx->dvPeers[peer].fmt == DV_FORMAT_TEXT) {
+        char ipStr[IPV4_STR_LEN];
+        LOG_DEBUG("Queued DV to %s: %s", ipFormat(ctx->peers[peer].ip, ipStr),
+                  (const char*) buf);
+    }
+}
 
-    /* Send the DV to broadcast. */
-    ssize_t sent = sendto(g_sock, dvStr, strlen(dvStr), 0,
-                          (struct sockaddr*)&g_broadcastAddr,
-                          sizeof(g_broadcastAddr));
-    if (sent < 0) {
-        perror("[ERROR] sendto(DV)");
+/******************************************************************************
+ * unicastDV
+ *   One DV per neighbor, filtered by g_horizon, in the format it supports.
+ *   Returns 0 if sent (or nothing to send), -1 on error.
+ ******************************************************************************/
+static int unicastDV(int full) {
+    size_t count;
+    NeighborPeer* peers = neighborGetPeers(g_router, &count);
+    /* no neighbor => the round is still taken (and dropped): a new
+       neighbor gets a full DV anyway */
+    DVPeer* dvPeers = count ? (DVPeer*) malloc(count * sizeof(DVPeer)) : NULL;
+    if (count && !dvPeers) {
+        free(peers);
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        dvPeers[i].ip  = peers[i].ip;
+        dvPeers[i].fmt = (peers[i].caps & NEIGHBOR_CAP_DV_BINARY) ? DV_FORMAT_BINARY
+                                                                  : DV_FORMAT_TEXT;
+    }
+
+    PeerSendCtx ctx = { peers, dvPeers, 0, 0 };
+    int rc = emitDistanceVectorPeers(g_router, g_horizon, dvPeers, count, g_dvMtu, full,
+                                     sendPeerDVFragment, &ctx);
+    free(dvPeers);
+    free(peers);
+    if (rc < 0) return -1;
+    if (ctx.fragments) {
+        LOG_INFO("Queued %s DV to %zu neighbor(s) in %d fragment(s)",
+                 full ? "full" : "delta", count, ctx.fragments);
+    }
+    if (ctx.failed) {
+        dvRequestFull(g_router);  // some fragments never made it => resync
     } else {
-        printf("[INFO] Broadcasted DV: %s\n", dvStr);
-        dvSent();  // updatedDV=0
+        dvSent(g_router);  // updatedDV=0
     }
-    free(dvStr);
+    return 0;
 }
 
 /******************************************************************************
- * SenderThread
- *   Wakes up every 5s to send HELLO + removeStale.
- *   If updatedDV=1 => broadcast DV.
+ * broadcastDV
+ *   1) emitDistanceVector() (binary if every neighbor supports it), split
+ *      into g_dvMtu-sized fragments; only changed routes unless full
+ *   2) queue each to every link's broadcast address (sent at the end of
+ *      the tick)
+ *   3) dvSent()
+ *   Unless -s none, unicastDV() does this per neighbor instead.
  ******************************************************************************/
-static void* SenderThread(void* arg) {
-    (void) arg;
-    while (g_running) {
-        neighborSendHELLO();
-        neighborRemoveStale();
+static void broadcastDV(int full) {
+    if (!g_router->linkCount || g_router->links[0].sock < 0) return;
 
-        /* If the distance table changed => broadcast new DV. */
-        if (updatedDV) {
-            broadcastDV();
+    if (g_horizon != DV_HORIZON_NONE) {
+        if (unicastDV(full || dvFullRequested(g_router)) < 0) {
+            LOG_ERROR("could not build DV");
         }
+        return;
+    }
+
+    BroadcastCtx ctx;
+    ctx.fmt = neighborAllHaveCaps(g_router, NEIGHBOR_CAP_DV_BINARY) ? DV_FORMAT_BINARY
+                                                          : DV_FORMAT_TEXT;
+    ctx.full = full || dvFullRequested(g_router);
+    ctx.fragments = 0;
+    ctx.failed = 0;
 
-        /* Sleep 5 seconds. */
-        for (int i = 0; i < HELLO_INTERVAL_SEC; i++) {
-            if (!g_running) break;
-            sleep(1);
+    if (emitDistanceVector(g_router, ctx.fmt, g_dvMtu, ctx.full, sendDVFragment, &ctx) < 0) {
+        LOG_ERROR("could not build DV");
+        return;
+    }
+    if (ctx.fmt == DV_FORMAT_BINARY && ctx.fragments) {
+        LOG_INFO("Queued %s binary DV in %d fragment(s)",
+                 ctx.full ? "full" : "delta", ctx.fragments);
+    }
+    if (ctx.failed) {
+        dvRequestFull(g_router);  // some fragments never made it => resync
+    } else {
+        dvSent(g_router);  // updatedDV=0
+    }
+}
+
+/******************************************************************************
+ * requestFullDV
+ *   Gap handler (receiver thread): queue "myIP:DVREQ:senderIP" on every
+ *   link so sender resends its table. Flushed after the current receive
+ *   batch.
+ ******************************************************************************/
+static void requestFullDV(Router* router, uint32_t sender) {
+    char msg[64], ipStr[IPV4_STR_LEN];
+    int len = snprintf(msg, sizeof(msg), "%s:DVREQ:%s", router->ipStr, ipFormat(sender, ipStr));
+    int queued = 0;
+    for (unsigned l = 0; l < router->linkCount; l++) {
+        if (router->links[l].sock < 0) continue;
+        if (sendQueuePush(&g_rxQueues[l], msg, (size_t) len,
+                          &router->links[l].broadcastAddr) == 0) {
+            queued = 1;
         }
     }
-    return NULL;
+    if (queued) {
+        LOG_INFO("Lost DV from %s, requesting full snapshot", ipStr);
+    }
 }
 
 /******************************************************************************
- * parseMessage
- *   If "ip:HELLO:seq" => neighborProcessHELLO(ip, seq)
- *   If "ip:DV:..."    => processDistanceVector()
+ * flushTick
+ *   Send everything queued this tick and report the syscalls batching saved
+ *   (not for plain HELLO ticks at sub-second intervals, -F).
  ******************************************************************************/
-static void parseMessage(const char* msg) {
-    if (!msg) return;
+static void flushTick(int report) {
+    unsigned long datagrams = 0, syscalls = 0, errors = 0;
+    for (unsigned l = 0; l < g_router->linkCount; l++) {
+        SendQueue* q = &g_txQueues[l];
+        sendQueueFlush(q);
+        datagrams += q->datagrams;
+        syscalls  += q->syscalls;
+        errors    += q->errors;
+        sendQueueResetStats(q);
+    }
+    if (datagrams && report) {
+        LOG_DEBUG("Tick sent %lu datagram(s) in %lu sendmmsg() call(s), "
+                  "saved %lu syscall(s)", datagrams, syscalls,
+                  datagrams + errors - syscalls);
+    }
+}
 
-    /* We'll do token parse: ipTok : typeTok : rest... */
-    char buf[512];
-    strncpy(buf, msg, sizeof(buf)-1);
-    buf[sizeof(buf)-1] = '\0';
+/******************************************************************************
+ * Utility: timerfd arming
+ ******************************************************************************/
+static void armTimer(int fd, uint64_t firstMs, uint64_t intervalMs) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    /* a zero it_value disarms, so round up to 1 ns */
+    its.it_value.tv_sec     = (time_t)(firstMs / 1000);
+    its.it_value.tv_nsec    = (long)(firstMs % 1000) * 1000000L;
+    if (!firstMs) its.it_value.tv_nsec = 1;
+    its.it_interval.tv_sec  = (time_t)(intervalMs / 1000);
+    its.it_interval.tv_nsec = (long)(intervalMs % 1000) * 1000000L;
+    if (timerfd_settime(fd, 0, &its, NULL) < 0) {
+        LOG_ERROR("timerfd_settime(): %s", strerror(errno));
+    }
+}
 
-    char* saveptr = NULL;
-    char* ipTok   = strtok_r(buf, ":", &saveptr);
-    char* typeTok = strtok_r(NULL, ":", &saveptr);
+static void drainFd(int fd) {
+    uint64_t v;
+    if (read(fd, &v, sizeof(v)) < 0 && errno != EAGAIN) {
+        LOG_ERROR("read(eventfd/timerfd): %s", strerror(errno));
+    }
+}
 
-    if (!ipTok || !typeTok) return;
+/* Wake the threads to exit: both epoll loops wait on the stop eventfd. */
+static void signalStop(void) {
+    g_running = 0;
+    uint64_t one = 1;
+    if (write(g_stopFd, &one, sizeof(one)) < 0) {
+        LOG_ERROR("write(stop eventfd): %s", strerror(errno));
+    }
+}
 
-    if (strcmp(typeTok, "HELLO") == 0) {
-        char* seqTok = strtok_r(NULL, ":", &saveptr);
-        if (!seqTok) return;
-        unsigned short seqVal = (unsigned short) atoi(seqTok);
-        neighborProcessHELLO(ipTok, seqVal);
-    } 
-    else if (strcmp(typeTok, "DV") == 0) {
-        processDistanceVector((char*)msg); 
+/******************************************************************************
+ * armExpiry
+ *   Arm g_expiryFd for the earliest neighbor or route timeout. The sender
+ *   calls it after every wakeup (always); the receiver after every batch
+ *   (only if the deadline moved closer, e.g. a neighbor announcing a
+ *   short detection time), so fast neighbors are not left to our HELLO
+ *   interval.
+ ******************************************************************************/
+static void armExpiry(int always) {
+    pthread_mutex_lock(&g_expiryLock);
+    uint64_t next = neighborNextTimeout(g_router);
+    uint64_t routes = distanceNextTimeout(g_router);
+    if (routes < next) next = routes;
+    if (next != UINT64_MAX && (always || next < g_expiryAt)) {
+        /* the wheels advance on the coarse clock: arm against it, one
+           resolution late, so it has reached next when the timer fires
+           (armed at 0, the sender would spin until it caught up) */
+        uint64_t now = routerNowCoarseMs(g_router);
+        armTimer(g_expiryFd, (next > now ? next - now : 0) + routerCoarseResMs(g_router), 0);
+        g_expiryAt = next;
+    }
+    pthread_mutex_unlock(&g_expiryLock);
+}
+
+/******************************************************************************
+ * printTriggerStats
+ *   Triggered DVs sent against the table changes they carried.
+ ******************************************************************************/
+static void printTriggerStats(const DVTrigger* trig) {
+    DVUpdateStats us;
+    dvGetUpdateStats(g_router, &us);
+    LOG_INFO("Triggered DVs: %llu sent for %llu update(s), %llu merged, "
+             "%llu rate-limited", (unsigned long long) trig->sent,
+             (unsigned long long) us.updates, (unsigned long long) us.merged,
+             (unsigned long long) trig->limited);
+}
+
+/******************************************************************************
+ * SenderThread
+ *   epoll loop:
+ *     helloTimer (every 5s)   => HELLO, full DV every 30s
+ *     g_expiryFd              => removeStale + garbage collect, re-armed
+ *                                after every wakeup (armExpiry)
+ *     g_dvEventFd (dvUpdate)  => arm coalesceTimer
+ *     coalesceTimer           => if updatedDV=1 => broadcast DV (delta),
+ *                                unless rate-limited: re-arm
+ *     g_stopFd                => exit
+ *   A triggered DV waits g_coalesceMs so a burst of changes goes out as one,
+ *   never follows the previous triggered DV by less than g_holdDownMs, and
+ *   goes out at most g_triggerRate a second after a burst of
+ *   g_triggerBurst (trigger.h).
+ ******************************************************************************/
+static void* SenderThread(void* arg) {
+    (void) arg;
+
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    int helloTimer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    int coalesceTimer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (ep < 0 || helloTimer < 0 || coalesceTimer < 0) {
+        LOG_ERROR("SenderThread epoll/timerfd setup: %s", strerror(errno));
+        return NULL;
+    }
+    int fds[] = { helloTimer, coalesceTimer, g_expiryFd, g_dvEventFd, g_stopFd };
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = fds[i];
+        epoll_ctl(ep, EPOLL_CTL_ADD, fds[i], &ev);
+    }
+
+    /* first HELLO right away, then every g_helloMs */
+    armTimer(helloTimer, 0, g_helloMs);
+
+    DVTrigger trig;
+    dvTriggerInit(&trig, g_coalesceMs, g_holdDownMs, g_triggerRate, g_triggerBurst,
+                  routerNowMs(g_router));
+    uint64_t lastFull = 0;
+    int haveFull = 0;
+    while (g_running) {
+        struct epoll_event evs[5];
+        int n = epoll_wait(ep, evs, 5, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("epoll_wait(): %s", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            int fd = evs[i].data.fd;
+            if (fd == g_stopFd) {
+                /* not drained: the receiver waits on it too */
+                g_running = 0;
+                continue;
+            }
+            drainFd(fd);
+            uint64_t now = routerNowMs(g_router);
+
+            if (fd == helloTimer) {
+                for (unsigned l = 0; l < g_router->linkCount; l++) {
+                    neighborSendHELLO(g_router, l, &g_txQueues[l]);
+                }
+                int report = (g_helloMs >= 1000);
+
+                /* Periodic full snapshot repairs anything a lost delta missed. */
+                if (!haveFull || now - lastFull >= DV_FULL_INTERVAL_SEC * 1000) {
+                    report = 1;
+                    broadcastDV(1);
+                    if (haveFull) {
+                        neighborPrintTable(g_router);
+                        printTriggerStats(&trig);
+                    }
+                    lastFull = now;
+                    haveFull = 1;
+                }
+                flushTick(report);
+            } else if (fd == g_expiryFd) {
+                neighborRemoveStale(g_router);   /* withdraws routes of lost neighbors */
+                distanceGarbageCollect(g_router);
+            } else if (fd == g_dvEventFd) {
+                uint64_t due;
+                if (dvTriggerArm(&trig, now, &due)) {
+                    armTimer(coalesceTimer, due - now, 0);
+                }
+            } else if (fd == coalesceTimer) {
+                uint64_t due;
+                /* If the distance table changed => broadcast new DV. */
+                if (!dvPending(g_router)) {
+                    dvTriggerCancel(&trig);
+                } else if (dvTriggerFire(&trig, now, &due)) {
+                    broadcastDV(0);
+                    flushTick(1);
+                } else {
+                    armTimer(coalesceTimer, due - now, 0);
+                }
+            }
+        }
+        armExpiry(1);
     }
+
+    close(coalesceTimer);
+    close(helloTimer);
+    close(ep);
+    return NULL;
 }
 
 /******************************************************************************
  * ReceiverThread
- *   Blocks on recvfrom(g_sock).
- *   parse -> neighborProcessHELLO or processDistanceVector
+ *   epoll loop over the link sockets (several links may share one) and
+ *   g_stopFd. From each ready socket one recvmmsg() of up to
+ *   NETIO_RECV_BATCH datagrams; each goes to messageDispatch() with the
+ *   link IP_PKTINFO says it arrived on.
  ******************************************************************************/
 static void* ReceiverThread(void* arg) {
     (void)arg;
 
-    struct sockaddr_in fromAddr;
-    socklen_t addrLen = sizeof(fromAddr);
-    char buffer[512];
+    /* Ring of full-size datagram buffers, allocated once. */
+    RecvBatch batch;
+    if (recvBatchInit(&batch, DV_MAX_DATAGRAM) != 0) {
+        return NULL;
+    }
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep < 0) {
+        LOG_ERROR("ReceiverThread epoll setup: %s", strerror(errno));
+        recvBatchFree(&batch);
+        return NULL;
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = g_stopFd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, g_stopFd, &ev);
+    for (unsigned l = 0; l < g_router->linkCount; l++) {
+        if (!g_router->links[l].ownsSock) continue;
+        ev.data.fd = g_router->links[l].sock;
+        epoll_ctl(ep, EPOLL_CTL_ADD, ev.data.fd, &ev);
+    }
 
     while (g_running) {
-        memset(buffer, 0, sizeof(buffer));
-        ssize_t bytes = recvfrom(g_sock, buffer, sizeof(buffer)-1, 0,
-                                 (struct sockaddr*)&fromAddr, &addrLen);
-        if (bytes < 0) {
-            // Possibly interrupted or no data
-            usleep(100000); // 0.1s
-            continue;
+        struct epoll_event evs[ROUTER_MAX_LINKS + 1];
+        int ready = epoll_wait(ep, evs, ROUTER_MAX_LINKS + 1, -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("epoll_wait(): %s", strerror(errno));
+            break;
         }
 
-        buffer[bytes] = '\0';
-        parseMessage(buffer);
+        for (int e = 0; e < ready && g_running; e++) {
+            int sock = evs[e].data.fd;
+            if (sock == g_stopFd) {
+                g_running = 0;
+                break;
+            }
+            int n = recvBatchReadNow(&batch, sock);
+            if (n < 0) {
+                if (errno != EINTR && errno != EAGAIN && errno != ENOMEM) {
+                    LOG_ERROR("recvmmsg(): %s", strerror(errno));
+                }
+                continue;
+            }
+
+            for (int i = 0; i < n; i++) {
+                int link = routerLinkFor(g_router, sock, batch.ifindex[i]);
+                if (link < 0) continue; /* an interface we don't run on */
+                size_t len;
+                char* msg = recvBatchData(&batch, i, &len);
+                messageDispatch(g_router, (unsigned) link, msg, len, &batch.from[i]);
+            }
+            /* one snapshot per batch for the sender's lock-free reads */
+            neighborPublish(g_router);
+            distancePublish(g_router);
+            armExpiry(0);
+            for (unsigned l = 0; l < g_router->linkCount; l++) {
+                if (g_rxQueues[l].count) sendQueueFlush(&g_rxQueues[l]);
+            }
+        }
     }
 
+    close(ep);
+    recvBatchFree(&batch);
     return NULL;
 }
 
@@ -151,38 +580,220 @@ static void* ReceiverThread(void* arg) {
  * main
  ******************************************************************************/
 int main(int argc, char* argv[]) {
-    const char* myIp = (argc > 1) ? argv[1] : "192.168.1.100";
-    printf("[INFO] Starting DV Routing on IP=%s\n", myIp);
+    int opt;
+    while ((opt = getopt(argc, argv, "i:n:I:R:F:M:m:c:H:r:b:L:s:")) != -1) {
+        switch (opt) {
+        case 'i':
+            if (g_ifSpecCount == ROUTER_MAX_LINKS) {
+                fprintf(stderr, "[ERROR] at most %d -i options\n", ROUTER_MAX_LINKS);
+                return 1;
+            }
+            g_ifSpecs[g_ifSpecCount++] = optarg;
+            break;
+        case 'n':
+            if (g_costSpecCount == MAX_COST_SPECS) {
+                fprintf(stderr, "[ERROR] at most %d -n options\n", MAX_COST_SPECS);
+                return 1;
+            }
+            g_costSpecs[g_costSpecCount++] = optarg;
+            break;
+        case 'I':
+            g_infinity = (unsigned) strtoul(optarg, NULL, 10);
+            if (g_infinity < 2 || g_infinity > DV_METRIC_MAX) {
+                fprintf(stderr, "[ERROR] -I must be 2..%d\n", DV_METRIC_MAX);
+                return 1;
+            }
+            break;
+        case 'R':
+            g_rttCostMs = (unsigned) strtoul(optarg, NULL, 10);
+            break;
+        case 'F':
+            g_detectMs = (unsigned) strtoul(optarg, NULL, 10);
+            if (g_detectMs < NEIGHBOR_DETECT_MIN_MS) {
+                fprintf(stderr, "[ERROR] -F must be at least %d ms\n", NEIGHBOR_DETECT_MIN_MS);
+                return 1;
+            }
+            g_helloMs = g_detectMs;
+            break;
+        case 'M':
+            g_detectMult = (unsigned) strtoul(optarg, NULL, 10);
+            if (g_detectMult < 1 || g_detectMult > 255) {
+                fprintf(stderr, "[ERROR] -M must be 1..255\n");
+                return 1;
+            }
+            break;
+        case 'm':
+            g_dvMtu = (size_t) strtoul(optarg, NULL, 10);
+            if (g_dvMtu < 64 || g_dvMtu > DV_MAX_DATAGRAM) {
+                fprintf(stderr, "[ERROR] -m must be 64..%d\n", DV_MAX_DATAGRAM);
+                return 1;
+            }
+            break;
+        case 'c':
+            g_coalesceMs = (unsigned) strtoul(optarg, NULL, 10);
+            break;
+        case 'H':
+            g_holdDownMs = (unsigned) strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            g_triggerRate = (unsigned) strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            g_triggerBurst = (unsigned) strtoul(optarg, NULL, 10);
+            if (g_triggerBurst < 1) {
+                fprintf(stderr, "[ERROR] -b must be at least 1\n");
+                return 1;
+            }
+            break;
+        case 'L': {
+            LogLevel level;
+            if (logLevelParse(optarg, &level) != 0) {
+                fprintf(stderr, "[ERROR] -L must be error, warn, info or debug\n");
+                return 1;
+            }
+            logSetLevel(level);
+            break;
+        }
+        case 's':
+            if (strcmp(optarg, "none") == 0) {
+                g_horizon = DV_HORIZON_NONE;
+            } else if (strcmp(optarg, "split") == 0) {
+                g_horizon = DV_HORIZON_SPLIT;
+            } else if (strcmp(optarg, "poison") == 0) {
+                g_horizon = DV_HORIZON_POISON;
+            } else {
+                fprintf(stderr, "[ERROR] -s must be none, split or poison\n");
+                return 1;
+            }
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-i ifname[:cost]]... [-n neighborIp:cost]... "
+                    "[-I infinity] [-R ms] [-F ms] [-M mult] [-m mtu] [-c ms] [-H ms] "
+                    "[-r rate] [-b burst] [-L level] "
+                    "[-s none|split|poison] [myIp]\n", argv[0]);
+            return 1;
+        }
+    }
 
-    if (neighborInit(myIp) != 0) {
-        fprintf(stderr, "[ERROR] neighborInit() failed\n");
+    const char* myIp = (optind < argc) ? argv[optind] : "192.168.1.100";
+    LOG_INFO("Starting DV Routing on IP=%s", myIp);
+
+    uint32_t myAddr;
+    if (ipParse(myIp, &myAddr) != 0) {
+        LOG_ERROR("invalid IP address: %s", myIp);
+        return 1;
+    }
+    g_router = routerCreate(myAddr);
+    if (!g_router) return 1;
+    for (unsigned i = 0; i < g_ifSpecCount; i++) {
+        char name[IF_NAMESIZE];
+        unsigned cost = ROUTER_DEFAULT_COST;
+        const char* colon = strchr(g_ifSpecs[i], ':');
+        size_t nameLen = colon ? (size_t) (colon - g_ifSpecs[i]) : strlen(g_ifSpecs[i]);
+        if (colon) cost = (unsigned) strtoul(colon + 1, NULL, 10);
+        if (nameLen == 0 || nameLen >= sizeof(name) || cost == 0) {
+            LOG_ERROR("bad -i %s (ifname[:cost], cost >= 1)", g_ifSpecs[i]);
+            routerDestroy(g_router);
+            return 1;
+        }
+        memcpy(name, g_ifSpecs[i], nameLen);
+        name[nameLen] = '\0';
+        if (routerAddInterface(g_router, name, cost) < 0) {
+            routerDestroy(g_router);
+            return 1;
+        }
+    }
+    for (unsigned i = 0; i < g_costSpecCount; i++) {
+        char ipStr[IPV4_STR_LEN];
+        const char* colon = strchr(g_costSpecs[i], ':');
+        size_t ipLen = colon ? (size_t) (colon - g_costSpecs[i]) : 0;
+        unsigned long cost = colon ? strtoul(colon + 1, NULL, 10) : 0;
+        uint32_t ip;
+        if (ipLen == 0 || ipLen >= sizeof(ipStr) || cost == 0 || cost > DV_METRIC_MAX) {
+            LOG_ERROR("bad -n %s (neighborIp:cost, cost 1..%d)",
+                      g_costSpecs[i], DV_METRIC_MAX);
+            routerDestroy(g_router);
+            return 1;
+        }
+        memcpy(ipStr, g_costSpecs[i], ipLen);
+        ipStr[ipLen] = '\0';
+        if (ipParse(ipStr, &ip) != 0 || neighborSetCost(g_router, ip, (unsigned) cost) != 0) {
+            LOG_ERROR("bad -n %s", g_costSpecs[i]);
+            routerDestroy(g_router);
+            return 1;
+        }
+    }
+    if (g_infinity) distanceSetInfinity(g_router, g_infinity);
+    neighborSetRttCost(g_router, g_rttCostMs);
+    if (g_detectMs) neighborSetDetect(g_router, g_detectMs, g_detectMult);
+
+    if (neighborInit(g_router) != 0) {
+        LOG_ERROR("neighborInit() failed");
+        routerDestroy(g_router);
+        return 1;
+    }
+    dvSetGapHandler(g_router, requestFullDV);
+    neighborSetLossHandler(g_router, distanceNeighborLost);
+    for (unsigned l = 0; l < g_router->linkCount; l++) {
+        sendQueueInit(&g_txQueues[l], g_router->links[l].sock);
+        sendQueueInit(&g_rxQueues[l], g_router->links[l].sock);
+    }
+
+    g_dvEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    g_stopFd    = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    g_expiryFd  = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (g_dvEventFd < 0 || g_stopFd < 0 || g_expiryFd < 0) {
+        LOG_ERROR("eventfd()/timerfd_create(): %s", strerror(errno));
+        routerDestroy(g_router);
+        return 1;
+    }
+    dvSetNotifyFd(g_router, g_dvEventFd);
+
+    /* from here on lines are queued and written by the log thread */
+    if (logStart() != 0) {
+        routerDestroy(g_router);
         return 1;
     }
 
     pthread_t sThread, rThread;
-    if (pthread_create(&sThread, NULL, SenderThread, NULL) != 0) {
-        perror("[ERROR] pthread_create(SenderThread)");
-        neighborStop();
+    int rc = pthread_create(&sThread, NULL, SenderThread, NULL);
+    if (rc != 0) {
+        LOG_ERROR("pthread_create(SenderThread): %s", strerror(rc));
+        logStop();
+        routerDestroy(g_router);
         return 1;
     }
-    if (pthread_create(&rThread, NULL, ReceiverThread, NULL) != 0) {
-        perror("[ERROR] pthread_create(ReceiverThread)");
-        g_running = 0;
-        neighborStop();
+    rc = pthread_create(&rThread, NULL, ReceiverThread, NULL);
+    if (rc != 0) {
+        LOG_ERROR("pthread_create(ReceiverThread): %s", strerror(rc));
+        /* the sender sleeps in epoll_wait(): wake it and wait before freeing */
+        signalStop();
+        pthread_join(sThread, NULL);
+        logStop();
+        routerDestroy(g_router);
         return 1;
     }
 
     /* Hit ENTER to stop */
-    printf("[INFO] Press ENTER to stop...\n");
+    LOG_INFO("Press ENTER to stop...");
     getchar();
 
-    g_running = 0;
+    signalStop();
     pthread_join(sThread, NULL);
     pthread_join(rThread, NULL);
 
-    neighborStop();
-    distanceCleanup();
+    dvSetNotifyFd(g_router, -1);
+    close(g_dvEventFd);
+    close(g_stopFd);
+    close(g_expiryFd);
+    for (unsigned l = 0; l < g_router->linkCount; l++) {
+        sendQueueFree(&g_txQueues[l]);
+        sendQueueFree(&g_rxQueues[l]);
+    }
+    routerDestroy(g_router);
+    rcuCleanup();
 
-    printf("[INFO] Exiting.\n");
+    LOG_INFO("Exiting.");
+    logStop();
     return 0;
 }
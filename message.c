@@ -0,0 +1,150 @@
+/******************************************************************************
+ * File: message.c
+ *
+ * Dispatch of received control-plane datagrams to the neighbor and
+ * distance modules of one Router. Used by main's receiver thread and by
+ * sim.c.
+ ******************************************************************************/
+
+#include "message.h"
+#include <string.h>
+#include "distance.h"
+#include "dvcodec.h"
+#include "ipaddr.h"
+#include "neighbor.h"
+
+/******************************************************************************
+ * nextField
+ *   Next ':'-separated field of [*p, end) without copying (empty fields are
+ *   skipped, as strtok_r did). Returns its start and sets *len, or NULL.
+ ******************************************************************************/
+static const char* nextField(const char** p, const char* end, size_t* len) {
+    const char* s = *p;
+    while (s < end && *s == ':') s++;
+    if (s == end) return NULL;
+    const char* e = (const char*) memchr(s, ':', (size_t)(end - s));
+    if (!e) e = end;
+    *len = (size_t)(e - s);
+    *p = e;
+    return s;
+}
+
+static int fieldIs(const char* f, size_t len, const char* word) {
+    return f && strlen(word) == len && memcmp(f, word, len) == 0;
+}
+
+/* Leading digits of a field in base 10 or 16, like atoi()/strtoul(). */
+static unsigned fieldUint(const char* f, size_t len, unsigned base) {
+    unsigned v = 0;
+    for (size_t i = 0; i < len; i++) {
+        char c = f[i];
+        unsigned d;
+        if (c >= '0' && c <= '9') d = (unsigned)(c - '0');
+        else if (base == 16 && c >= 'a' && c <= 'f') d = (unsigned)(c - 'a' + 10);
+        else if (base == 16 && c >= 'A' && c <= 'F') d = (unsigned)(c - 'A' + 10);
+        else break;
+        v = v * base + d;
+    }
+    return v;
+}
+
+/******************************************************************************
+ * helloEcho
+ *   "<ip>/<hex time>/<held ms>" of an ":E" field; sets h's echo if ip is us.
+ ******************************************************************************/
+static void helloEcho(const Router* router, const char* f, size_t len, NeighborHello* h) {
+    const char* end = f + len;
+    const char* slash = (const char*) memchr(f, '/', len);
+    uint32_t ip;
+    if (!slash || ipParseN(f, (size_t) (slash - f), &ip) != 0 || ip != router->ip) return;
+    const char* t = slash + 1;
+    const char* held = (const char*) memchr(t, '/', (size_t) (end - t));
+    if (!held) return;
+    h->echoTime   = fieldUint(t, (size_t) (held - t), 16);
+    h->echoHeldMs = fieldUint(held + 1, (size_t) (end - held - 1), 10);
+    h->hasEcho    = 1;
+}
+
+/******************************************************************************
+ * helloDetect
+ *   "<hex interval ms>/<mult>" of a ":D" field.
+ ******************************************************************************/
+static void helloDetect(const char* f, size_t len, NeighborHello* h) {
+    const char* slash = (const char*) memchr(f, '/', len);
+    if (!slash) return;
+    h->detectMs   = fieldUint(f, (size_t) (slash - f), 16);
+    h->detectMult = fieldUint(slash + 1, len - (size_t) (slash - f) - 1, 10);
+}
+
+/******************************************************************************
+ * messageDispatch
+ *   If binary DV      => processDistanceVectorBinary()
+ *   If "ip:HELLO:seq[:C<caps>][:T<ms>][:D<ms>/<mult>][:E<ip>/<ms>/<held>]..."
+ *                   => neighborProcessHELLO(link, ip, hello), and the
+ *                      cheapest link to ip becomes its link cost
+ *   If "ip:DV:..."    => processDistanceVectorText()
+ *   If "ip:DVREQ:target" and target is us => dvRequestFull()
+ *   Fields are read straight from the receive buffer, nothing is copied.
+ ******************************************************************************/
+void messageDispatch(Router* router, unsigned link, const char* msg, size_t len,
+                     const struct sockaddr_in* from) {
+    if (!msg) return;
+
+    if (dvIsBinary(msg, len)) {
+        processDistanceVectorBinary(router, (const unsigned char*) msg, len);
+        return;
+    }
+
+    /* ipTok : typeTok : rest... */
+    const char* nul = (const char*) memchr(msg, '\0', len);
+    const char* end = nul ? nul : msg + len;
+    const char* p = msg;
+    size_t ipLen, typeLen;
+    const char* ipTok   = nextField(&p, end, &ipLen);
+    const char* typeTok = nextField(&p, end, &typeLen);
+
+    if (!ipTok || !typeTok) return;
+
+    if (fieldIs(typeTok, typeLen, "HELLO")) {
+        size_t seqLen;
+        const char* seqTok = nextField(&p, end, &seqLen);
+        if (!seqTok) return;
+        uint32_t senderIP;
+        if (ipParseN(ipTok, ipLen, &senderIP) != 0) return;
+        NeighborHello hello;
+        memset(&hello, 0, sizeof(hello));
+        hello.seq = (unsigned short) fieldUint(seqTok, seqLen, 10);
+        const char* optTok;
+        size_t optLen;
+        while ((optTok = nextField(&p, end, &optLen)) != NULL) {
+            if (optTok[0] == 'C') {
+                hello.caps = fieldUint(optTok + 1, optLen - 1, 16);
+            } else if (optTok[0] == 'T') {
+                hello.time    = fieldUint(optTok + 1, optLen - 1, 16);
+                hello.hasTime = 1;
+            } else if (optTok[0] == 'E' && !hello.hasEcho) {
+                helloEcho(router, optTok + 1, optLen - 1, &hello);
+            } else if (optTok[0] == 'D') {
+                helloDetect(optTok + 1, optLen - 1, &hello);
+            }
+        }
+        int isNew = neighborProcessHELLO(router, link, senderIP, &hello, from);
+        unsigned cost = neighborLinkCost(router, senderIP); /* 0 => ourselves */
+        if (cost) distanceSetLinkCost(router, senderIP, cost);
+        /* a new neighbor needs our whole table */
+        if (isNew) {
+            dvRequestFull(router);
+        }
+    } 
+    else if (fieldIs(typeTok, typeLen, "DV")) {
+        processDistanceVectorText(router, msg, len);
+    }
+    else if (fieldIs(typeTok, typeLen, "DVREQ")) {
+        size_t targetLen;
+        const char* targetTok = nextField(&p, end, &targetLen);
+        uint32_t target;
+        if (targetTok && ipParseN(targetTok, targetLen, &target) == 0 && target == router->ip) {
+            dvRequestFull(router);
+        }
+    }
+}
@@ -0,0 +1,40 @@
+/******************************************************************************
+ * File: message.h
+ *
+ * Received datagram => neighbor / distance modules.
+ *
+ *   - messageDispatch() -> HELLO, ASCII or binary DV, DVREQ
+ ******************************************************************************/
+
+#ifndef MESSAGE_H
+#define MESSAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include "router.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Handle one received datagram:
+ *   binary DV                 => processDistanceVectorBinary()
+ *   "ip:HELLO:seq[:opt]..."   => neighborProcessHELLO() (caps, send time,
+ *                                echoes of ours), then
+ *                                distanceSetLinkCost(); a new neighbor
+ *                                also gets dvRequestFull()
+ *   "ip:DV:..."               => processDistanceVectorText()
+ *   "ip:DVREQ:target"         => dvRequestFull() if target is router->ip
+ * @param link  Link it came in on (routerLinkFor()).
+ * @param from  Source of the datagram (NULL if unknown).
+ */
+void messageDispatch(Router* router, unsigned link, const char* msg, size_t len,
+                     const struct sockaddr_in* from);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MESSAGE_H */
@@ -12,53 +12,152 @@
  *     - neighborProcessHELLO()
  *     - neighborRemoveStale()
  *     - neighborPrintTable()
+ *     - neighborAllHaveCaps()
+ *     - neighborGetPeers()
+ *     - neighborPublish()
+ *     - neighborPoolStats()
+ *     - neighborSetLossHandler()
+ *     - neighborLinkCost()
+ *     - neighborSetCost()
+ *     - neighborSetRttCost()
+ *     - neighborGetStats()
+ *     - neighborNextTimeout()
+ *     - neighborSetDetect()
  *
- * We store neighbor info in a linked list with a 10s stale timeout.
+ * We store neighbor info in a linked list with a 10s stale timeout; nodes
+ * come from a slab pool (slab.h). Each node carries its timeout in the
+ * table's timer wheel (timerwheel.h), pushed back on every HELLO, so
+ * neighborRemoveStale() only touches the entries that expired. The timeout
+ * is 10 s, or the neighbor's announced HELLO interval times its detect
+ * multiplier (neighbor.h). A neighbor is an (IP, link) pair: one
+ * heard on two links has two entries, and is lost only when both expire.
+ * All of it lives in the Router's NeighborState (router.h); neighborInit()
+ * opens a socket per link of the Router, bound to the link's device, or
+ * one shared socket when SO_BINDTODEVICE is not permitted; either way
+ * IP_PKTINFO tells which link a datagram came in on (routerLinkFor()).
+ * Times come from the Router's clock, monotonic in ms (clock.h): timeouts
+ * read its coarse variant, HELLO timing the precise one.
+ * Each entry keeps its link's measurements (see neighbor.h): RTT from our
+ * echoed HELLO times, smoothed with the RFC 6298 gains (1/8, 1/4), jitter
+ * as in RFC 3550 (1/16), and loss as an EWMA (1/8) over HELLO slots, a
+ * missing seq counting as lost. A late one is taken off the lost count
+ * only if it is among the last 64 seqs and was counted missing (a
+ * bitmap, as distance.c keeps DV sequences); any other backwards seq,
+ * or a jump ahead beyond NEIGHBOR_SEQ_WINDOW, is a restarted neighbor.
+ * The list is changed by both threads under its lock; readers use the
+ * immutable NeighborSnapshot array from the last neighborPublish() and
+ * never lock (old snapshots are freed through rcu.h).
  ******************************************************************************/
 
 #include "neighbor.h"
+#include "ipaddr.h"
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <time.h>
+#include <pthread.h>
+#include "log.h"
+#include "rcu.h"
+#include "slab.h"
+#include "timerwheel.h"
 
-#define BROADCAST_PORT       5555
-#define BROADCAST_IP         "255.255.255.255"
-#define NEIGHBOR_TIMEOUT_SEC 10
-#define IP_STR_LEN           32
-
-/* Exposed so main can also broadcast DV. */
-int g_sock = -1;
-struct sockaddr_in g_broadcastAddr;
-
-static char g_myIP[IP_STR_LEN];
-static unsigned short g_helloSeq = 0; // increments each time we send HELLO
+#define NEIGHBOR_TIMEOUT_MS  10000 /* for neighbors that announce no :D */
+#define NEIGHBOR_LOG_WINDOW_MS 1000
+#define NEIGHBOR_TICK_MS     10
+#define NEIGHBORS_PER_SLAB   32
+#define NEIGHBOR_HELLO_MAX   512  /* with echoes; the legacy receive buffer */
+#define NEIGHBOR_SEQ_WINDOW  256  /* seq jumps beyond this => restarted */
+#define NEIGHBOR_LOSS_ONE    65536
+#define NEIGHBOR_LOSS_CAP    58982 /* 0.9: a measured cost grows at most x10 */
+#define NEIGHBOR_JITTER_MAX_US 10000000 /* one sample counts at most 10 s */
 
 typedef struct NeighborNode {
-    char ip[IP_STR_LEN];
+    uint32_t ip;
+    unsigned link;          /* Router.links index it is heard on */
     unsigned short lastSeq;
-    time_t lastHeard;
+    unsigned caps;          /* NEIGHBOR_CAP_* from its last HELLO */
+    uint64_t lastHeard;     /* router clock, ms */
+    struct sockaddr_in addr; /* source of its last HELLO */
+
+    /* HELLO timing; clocks are routerNowMs() truncated to 32 bits */
+    uint32_t peerTime;      /* T of its last HELLO */
+    uint32_t peerTimeAt;    /* our clock when that arrived */
+    int hasTime;            /* peerTime is valid */
+    int echoPending;        /* peerTime not echoed yet */
+    unsigned rttSamples;
+    unsigned srttUs;
+    unsigned rttVarUs;
+    unsigned jitterUs;
+    uint64_t missed;        /* bit k: seq lastSeq - 1 - k was counted lost */
+    uint32_t lossQ16;       /* smoothed loss, NEIGHBOR_LOSS_ONE => all */
+    uint32_t received;
+    uint32_t lost;
+    unsigned detectMs;      /* timeout: NEIGHBOR_TIMEOUT_MS or its :D */
+    TimerNode timer;        /* detectMs after lastHeard */
     struct NeighborNode* next;
+    struct NeighborNode* prev;
 } NeighborNode;
 
-static NeighborNode* g_neighborsHead = NULL;
+/* What readers see of a neighbor. */
+typedef struct NeighborInfo {
+    uint32_t ip;
+    unsigned link;
+    unsigned short lastSeq;
+    unsigned caps;
+    uint64_t lastHeard;
+    struct sockaddr_in addr;
+    NeighborStats stats;
+} NeighborInfo;
 
-/******************************************************************************
- * Utility: current time
- ******************************************************************************/
-static inline time_t nowInSeconds(void) {
-    return time(NULL);
-}
+typedef struct NeighborSnapshot {
+    size_t count;
+    NeighborInfo nb[];
+} NeighborSnapshot;
+
+/* Cost configured for a neighbor, overriding its links' costs. */
+typedef struct NeighborCost {
+    uint32_t ip;
+    unsigned cost;
+} NeighborCost;
+
+/* A router's neighbor table (Router.nb). */
+struct NeighborState {
+    unsigned short helloSeq[ROUTER_MAX_LINKS]; /* next HELLO seq per link */
+    NeighborNode* echoNext[ROUTER_MAX_LINKS];  /* echo scan resumes here, NULL => head */
+
+    pthread_mutex_t nbLock;
+    NeighborNode* neighborsHead;
+    size_t neighborCount;
+    SlabPool nbPool;
+    TimerWheel wheel;            /* neighbor timeouts */
+    void (*lossHandler)(Router* router, uint32_t ip);
+    int nbChanged;               /* list changed since publish */
+    NeighborSnapshot* nbSnapshot; /* read under rcuReadLock() */
+
+    NeighborCost* costs;         /* neighborSetCost(), under nbLock */
+    size_t costCount;
+    size_t costCap;
+    unsigned rttCostMs;          /* neighborSetRttCost(), 0 => off */
+    unsigned detectIntervalMs;   /* neighborSetDetect(), 0 => not announced */
+    unsigned detectMult;
+
+    /* up/down log rate limit, under nbLock */
+    uint64_t logWindowStart;
+    unsigned logCount;
+    unsigned logSuppressed;
+};
 
 /******************************************************************************
  * findNeighbor
  ******************************************************************************/
-static NeighborNode* findNeighbor(const char* ip) {
-    NeighborNode* cur = g_neighborsHead;
+static NeighborNode* findNeighbor(NeighborState* ns, uint32_t ip, unsigned link) {
+    NeighborNode* cur = ns->neighborsHead;
     while (cur) {
-        if (strcmp(cur->ip, ip) == 0) {
+        if (cur->ip == ip && cur->link == link) {
             return cur;
         }
         cur = cur->next;
@@ -66,166 +165,739 @@ static NeighborNode* findNeighbor(const char* ip) {
     return NULL;
 }
 
+/******************************************************************************
+ * setNeighborAddr
+ *   Unicast address for DVs: where the HELLO came from, else ip:5555.
+ ******************************************************************************/
+static void setNeighborAddr(NeighborNode* n, const struct sockaddr_in* from) {
+    if (from) {
+        n->addr = *from;
+        return;
+    }
+    memset(&n->addr, 0, sizeof(n->addr));
+    n->addr.sin_family      = AF_INET;
+    n->addr.sin_addr.s_addr = htonl(n->ip);
+    n->addr.sin_port        = htons(ROUTER_PORT);
+}
+
+/******************************************************************************
+ * heardNeighbor
+ *   (Re)start n's timeout; nowMs is the router clock.
+ ******************************************************************************/
+static void heardNeighbor(NeighborState* ns, NeighborNode* n, uint64_t nowMs) {
+    n->lastHeard = nowMs;
+    timerSchedule(&ns->wheel, &n->timer, nowMs, nowMs + n->detectMs);
+}
+
+/******************************************************************************
+ * detectTime
+ *   Timeout for a neighbor that sent hello: what it announced, else 10 s.
+ ******************************************************************************/
+static unsigned detectTime(const NeighborHello* hello) {
+    if (!hello->detectMs || !hello->detectMult) return NEIGHBOR_TIMEOUT_MS;
+    unsigned interval = hello->detectMs < NEIGHBOR_DETECT_MIN_MS ? NEIGHBOR_DETECT_MIN_MS
+                                                                 : hello->detectMs;
+    unsigned mult = hello->detectMult > 255 ? 255 : hello->detectMult;
+    uint64_t ms = (uint64_t) interval * mult;
+    return ms > NEIGHBOR_TIMEOUT_MS * 6u ? NEIGHBOR_TIMEOUT_MS * 6u : (unsigned) ms;
+}
+
+/******************************************************************************
+ * eventLogFlush / eventLogAllow
+ *   Rate limit for neighbor up/down lines, under nbLock: eventLogAllow() says
+ *   whether to print one; past the burst they are only counted, and the
+ *   count is printed once the window is over.
+ ******************************************************************************/
+static void eventLogFlush(NeighborState* ns, uint64_t nowMs) {
+    if (nowMs - ns->logWindowStart < NEIGHBOR_LOG_WINDOW_MS) return;
+    if (ns->logSuppressed) {
+        LOG_INFO("%u more neighbor up/down event(s) not logged", ns->logSuppressed);
+    }
+    ns->logWindowStart = nowMs;
+    ns->logCount       = 0;
+    ns->logSuppressed  = 0;
+}
+
+static int eventLogAllow(NeighborState* ns, uint64_t nowMs) {
+    eventLogFlush(ns, nowMs);
+    if (ns->logCount < NEIGHBOR_LOG_BURST) {
+        ns->logCount++;
+        return 1;
+    }
+    ns->logSuppressed++;
+    return 0;
+}
+
 /******************************************************************************
  * createNeighbor
  ******************************************************************************/
-static NeighborNode* createNeighbor(const char* ip, unsigned short seq) {
-    NeighborNode* n = (NeighborNode*) malloc(sizeof(NeighborNode));
+static NeighborNode* createNeighbor(NeighborState* ns, uint32_t ip, unsigned link,
+                                    unsigned short seq, unsigned caps,
+                                    unsigned detectMs, const struct sockaddr_in* from,
+                                    uint64_t nowMs) {
+    NeighborNode* n = (NeighborNode*) slabAlloc(&ns->nbPool);
     if (!n) {
-        fprintf(stderr, "[ERROR] Out of memory creating neighbor.\n");
+        LOG_ERROR("Out of memory creating neighbor.");
         return NULL;
     }
-    strncpy(n->ip, ip, IP_STR_LEN - 1);
-    n->ip[IP_STR_LEN - 1] = '\0';
+    memset(n, 0, sizeof(*n));
+    n->ip        = ip;
+    n->link      = link;
     n->lastSeq   = seq;
-    n->lastHeard = nowInSeconds();
-    n->next      = g_neighborsHead;
-    g_neighborsHead = n;
+    n->caps      = caps;
+    n->detectMs  = detectMs;
+    n->received  = 1;
+    setNeighborAddr(n, from);
+    n->next      = ns->neighborsHead;
+    if (n->next) n->next->prev = n;
+    ns->neighborsHead = n;
+    ns->neighborCount++;
+    heardNeighbor(ns, n, nowMs);
     return n;
 }
 
 /******************************************************************************
- * neighborInit
+ * openLinkSocket
+ *   UDP socket on INADDR_ANY:5555 for link l, bound to its device if it
+ *   has one and we may (SO_BINDTODEVICE needs CAP_NET_RAW); *bound says
+ *   whether that worked.
  ******************************************************************************/
-int neighborInit(const char* myIp) {
-    if (!myIp) myIp = "0.0.0.0";
-    strncpy(g_myIP, myIp, IP_STR_LEN - 1);
-    g_myIP[IP_STR_LEN - 1] = '\0';
-
-    // Create socket
-    g_sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if (g_sock < 0) {
-        perror("[ERROR] socket()");
+static int openLinkSocket(const RouterLink* l, int* bound) {
+    *bound = 0;
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        LOG_ERROR("socket(): %s", strerror(errno));
         return -1;
     }
 
-    // Enable broadcast
-    int broadcastPermission = 1;
-    if (setsockopt(g_sock, SOL_SOCKET, SO_BROADCAST,
-                   &broadcastPermission, sizeof(broadcastPermission)) < 0) {
-        perror("[ERROR] setsockopt(SO_BROADCAST)");
-        close(g_sock);
-        g_sock = -1;
+    // Enable broadcast, and learn the arrival interface of each datagram
+    int on = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on)) < 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_PKTINFO, &on, sizeof(on)) < 0) {
+        LOG_ERROR("setsockopt(SO_BROADCAST/IP_PKTINFO): %s", strerror(errno));
+        close(sock);
         return -1;
     }
 
+    // One socket per device: each binds 5555 on its own device
+    if (l->name[0]) {
+        if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0) {
+            LOG_ERROR("setsockopt(SO_REUSEADDR): %s", strerror(errno));
+            close(sock);
+            return -1;
+        }
+        if (setsockopt(sock, SOL_SOCKET, SO_BINDTODEVICE, l->name,
+                       (socklen_t) strlen(l->name)) == 0) {
+            *bound = 1;
+        } else if (errno != EPERM) {
+            LOG_ERROR("setsockopt(SO_BINDTODEVICE): %s", strerror(errno));
+            close(sock);
+            return -1;
+        }
+    }
+
     // Bind to 5555
     struct sockaddr_in bindAddr;
     memset(&bindAddr, 0, sizeof(bindAddr));
     bindAddr.sin_family      = AF_INET;
     bindAddr.sin_addr.s_addr = htonl(INADDR_ANY);
-    bindAddr.sin_port        = htons(BROADCAST_PORT);
+    bindAddr.sin_port        = htons(ROUTER_PORT);
 
-    if (bind(g_sock, (struct sockaddr*)&bindAddr, sizeof(bindAddr)) < 0) {
-        perror("[ERROR] bind()");
-        close(g_sock);
-        g_sock = -1;
+    if (bind(sock, (struct sockaddr*)&bindAddr, sizeof(bindAddr)) < 0) {
+        LOG_ERROR("bind(): %s", strerror(errno));
+        close(sock);
         return -1;
     }
+    return sock;
+}
 
-    // Prepare broadcast address
-    memset(&g_broadcastAddr, 0, sizeof(g_broadcastAddr));
-    g_broadcastAddr.sin_family      = AF_INET;
-    g_broadcastAddr.sin_addr.s_addr = inet_addr(BROADCAST_IP);
-    g_broadcastAddr.sin_port        = htons(BROADCAST_PORT);
+/******************************************************************************
+ * closeLinkSockets
+ ******************************************************************************/
+static void closeLinkSockets(Router* router) {
+    for (unsigned i = 0; i < router->linkCount; i++) {
+        RouterLink* l = &router->links[i];
+        if (l->sock >= 0 && l->ownsSock) close(l->sock);
+        l->sock     = -1;
+        l->ownsSock = 0;
+    }
+}
 
-    g_neighborsHead = NULL;
-    g_helloSeq = 0;
+/******************************************************************************
+ * neighborInit
+ ******************************************************************************/
+int neighborInit(Router* router) {
+    if (router->linkCount == 0 &&
+        routerAddInterface(router, NULL, ROUTER_DEFAULT_COST) < 0) {
+        return -1;
+    }
+
+    int shared = -1; /* socket of links that could not bind to their device */
+    for (unsigned i = 0; i < router->linkCount; i++) {
+        RouterLink* l = &router->links[i];
+        if (shared >= 0) {
+            l->sock = shared;
+            continue;
+        }
+        int bound;
+        l->sock = openLinkSocket(l, &bound);
+        if (l->sock < 0) {
+            closeLinkSockets(router);
+            return -1;
+        }
+        l->ownsSock = 1;
+        if (l->name[0] && !bound) {
+            LOG_INFO("SO_BINDTODEVICE not permitted, links share one socket");
+            shared = l->sock;
+        }
+    }
 
-    printf("[INFO] neighborInit OK, myIP=%s, sock=%d\n", g_myIP, g_sock);
+    LOG_INFO("neighborInit OK, myIP=%s, %u link(s)", router->ipStr, router->linkCount);
+    for (unsigned i = 0; i < router->linkCount; i++) {
+        const RouterLink* l = &router->links[i];
+        char addrStr[IPV4_STR_LEN], bcastStr[IPV4_STR_LEN];
+        LOG_INFO("  link %u: %s %s cost=%u broadcast=%s sock=%d", i,
+                 l->name[0] ? l->name : "any", ipFormat(l->addr, addrStr), l->cost,
+                 ipFormat(ntohl(l->broadcastAddr.sin_addr.s_addr), bcastStr), l->sock);
+    }
     return 0;
 }
 
+/******************************************************************************
+ * neighborClear
+ *   Free the instance's neighbor list and snapshot.
+ ******************************************************************************/
+static void neighborClear(NeighborState* ns) {
+    pthread_mutex_lock(&ns->nbLock);
+    slabRelease(&ns->nbPool); /* every NeighborNode at once */
+    timerWheelInit(&ns->wheel, NEIGHBOR_TICK_MS);
+    ns->neighborsHead = NULL;
+    memset(ns->echoNext, 0, sizeof(ns->echoNext));
+    ns->neighborCount = 0;
+    ns->nbChanged = 1;
+    free(__atomic_exchange_n(&ns->nbSnapshot, NULL, __ATOMIC_SEQ_CST));
+    pthread_mutex_unlock(&ns->nbLock);
+}
+
 /******************************************************************************
  * neighborStop
  ******************************************************************************/
-void neighborStop(void) {
-    if (g_sock >= 0) {
-        close(g_sock);
-        g_sock = -1;
-    }
-    // free neighbor list
-    while (g_neighborsHead) {
-        NeighborNode* tmp = g_neighborsHead;
-        g_neighborsHead = tmp->next;
-        free(tmp);
+void neighborStop(Router* router) {
+    closeLinkSockets(router);
+    neighborClear(router->nb);
+}
+
+/******************************************************************************
+ * neighborStateCreate / neighborStateDestroy
+ ******************************************************************************/
+NeighborState* neighborStateCreate(void) {
+    NeighborState* ns = (NeighborState*) calloc(1, sizeof(NeighborState));
+    if (!ns) {
+        LOG_ERROR("Out of memory creating neighbor state.");
+        return NULL;
     }
+    pthread_mutex_init(&ns->nbLock, NULL);
+    slabInit(&ns->nbPool, sizeof(NeighborNode), NEIGHBORS_PER_SLAB);
+    timerWheelInit(&ns->wheel, NEIGHBOR_TICK_MS);
+    return ns;
+}
+
+void neighborStateDestroy(NeighborState* ns) {
+    if (!ns) return;
+    neighborClear(ns);
+    pthread_mutex_destroy(&ns->nbLock);
+    free(ns->costs);
+    free(ns);
 }
 
 /******************************************************************************
  * neighborSendHELLO
  ******************************************************************************/
-void neighborSendHELLO(void) {
-    if (g_sock < 0) return;
+void neighborSendHELLO(Router* router, unsigned link, SendQueue* q) {
+    if (!q || link >= router->linkCount) return;
 
-    char msg[128];
-    snprintf(msg, sizeof(msg), "%s:HELLO:%hu", g_myIP, g_helloSeq);
-    g_helloSeq++;
+    NeighborState* ns = router->nb;
+    uint64_t nowMs = routerNowMs(router);
+    uint32_t now = (uint32_t) nowMs;
+    char msg[NEIGHBOR_HELLO_MAX];
+    int len = snprintf(msg, sizeof(msg), "%s:HELLO:%hu:C%x:T%x", router->ipStr,
+                       ns->helloSeq[link], (unsigned) NEIGHBOR_LOCAL_CAPS, (unsigned) now);
+    ns->helloSeq[link]++;
 
-    ssize_t sent = sendto(g_sock, msg, strlen(msg), 0,
-                          (struct sockaddr*)&g_broadcastAddr,
-                          sizeof(g_broadcastAddr));
-    if (sent < 0) {
-        perror("[ERROR] sendto(HELLO)");
-    } else {
-        // Debug
-        printf("[DEBUG] Sent HELLO: %s\n", msg);
+    pthread_mutex_lock(&ns->nbLock);
+    if (ns->detectIntervalMs) {
+        len += snprintf(msg + len, sizeof(msg) - (size_t) len, ":D%x/%u",
+                        ns->detectIntervalMs, ns->detectMult);
+    }
+    eventLogFlush(ns, nowMs);
+    int quiet = ns->detectIntervalMs && ns->detectIntervalMs < 1000;
+
+    /* echo each neighbor's last T on this link; what doesn't fit waits for
+       the next HELLO, which resumes after the last one echoed (wrapping),
+       so every neighbor gets an echo within ceil(pending / fit) HELLOs */
+    NeighborNode* start = ns->echoNext[link] ? ns->echoNext[link] : ns->neighborsHead;
+    NeighborNode* cur = start;
+    for (size_t visited = 0; cur && visited < ns->neighborCount; visited++) {
+        NeighborNode* next = cur->next ? cur->next : ns->neighborsHead;
+        if (cur->link == link && cur->echoPending) {
+            char ipStr[IPV4_STR_LEN];
+            int n = snprintf(msg + len, sizeof(msg) - (size_t) len, ":E%s/%x/%u",
+                             ipFormat(cur->ip, ipStr), (unsigned) cur->peerTime,
+                             (unsigned) (now - cur->peerTimeAt));
+            if (n < 0 || (size_t) n >= sizeof(msg) - (size_t) len) {
+                msg[len] = '\0';
+                break;
+            }
+            len += n;
+            cur->echoPending = 0;
+        }
+        cur = next;
+    }
+    ns->echoNext[link] = cur;
+    pthread_mutex_unlock(&ns->nbLock);
+
+    if (sendQueuePush(q, msg, (size_t) len, &router->links[link].broadcastAddr) == 0 && !quiet) {
+        // Debug, not at sub-second intervals
+        LOG_DEBUG("Queued HELLO: %s", msg);
+    }
+}
+
+/******************************************************************************
+ * helloSeqArrived
+ *   Loss accounting for a HELLO with seq from an existing entry.
+ ******************************************************************************/
+static void helloSeqArrived(NeighborNode* nb, unsigned short seq) {
+    unsigned short ahead = (unsigned short) (seq - nb->lastSeq);
+    unsigned short behind = (unsigned short) (nb->lastSeq - seq);
+    if (ahead == 0) return; /* duplicate */
+
+    if (behind <= 64 && (nb->missed >> (behind - 1)) & 1) {
+        /* late: it was counted as lost when a newer one came */
+        nb->missed &= ~((uint64_t) 1 << (behind - 1));
+        nb->received++;
+        if (nb->lost) nb->lost--;
+        return;
+    }
+    if (behind < ahead || ahead > NEIGHBOR_SEQ_WINDOW) {
+        /* restarted neighbor, its seq began again; counters are kept */
+        nb->lastSeq = seq;
+        nb->missed  = 0;
+        nb->received++;
+        return;
+    }
+    for (unsigned i = 1; i < ahead; i++) {
+        nb->lossQ16 += (NEIGHBOR_LOSS_ONE - nb->lossQ16) >> 3;
+    }
+    nb->lossQ16 -= nb->lossQ16 >> 3;
+    nb->lost     += (uint32_t) (ahead - 1);
+    nb->received++;
+    nb->lastSeq = seq;
+    /* the old seqs move ahead bits, the skipped ones take the low bits */
+    nb->missed  = ahead < 64 ? nb->missed << ahead : 0;
+    nb->missed |= ahead > 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << (ahead - 1)) - 1;
+}
+
+/******************************************************************************
+ * helloTimeArrived
+ *   Jitter from the HELLO's send time, RTT from its echo of ours.
+ ******************************************************************************/
+static void helloTimeArrived(NeighborNode* nb, const NeighborHello* h, uint32_t now) {
+    if (h->hasTime) {
+        if (nb->hasTime) {
+            /* difference of transit times; the clock offset cancels */
+            int32_t d = (int32_t) ((now - h->time) - (nb->peerTimeAt - nb->peerTime));
+            int64_t dUs = (int64_t) (d < 0 ? -(int64_t) d : d) * 1000;
+            if (dUs > NEIGHBOR_JITTER_MAX_US) dUs = NEIGHBOR_JITTER_MAX_US; /* clock step */
+            nb->jitterUs = (unsigned) ((int64_t) nb->jitterUs + (dUs - (int64_t) nb->jitterUs) / 16);
+        }
+        nb->peerTime    = h->time;
+        nb->peerTimeAt  = now;
+        nb->hasTime     = 1;
+        nb->echoPending = 1;
+    }
+
+    if (h->hasEcho) {
+        int32_t rtt = (int32_t) (now - h->echoTime - h->echoHeldMs);
+        if (rtt < 0) return; /* clock stepped */
+        unsigned r = (unsigned) rtt * 1000u;
+        if (!nb->rttSamples) {
+            nb->srttUs   = r;
+            nb->rttVarUs = r / 2;
+        } else {
+            unsigned dev = r > nb->srttUs ? r - nb->srttUs : nb->srttUs - r;
+            nb->rttVarUs = (3 * nb->rttVarUs + dev) / 4;
+            nb->srttUs   = (7 * nb->srttUs + r) / 8;
+        }
+        nb->rttSamples++;
     }
 }
 
 /******************************************************************************
  * neighborProcessHELLO
  ******************************************************************************/
-void neighborProcessHELLO(const char* senderIP, unsigned short seq) {
-    if (!senderIP) return;
-    if (strcmp(senderIP, g_myIP) == 0) {
+int neighborProcessHELLO(Router* router, unsigned link, uint32_t senderIP,
+                         const NeighborHello* hello, const struct sockaddr_in* from) {
+    if (senderIP == router->ip) {
         // ignore self
-        return;
+        return 0;
     }
 
-    NeighborNode* nb = findNeighbor(senderIP);
+    NeighborState* ns = router->nb;
+    uint64_t nowMs = routerNowMs(router);
+    int isNew = 0, logIt = 0;
+    pthread_mutex_lock(&ns->nbLock);
+    NeighborNode* nb = findNeighbor(ns, senderIP, link);
     if (!nb) {
-        nb = createNeighbor(senderIP, seq);
-        if (nb) {
-            printf("[INFO] New neighbor discovered: %s (seq=%u)\n", senderIP, seq);
-        }
+        nb = createNeighbor(ns, senderIP, link, hello->seq, hello->caps,
+                            detectTime(hello), from, nowMs);
+        isNew = (nb != NULL);
+        logIt = isNew && eventLogAllow(ns, nowMs);
     } else {
-        if (seq > nb->lastSeq) {
-            nb->lastSeq = seq;
+        helloSeqArrived(nb, hello->seq);
+        nb->caps     = hello->caps;
+        nb->detectMs = detectTime(hello);
+        heardNeighbor(ns, nb, nowMs);
+        setNeighborAddr(nb, from);
+    }
+    if (nb) helloTimeArrived(nb, hello, (uint32_t) nowMs);
+    ns->nbChanged = 1;
+    pthread_mutex_unlock(&ns->nbLock);
+
+    if (logIt) {
+        char ipStr[IPV4_STR_LEN];
+        LOG_INFO("New neighbor discovered: %s on link %u (seq=%u)",
+                 ipFormat(senderIP, ipStr), link, hello->seq);
+    }
+    return isNew;
+}
+
+/******************************************************************************
+ * neighborAllHaveCaps
+ ******************************************************************************/
+int neighborAllHaveCaps(Router* router, unsigned caps) {
+    rcuReadLock();
+    const NeighborSnapshot* s = __atomic_load_n(&router->nb->nbSnapshot, __ATOMIC_ACQUIRE);
+    int all = (s && s->count > 0);
+    for (size_t i = 0; all && i < s->count; i++) {
+        if ((s->nb[i].caps & caps) != caps) all = 0;
+    }
+    rcuReadUnlock();
+    return all;
+}
+
+/******************************************************************************
+ * neighborGetPeers
+ ******************************************************************************/
+NeighborPeer* neighborGetPeers(Router* router, size_t* count) {
+    NeighborPeer* peers = NULL;
+    *count = 0;
+    rcuReadLock();
+    const NeighborSnapshot* s = __atomic_load_n(&router->nb->nbSnapshot, __ATOMIC_ACQUIRE);
+    if (s && s->count) {
+        peers = (NeighborPeer*) malloc(s->count * sizeof(NeighborPeer));
+        if (peers) {
+            for (size_t i = 0; i < s->count; i++) {
+                peers[i].ip   = s->nb[i].ip;
+                peers[i].link = s->nb[i].link;
+                peers[i].caps = s->nb[i].caps;
+                peers[i].addr = s->nb[i].addr;
+            }
+            *count = s->count;
         }
-        nb->lastHeard = nowInSeconds();
     }
+    rcuReadUnlock();
+    return peers;
+}
+
+/******************************************************************************
+ * neighborGetStats
+ ******************************************************************************/
+NeighborStats* neighborGetStats(Router* router, size_t* count) {
+    NeighborStats* stats = NULL;
+    *count = 0;
+    rcuReadLock();
+    const NeighborSnapshot* s = __atomic_load_n(&router->nb->nbSnapshot, __ATOMIC_ACQUIRE);
+    if (s && s->count) {
+        stats = (NeighborStats*) malloc(s->count * sizeof(NeighborStats));
+        if (stats) {
+            for (size_t i = 0; i < s->count; i++) stats[i] = s->nb[i].stats;
+            *count = s->count;
+        }
+    }
+    rcuReadUnlock();
+    return stats;
+}
+
+/******************************************************************************
+ * expireNeighbor
+ *   Timer callback of neighborRemoveStale(): unlink and free the entry.
+ ******************************************************************************/
+typedef struct ExpireCtx {
+    NeighborState* ns;
+    uint64_t now;
+    uint32_t* lost;         /* inline, or malloc'd once more expire */
+    size_t lostCount;
+    size_t lostCap;
+    uint32_t inlineLost[16];
+} ExpireCtx;
+
+static void expireNeighbor(void* ctx, TimerNode* t) {
+    ExpireCtx* ec = (ExpireCtx*) ctx;
+    NeighborState* ns = ec->ns;
+    NeighborNode* nb = (NeighborNode*) ((char*) t - offsetof(NeighborNode, timer));
+
+    if (ec->lostCount == ec->lostCap) {
+        size_t newCap = ec->lostCap * 4;
+        uint32_t* l = (uint32_t*) malloc(newCap * sizeof(uint32_t));
+        if (!l) {
+            /* caught on a later pass */
+            timerSchedule(&ns->wheel, t, ec->now, ec->now + NEIGHBOR_TICK_MS);
+            return;
+        }
+        memcpy(l, ec->lost, ec->lostCount * sizeof(uint32_t));
+        if (ec->lost != ec->inlineLost) free(ec->lost);
+        ec->lost    = l;
+        ec->lostCap = newCap;
+    }
+    if (eventLogAllow(ns, ec->now)) {
+        char ipStr[IPV4_STR_LEN];
+        LOG_INFO("Removing stale neighbor: %s on link %u (silent %u ms)",
+                 ipFormat(nb->ip, ipStr), nb->link, (unsigned) (ec->now - nb->lastHeard));
+    }
+    ec->lost[ec->lostCount++] = nb->ip;
+    for (unsigned i = 0; i < ROUTER_MAX_LINKS; i++) {
+        if (ns->echoNext[i] == nb) ns->echoNext[i] = nb->next;
+    }
+    if (nb->prev) nb->prev->next = nb->next;
+    else          ns->neighborsHead = nb->next;
+    if (nb->next) nb->next->prev = nb->prev;
+    slabFree(&ns->nbPool, nb);
+    ns->neighborCount--;
+    ns->nbChanged = 1;
 }
 
 /******************************************************************************
  * neighborRemoveStale
  ******************************************************************************/
-void neighborRemoveStale(void) {
-    time_t now = nowInSeconds();
-    NeighborNode** ptr = &g_neighborsHead;
-    while (*ptr) {
-        double diff = difftime(now, (*ptr)->lastHeard);
-        if (diff > NEIGHBOR_TIMEOUT_SEC) {
-            printf("[INFO] Removing stale neighbor: %s\n", (*ptr)->ip);
-            NeighborNode* toDel = *ptr;
-            *ptr = toDel->next;
-            free(toDel);
+void neighborRemoveStale(Router* router) {
+    NeighborState* ns = router->nb;
+    ExpireCtx ec;
+    ec.ns        = ns;
+    ec.now       = routerNowCoarseMs(router);
+    ec.lost      = ec.inlineLost;
+    ec.lostCount = 0;
+    ec.lostCap   = sizeof(ec.inlineLost) / sizeof(ec.inlineLost[0]);
+    pthread_mutex_lock(&ns->nbLock);
+    timerAdvance(&ns->wheel, ec.now, expireNeighbor, &ec);
+
+    /* still heard on another link => not lost */
+    size_t keep = 0;
+    for (size_t i = 0; i < ec.lostCount; i++) {
+        int elsewhere = 0;
+        for (NeighborNode* cur = ns->neighborsHead; cur && !elsewhere; cur = cur->next) {
+            elsewhere = (cur->ip == ec.lost[i]);
+        }
+        if (!elsewhere) ec.lost[keep++] = ec.lost[i];
+    }
+    pthread_mutex_unlock(&ns->nbLock);
+    neighborPublish(router);
+
+    /* outside the neighbor lock: the handler takes the route table's lock */
+    for (size_t i = 0; ns->lossHandler && i < keep; i++) {
+        ns->lossHandler(router, ec.lost[i]);
+    }
+    if (ec.lost != ec.inlineLost) free(ec.lost);
+}
+
+/******************************************************************************
+ * neighborNextTimeout
+ ******************************************************************************/
+uint64_t neighborNextTimeout(Router* router) {
+    NeighborState* ns = router->nb;
+    pthread_mutex_lock(&ns->nbLock);
+    uint64_t next = timerNextExpiry(&ns->wheel);
+    pthread_mutex_unlock(&ns->nbLock);
+    return next;
+}
+
+/******************************************************************************
+ * neighborSetLossHandler
+ ******************************************************************************/
+void neighborSetLossHandler(Router* router, void (*handler)(Router* router, uint32_t ip)) {
+    router->nb->lossHandler = handler;
+}
+
+/******************************************************************************
+ * neighborLinkCost
+ ******************************************************************************/
+static unsigned measuredCost(const NeighborState* ns, const NeighborNode* nb, unsigned cost) {
+    if (!ns->rttCostMs) return cost;
+    uint64_t c = cost;
+    if (nb->rttSamples) c += nb->srttUs / (1000u * ns->rttCostMs);
+    uint32_t loss = nb->lossQ16 < NEIGHBOR_LOSS_CAP ? nb->lossQ16 : NEIGHBOR_LOSS_CAP;
+    c = (c * NEIGHBOR_LOSS_ONE + (NEIGHBOR_LOSS_ONE - loss) / 2) / (NEIGHBOR_LOSS_ONE - loss);
+    return c > 0xFFFF ? 0xFFFF : (unsigned) c;
+}
+
+unsigned neighborLinkCost(Router* router, uint32_t ip) {
+    NeighborState* ns = router->nb;
+    unsigned best = 0;
+    pthread_mutex_lock(&ns->nbLock);
+    for (NeighborNode* cur = ns->neighborsHead; cur; cur = cur->next) {
+        if (cur->ip != ip || cur->link >= router->linkCount) continue;
+        unsigned cost = measuredCost(ns, cur, router->links[cur->link].cost);
+        if (!best || cost < best) best = cost;
+    }
+    for (size_t i = 0; best && i < ns->costCount; i++) {
+        if (ns->costs[i].ip == ip) {
+            best = ns->costs[i].cost;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&ns->nbLock);
+    return best;
+}
+
+/******************************************************************************
+ * neighborSetRttCost
+ ******************************************************************************/
+void neighborSetRttCost(Router* router, unsigned rttMs) {
+    NeighborState* ns = router->nb;
+    pthread_mutex_lock(&ns->nbLock);
+    ns->rttCostMs = rttMs;
+    pthread_mutex_unlock(&ns->nbLock);
+}
+
+/******************************************************************************
+ * neighborSetDetect
+ ******************************************************************************/
+void neighborSetDetect(Router* router, unsigned intervalMs, unsigned mult) {
+    NeighborState* ns = router->nb;
+    if (intervalMs && intervalMs < NEIGHBOR_DETECT_MIN_MS) intervalMs = NEIGHBOR_DETECT_MIN_MS;
+    if (mult < 1) mult = 1;
+    if (mult > 255) mult = 255;
+    pthread_mutex_lock(&ns->nbLock);
+    ns->detectIntervalMs = intervalMs;
+    ns->detectMult       = mult;
+    pthread_mutex_unlock(&ns->nbLock);
+}
+
+/******************************************************************************
+ * neighborSetCost
+ ******************************************************************************/
+int neighborSetCost(Router* router, uint32_t ip, unsigned cost) {
+    NeighborState* ns = router->nb;
+    int rc = 0;
+    pthread_mutex_lock(&ns->nbLock);
+    size_t i = 0;
+    while (i < ns->costCount && ns->costs[i].ip != ip) i++;
+    if (!cost) {
+        if (i < ns->costCount) ns->costs[i] = ns->costs[--ns->costCount];
+    } else if (i < ns->costCount) {
+        ns->costs[i].cost = cost;
+    } else {
+        if (ns->costCount == ns->costCap) {
+            size_t newCap = ns->costCap ? ns->costCap * 2 : 8;
+            NeighborCost* c = (NeighborCost*) realloc(ns->costs, newCap * sizeof(NeighborCost));
+            if (!c) {
+                LOG_ERROR("Out of memory setting neighbor cost.");
+                rc = -1;
+            } else {
+                ns->costs   = c;
+                ns->costCap = newCap;
+            }
+        }
+        if (rc == 0) {
+            ns->costs[ns->costCount].ip   = ip;
+            ns->costs[ns->costCount].cost = cost;
+            ns->costCount++;
+        }
+    }
+    pthread_mutex_unlock(&ns->nbLock);
+    return rc;
+}
+
+/******************************************************************************
+ * neighborPublish
+ ******************************************************************************/
+void neighborPublish(Router* router) {
+    NeighborState* ns = router->nb;
+    pthread_mutex_lock(&ns->nbLock);
+    if (ns->nbChanged) {
+        NeighborSnapshot* s = (NeighborSnapshot*) malloc(
+            sizeof(NeighborSnapshot) + ns->neighborCount * sizeof(NeighborInfo));
+        if (s) {
+            size_t i = 0;
+            for (NeighborNode* cur = ns->neighborsHead; cur; cur = cur->next, i++) {
+                s->nb[i].ip        = cur->ip;
+                s->nb[i].link      = cur->link;
+                s->nb[i].lastSeq   = cur->lastSeq;
+                s->nb[i].caps      = cur->caps;
+                s->nb[i].lastHeard = cur->lastHeard;
+                s->nb[i].addr      = cur->addr;
+
+                NeighborStats* st = &s->nb[i].stats;
+                st->ip         = cur->ip;
+                st->link       = cur->link;
+                st->rttSamples = cur->rttSamples;
+                st->srttUs     = cur->srttUs;
+                st->rttVarUs   = cur->rttVarUs;
+                st->jitterUs   = cur->jitterUs;
+                st->loss       = (double) cur->lossQ16 / NEIGHBOR_LOSS_ONE;
+                st->received   = cur->received;
+                st->lost       = cur->lost;
+                st->detectMs   = cur->detectMs;
+            }
+            s->count = i;
+            rcuRetire(__atomic_exchange_n(&ns->nbSnapshot, s, __ATOMIC_SEQ_CST), free);
+            ns->nbChanged = 0;
         } else {
-            ptr = &((*ptr)->next);
+            LOG_ERROR("Out of memory publishing neighbor table.");
         }
     }
+    pthread_mutex_unlock(&ns->nbLock);
+    rcuReclaim();
 }
 
 /******************************************************************************
  * neighborPrintTable
  ******************************************************************************/
-void neighborPrintTable(void) {
+void neighborPrintTable(Router* router) {
+    logFlush();  /* printed directly: after the lines queued before it */
     printf("--- Neighbor Table ---\n");
-    time_t now = nowInSeconds();
-    for (NeighborNode* cur = g_neighborsHead; cur; cur = cur->next) {
-        double diff = difftime(now, cur->lastHeard);
-        printf("  %s (seq=%u, lastHeard=%.0f s ago)\n",
-               cur->ip, cur->lastSeq, diff);
+    uint64_t now = routerNowMs(router);
+    rcuReadLock();
+    const NeighborSnapshot* s = __atomic_load_n(&router->nb->nbSnapshot, __ATOMIC_ACQUIRE);
+    for (size_t i = 0; s && i < s->count; i++) {
+        const NeighborInfo* cur = &s->nb[i];
+        double diff = (double) (int64_t) (now - cur->lastHeard) / 1e3;
+        char ipStr[IPV4_STR_LEN];
+        const char* link = (cur->link < router->linkCount && router->links[cur->link].name[0])
+                               ? router->links[cur->link].name : "any";
+        const NeighborStats* st = &cur->stats;
+        printf("  %s on %s (seq=%u, caps=0x%x, lastHeard=%.1f s ago)",
+               ipFormat(cur->ip, ipStr), link, cur->lastSeq, cur->caps, diff);
+        if (st->rttSamples) {
+            printf(" rtt=%.3f+-%.3f ms", st->srttUs / 1e3, st->rttVarUs / 1e3);
+        }
+        printf(" jitter=%.3f ms loss=%.1f%% (%u/%u lost) detect=%u ms\n", st->jitterUs / 1e3,
+               st->loss * 100.0, st->lost, st->lost + st->received, st->detectMs);
     }
+    rcuReadUnlock();
     printf("----------------------\n");
+
+    SlabStats st;
+    neighborPoolStats(router, &st);
+    printf("  neighbor pool: %zu/%zu in use (peak %zu), %zu slab(s), %zu bytes\n",
+           st.inUse, st.capacity, st.peakInUse, st.chunks, st.bytes);
+}
+
+/******************************************************************************
+ * neighborPoolStats
+ ******************************************************************************/
+void neighborPoolStats(Router* router, SlabStats* out) {
+    NeighborState* ns = router->nb;
+    pthread_mutex_lock(&ns->nbLock);
+    slabStats(&ns->nbPool, out);
+    pthread_mutex_unlock(&ns->nbLock);
 }
@@ -4,62 +4,243 @@
  * Part 1: Neighbour Detection
  * 
  * Required for:
- *  - neighborInit(const char* myIp)  -> sets up UDP sock 5555, broadcast enabled
- *  - neighborStop()                 -> frees neighbor list, closes sock
- *  - neighborSendHELLO()            -> sends "myIp:HELLO:seq" to broadcast
- *  - neighborProcessHELLO(ip, seq)  -> updates neighbor table
- *  - neighborRemoveStale()          -> removes neighbors with no fresh HELLO in >10s
+ *  - neighborInit(router)           -> sets up UDP sock 5555 per link, broadcast enabled
+ *  - neighborStop()                 -> frees neighbor list, closes socks
+ *  - neighborSendHELLO(link, q)     -> queues "myIp:HELLO:seq:C<caps>:T<ms>[:E...]"
+ *                                      to the link's broadcast address
+ *  - neighborProcessHELLO(link, ip, hello, from) -> updates neighbor table and
+ *                                      its link measurements
+ *  - neighborAllHaveCaps(caps)      -> capability negotiation for DV format
+ *  - neighborGetPeers(&n)           -> current neighbors with their link and address
+ *  - neighborLinkCost(ip)           -> cheapest link a neighbor is heard on,
+ *                                      or its configured cost
+ *  - neighborSetCost(ip, cost)      -> configure a neighbor's cost
+ *  - neighborSetRttCost(ms)         -> derive costs from RTT and loss
+ *  - neighborSetDetect(ms, mult)    -> announce fast failure detection
+ *  - neighborGetStats(&n)           -> RTT, jitter and loss per neighbor and link
+ *  - neighborRemoveStale()          -> removes neighbors silent for their detection time
+ *  - neighborNextTimeout()          -> when neighborRemoveStale() has work next
+ *  - neighborPublish()              -> snapshot the table for lock-free readers
  *  - neighborPrintTable()           -> debug
+ *  - neighborPoolStats()            -> NeighborNode pool occupancy
+ *  - neighborSetLossHandler(fn)     -> fn(router, ip) for every neighbor removed
+ *                                      as stale
  *
+ * Every function works on the Router it is given (router.h).
+ *
+ * Link measurement: each HELLO carries the sender's clock (routerNowMs(),
+ * 32-bit ms) as ":T<hex>", and echoes the last T heard from each neighbor
+ * on that link as ":E<ip>/<hex T>/<ms held>". The neighbor named in an
+ * echo gets RTT = now - T - held on its own clock, so the two clocks need
+ * not agree. Jitter is the RFC 3550 interarrival jitter of a neighbor's
+ * HELLOs; loss comes from gaps in its HELLO seq (per link, wrapping at
+ * 65536). Old peers send neither token and ignore ours.
+ *
+ * Failure detection: a neighbor is dropped when no HELLO came for its
+ * detection time, 10 s unless it announced ":D<hex interval ms>/<mult>"
+ * (neighborSetDetect()), in which case it is interval * mult, as a BFD
+ * session's remote detect multiplier times its transmit interval. So each
+ * side picks how fast it is declared down, and a peer in the default
+ * mode keeps the 10 s. New and lost neighbors are logged at most
+ * NEIGHBOR_LOG_BURST times a second, the rest as a count.
  ******************************************************************************/
 
 #ifndef NEIGHBOR_H
 #define NEIGHBOR_H
 
+#include <stdint.h>
 #include <arpa/inet.h>
+#include "netio.h"
+#include "router.h"
+#include "slab.h"
 
-/* 
- * Global socket & broadcast address:
- *    - g_sock: The UDP socket bound to port 5555
- *    - g_broadcastAddr: The broadcast address (255.255.255.255:5555)
+/*
+ * Capability bits advertised in HELLO as a trailing ":C<hex>" token.
+ * Old peers send no token (caps=0) and ignore ours.
  */
-extern int g_sock;
-extern struct sockaddr_in g_broadcastAddr;
+#define NEIGHBOR_CAP_DV_BINARY 0x1   /* understands binary DVs (dvcodec.h) */
+#define NEIGHBOR_LOCAL_CAPS    (NEIGHBOR_CAP_DV_BINARY)
+
+#define NEIGHBOR_DETECT_MIN_MS  10   /* shortest announced HELLO interval */
+#define NEIGHBOR_DETECT_MULT    3    /* default detect multiplier */
+#define NEIGHBOR_LOG_BURST      10   /* neighbor up/down lines per second */
+
+/* Fields of a received HELLO (messageDispatch()). */
+typedef struct NeighborHello {
+    unsigned short seq;
+    unsigned caps;             /* NEIGHBOR_CAP_* bits, 0 if none */
+    int hasTime;               /* 1 => time is the sender's clock at send */
+    uint32_t time;
+    int hasEcho;               /* 1 => it echoes one of our HELLOs */
+    uint32_t echoTime;         /* our T it echoes */
+    uint32_t echoHeldMs;       /* between our HELLO arriving and this one */
+    unsigned detectMs;         /* its HELLO interval, 0 => not announced */
+    unsigned detectMult;       /* missed HELLOs before it counts as down */
+} NeighborHello;
+
+/* Link quality to a neighbor, measured from HELLOs. */
+typedef struct NeighborStats {
+    uint32_t ip;
+    unsigned link;             /* Router.links index */
+    unsigned rttSamples;       /* echoes received; RTT fields valid if > 0 */
+    unsigned srttUs;           /* smoothed RTT (RFC 6298 gains) */
+    unsigned rttVarUs;         /* RTT mean deviation */
+    unsigned jitterUs;         /* interarrival jitter of its HELLOs */
+    double loss;               /* smoothed fraction of its HELLOs lost */
+    uint32_t received;         /* HELLOs received */
+    uint32_t lost;             /* HELLOs missing from its seq */
+    unsigned detectMs;         /* silence after which it is dropped */
+} NeighborStats;
+
+/* A neighbor as seen by the DV sender (per-neighbor unicast DVs). */
+typedef struct NeighborPeer {
+    uint32_t ip;               /* host order, as in its HELLO */
+    unsigned link;             /* Router.links index it is heard on */
+    unsigned caps;
+    struct sockaddr_in addr;   /* where its HELLOs came from */
+} NeighborPeer;
 
 /**
  * @brief Initialize neighbor detection:
- *   - Creates a UDP socket on port 5555 (g_sock).
- *   - Enable broadcast, bind to INADDR_ANY:5555.
- *   - Prepares g_broadcastAddr for 255.255.255.255:5555.
- * @param myIp  The local IP address in dotted-decimal (for logging/HELLO).
+ *   - Adds the any link (255.255.255.255) if the router has no links.
+ *   - Creates a UDP socket on port 5555 per link (RouterLink.sock), bound
+ *     to the link's device; if SO_BINDTODEVICE is not permitted the links
+ *     share one socket.
+ *   - Enable broadcast and IP_PKTINFO, bind to INADDR_ANY:5555.
+ * Routers that never touch the network (simulation) skip it.
  * @return 0 on success, non-zero on error.
  */
-int neighborInit(const char* myIp);
+int neighborInit(Router* router);
 
 /**
  * @brief Stop neighbor detection (close socket, free neighbor list).
  */
-void neighborStop(void);
+void neighborStop(Router* router);
+
+/**
+ * @brief Queue a HELLO message in ASCII: "myIp:HELLO:seq:C<caps>:T<ms>",
+ *        ":D<interval>/<mult>" if set (neighborSetDetect()), plus an echo
+ *        for each neighbor on the link heard since the last one, on q,
+ *        addressed to the link's broadcastAddr. seq counts per link. q
+ *        must send on the link's socket; the caller flushes it.
+ */
+void neighborSendHELLO(Router* router, unsigned link, SendQueue* q);
+
+/**
+ * @brief Process a received HELLO message: if new neighbor => add it, else
+ *        refresh it and update its loss, jitter and (given an echo) RTT.
+ * @param link      Link it came in on (routerLinkFor()).
+ * @param senderIP  Sender address in host byte order (see ipaddr.h).
+ * @param hello     Its seq, caps and timing fields.
+ * @param from      Source address of the datagram; NULL => senderIP:5555.
+ * @return 1 if this is a newly discovered neighbor (on this link), else 0.
+ */
+int neighborProcessHELLO(Router* router, unsigned link, uint32_t senderIP,
+                         const NeighborHello* hello, const struct sockaddr_in* from);
+
+/**
+ * @brief 1 if there is at least one neighbor and every neighbor advertised
+ *        all bits in caps, else 0. Lock-free, uses the published snapshot.
+ */
+int neighborAllHaveCaps(Router* router, unsigned caps);
+
+/**
+ * @brief Copy of the published neighbor list. Lock-free.
+ * @param count  Set to the number of neighbors.
+ * @return malloc'd array (caller frees), NULL if there are none or on
+ *         allocation failure.
+ */
+NeighborPeer* neighborGetPeers(Router* router, size_t* count);
+
+/**
+ * @brief Cost of the cheapest link ip is currently heard on, or the cost
+ *        configured with neighborSetCost().
+ * @return 0 if ip is not a neighbor.
+ */
+unsigned neighborLinkCost(Router* router, uint32_t ip);
+
+/**
+ * @brief Configure the cost of neighbor ip whatever link it is heard on;
+ *        0 reverts to the link cost. Applied by its next HELLO.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int neighborSetCost(Router* router, uint32_t ip, unsigned cost);
+
+/**
+ * @brief Measured costs: a link costs its configured cost plus one per
+ *        rttMs of smoothed RTT, divided by the fraction of HELLOs that
+ *        arrive (at most x10). 0 (the default) => configured costs only.
+ *        neighborSetCost() still overrides.
+ */
+void neighborSetRttCost(Router* router, unsigned rttMs);
+
+/**
+ * @brief Measurements for every neighbor entry in the published table.
+ *        Lock-free.
+ * @param count  Set to the number of entries.
+ * @return malloc'd array (caller frees), NULL if there are none or on
+ *         allocation failure.
+ */
+NeighborStats* neighborGetStats(Router* router, size_t* count);
+
+/**
+ * @brief Announce that we send HELLOs every intervalMs (clamped to at
+ *        least NEIGHBOR_DETECT_MIN_MS) and should be declared down after
+ *        mult (1..255) missed ones. The caller sends them that often.
+ *        intervalMs == 0 stops announcing: neighbors use 10 s again.
+ */
+void neighborSetDetect(Router* router, unsigned intervalMs, unsigned mult);
+
+/**
+ * @brief Remove neighbors that haven't sent HELLO for their detection
+ *        time (10 s, or as they announced) on a link, then publish and
+ *        run the loss handler for each one no longer heard on any link.
+ *        Costs O(removed): timeouts are kept in a timer wheel
+ *        (timerwheel.h) with a 10 ms tick.
+ */
+void neighborRemoveStale(Router* router);
+
+/**
+ * @brief Router time at or before which the next neighbor may time out,
+ *        UINT64_MAX if there are none. neighborRemoveStale() reads
+ *        routerNowCoarseMs(), so it removes nothing until that clock
+ *        reaches the deadline, up to routerCoarseResMs() after
+ *        routerNowMs() does.
+ */
+uint64_t neighborNextTimeout(Router* router);
+
+/**
+ * @brief Register a callback run (from neighborRemoveStale()) with the IP
+ *        of each neighbor dropped as stale, so its routes can be withdrawn.
+ */
+void neighborSetLossHandler(Router* router, void (*handler)(Router* router, uint32_t ip));
+
+/**
+ * @brief Publish the neighbor list as a new immutable snapshot for readers
+ *        (no-op if unchanged). The receiver calls it once per receive batch.
+ */
+void neighborPublish(Router* router);
 
 /**
- * @brief Send a HELLO message in ASCII: "myIp:HELLO:seq".
+ * @brief Print the published neighbor table (debug) and pool usage.
  */
-void neighborSendHELLO(void);
+void neighborPrintTable(Router* router);
 
 /**
- * @brief Process a received HELLO message: if new neighbor => add it, else refresh
+ * @brief Occupancy of the NeighborNode pool.
  */
-void neighborProcessHELLO(const char* senderIP, unsigned short seq);
+void neighborPoolStats(Router* router, SlabStats* out);
 
 /**
- * @brief Remove neighbors that haven't sent HELLO for > 10s.
+ * @brief Empty neighbor table for routerCreate().
+ * @return NULL on allocation failure.
  */
-void neighborRemoveStale(void);
+NeighborState* neighborStateCreate(void);
 
 /**
- * @brief Print the current neighbor table (debug).
+ * @brief Free a table made by neighborStateCreate(). NULL is a no-op.
  */
-void neighborPrintTable(void);
+void neighborStateDestroy(NeighborState* ns);
 
 #ifdef __cplusplus
 }
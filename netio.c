@@ -0,0 +1,230 @@
+/******************************************************************************
+ * File: netio.c
+ *
+ * Batched datagram I/O (see netio.h). One recvmmsg() replaces a recvfrom()
+ * per packet; the buffers are allocated once and reused for every batch.
+ * On the send side datagrams are copied into a SendQueue during a tick and
+ * go out together with sendmmsg().
+ *
+ * Each receive slot also has a control buffer, so sockets with IP_PKTINFO
+ * on report the interface every datagram arrived on.
+ ******************************************************************************/
+
+#include "netio.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "log.h"
+
+/******************************************************************************
+ * recvBatchInit
+ ******************************************************************************/
+int recvBatchInit(RecvBatch* b, size_t bufSize) {
+    memset(b, 0, sizeof(*b));
+    b->bufs = (char*) malloc(NETIO_RECV_BATCH * (bufSize + 1));
+    /* cmsghdr-aligned, one block for every slot */
+    b->ctrl[0] = (struct cmsghdr*) malloc(NETIO_RECV_BATCH * NETIO_CTRL_SIZE);
+    if (!b->bufs || !b->ctrl[0]) {
+        LOG_ERROR("Out of memory allocating receive ring.");
+        recvBatchFree(b);
+        return -1;
+    }
+    b->bufSize = bufSize;
+    for (int i = 0; i < NETIO_RECV_BATCH; i++) {
+        b->iovs[i].iov_base = b->bufs + (size_t) i * (bufSize + 1);
+        b->iovs[i].iov_len  = bufSize;
+        b->ctrl[i] = (struct cmsghdr*) ((char*) b->ctrl[0] + (size_t) i * NETIO_CTRL_SIZE);
+    }
+    return 0;
+}
+
+/******************************************************************************
+ * recvBatchFree
+ ******************************************************************************/
+void recvBatchFree(RecvBatch* b) {
+    free(b->bufs);
+    free(b->ctrl[0]);
+    b->bufs = NULL;
+    memset(b->ctrl, 0, sizeof(b->ctrl));
+    b->count = 0;
+}
+
+/******************************************************************************
+ * pktinfoIfindex
+ *   Interface index from the IP_PKTINFO control message of h, 0 if none.
+ ******************************************************************************/
+static int pktinfoIfindex(struct msghdr* h) {
+    for (struct cmsghdr* c = CMSG_FIRSTHDR(h); c; c = CMSG_NXTHDR(h, c)) {
+        if (c->cmsg_level == IPPROTO_IP && c->cmsg_type == IP_PKTINFO) {
+            struct in_pktinfo pi;
+            memcpy(&pi, CMSG_DATA(c), sizeof(pi));
+            return pi.ipi_ifindex;
+        }
+    }
+    return 0;
+}
+
+/******************************************************************************
+ * readBatch
+ ******************************************************************************/
+static int readBatch(RecvBatch* b, int fd, int flags) {
+    /* recvmmsg() overwrites msg_hdr fields, so re-arm every slot */
+    for (int i = 0; i < NETIO_RECV_BATCH; i++) {
+        struct msghdr* h = &b->msgs[i].msg_hdr;
+        h->msg_name       = &b->from[i];
+        h->msg_namelen    = sizeof(b->from[i]);
+        h->msg_iov        = &b->iovs[i];
+        h->msg_iovlen     = 1;
+        h->msg_control    = b->ctrl[i];
+        h->msg_controllen = NETIO_CTRL_SIZE;
+        h->msg_flags      = 0;
+    }
+
+    int n = recvmmsg(fd, b->msgs, NETIO_RECV_BATCH, flags, NULL);
+    if (n < 0) {
+        b->count = 0;
+        return -1;
+    }
+
+    /* drop truncated datagrams, NUL-terminate the rest for the text parser */
+    int kept = 0;
+    for (int i = 0; i < n; i++) {
+        if (b->msgs[i].msg_hdr.msg_flags & MSG_TRUNC) continue;
+        b->ifindex[kept] = pktinfoIfindex(&b->msgs[i].msg_hdr);
+        if (kept != i) {
+            struct iovec tmp = b->iovs[kept];
+            b->iovs[kept] = b->iovs[i];
+            b->iovs[i] = tmp;
+            b->msgs[kept].msg_len = b->msgs[i].msg_len;
+            b->from[kept] = b->from[i];
+        }
+        ((char*) b->iovs[kept].iov_base)[b->msgs[kept].msg_len] = '\0';
+        kept++;
+    }
+    b->count = kept;
+    return kept;
+}
+
+/******************************************************************************
+ * recvBatchRead / recvBatchReadNow
+ ******************************************************************************/
+int recvBatchRead(RecvBatch* b, int fd) {
+    return readBatch(b, fd, MSG_WAITFORONE);
+}
+
+int recvBatchReadNow(RecvBatch* b, int fd) {
+    return readBatch(b, fd, MSG_DONTWAIT);
+}
+
+/******************************************************************************
+ * sendQueueInit
+ ******************************************************************************/
+void sendQueueInit(SendQueue* q, int fd) {
+    memset(q, 0, sizeof(*q));
+    q->fd = fd;
+}
+
+/******************************************************************************
+ * sendQueueFree
+ ******************************************************************************/
+void sendQueueFree(SendQueue* q) {
+    free(q->data);
+    q->data    = NULL;
+    q->dataLen = 0;
+    q->dataCap = 0;
+    q->count   = 0;
+}
+
+/******************************************************************************
+ * sendQueuePush
+ ******************************************************************************/
+int sendQueuePush(SendQueue* q, const void* buf, size_t len,
+                  const struct sockaddr_in* to) {
+    if (q->count == NETIO_SEND_BATCH) {
+        sendQueueFlush(q);
+    }
+    if (q->dataLen + len > q->dataCap) {
+        size_t newCap = q->dataCap ? q->dataCap : 4096;
+        while (newCap < q->dataLen + len) newCap *= 2;
+        char* d = (char*) realloc(q->data, newCap);
+        if (!d) {
+            LOG_ERROR("Out of memory in sendQueuePush.");
+            return -1;
+        }
+        q->data    = d;
+        q->dataCap = newCap;
+    }
+    memcpy(q->data + q->dataLen, buf, len);
+
+    int i = q->count++;
+    q->offsets[i]      = q->dataLen;
+    q->iovs[i].iov_len = len;
+    q->to[i]           = *to;
+    q->dataLen += len;
+    return 0;
+}
+
+/******************************************************************************
+ * sendQueueFlush
+ ******************************************************************************/
+int sendQueueFlush(SendQueue* q) {
+    if (q->sink) {
+        for (int i = 0; i < q->count; i++) {
+            q->sink(q->sinkCtx, q->data + q->offsets[i], q->iovs[i].iov_len, &q->to[i]);
+        }
+        int sent = q->count;
+        q->datagrams += (unsigned long) sent;
+        q->count   = 0;
+        q->dataLen = 0;
+        return sent;
+    }
+
+    /* the arena may have moved since push, so resolve payloads here */
+    for (int i = 0; i < q->count; i++) {
+        struct msghdr* h = &q->msgs[i].msg_hdr;
+        q->iovs[i].iov_base = q->data + q->offsets[i];
+        memset(h, 0, sizeof(*h));
+        h->msg_name    = &q->to[i];
+        h->msg_namelen = sizeof(q->to[i]);
+        h->msg_iov     = &q->iovs[i];
+        h->msg_iovlen  = 1;
+    }
+
+    int done = 0, sent = 0;
+    while (done < q->count) {
+        int n = sendmmsg(q->fd, q->msgs + done, (unsigned) (q->count - done), 0);
+        q->syscalls++;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            /* the first remaining datagram failed => skip it */
+            LOG_ERROR("sendmmsg(): %s", strerror(errno));
+            q->errors++;
+            done++;
+            continue;
+        }
+        done += n;
+        sent += n;
+    }
+    q->datagrams += (unsigned long) sent;
+    q->count   = 0;
+    q->dataLen = 0;
+    return sent;
+}
+
+/******************************************************************************
+ * sendQueueSetSink
+ ******************************************************************************/
+void sendQueueSetSink(SendQueue* q, SendSinkFn fn, void* ctx) {
+    q->sink    = fn;
+    q->sinkCtx = ctx;
+}
+
+/******************************************************************************
+ * sendQueueResetStats
+ ******************************************************************************/
+void sendQueueResetStats(SendQueue* q) {
+    q->datagrams = 0;
+    q->syscalls  = 0;
+    q->errors    = 0;
+}
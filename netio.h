@@ -0,0 +1,144 @@
+/******************************************************************************
+ * File: netio.h
+ *
+ * Batched datagram I/O for the router threads.
+ *
+ *   - recvBatchInit()/recvBatchFree() -> preallocated ring of receive buffers
+ *   - recvBatchRead()                 -> one recvmmsg() fills up to a batch
+ *   - recvBatchReadNow()              -> same, without blocking (epoll loops)
+ *   - recvBatchData()                 -> i-th datagram of the last read
+ *   - sendQueueInit()/sendQueueFree() -> outgoing datagram queue for a socket
+ *   - sendQueuePush()                 -> copy a datagram into the queue
+ *   - sendQueueFlush()                -> send everything with sendmmsg()
+ *   - sendQueueSetSink()              -> hand flushed datagrams to a
+ *                                        callback instead (simulation)
+ ******************************************************************************/
+
+#ifndef NETIO_H
+#define NETIO_H
+
+#include <stddef.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Datagrams per recvmmsg() call. */
+#define NETIO_RECV_BATCH 32
+
+/* Control buffer per received datagram: room for IP_PKTINFO. */
+#define NETIO_CTRL_SIZE 64
+
+/* Datagrams per sendmmsg() call; a full queue flushes itself. */
+#define NETIO_SEND_BATCH 64
+
+typedef struct RecvBatch {
+    struct mmsghdr msgs[NETIO_RECV_BATCH];
+    struct iovec iovs[NETIO_RECV_BATCH];
+    struct sockaddr_in from[NETIO_RECV_BATCH];
+    int ifindex[NETIO_RECV_BATCH];   /* arrival interface, 0 without IP_PKTINFO */
+    struct cmsghdr* ctrl[NETIO_RECV_BATCH]; /* NETIO_CTRL_SIZE bytes each */
+    char* bufs;        /* NETIO_RECV_BATCH slots of bufSize + 1 bytes */
+    size_t bufSize;
+    int count;         /* datagrams from the last recvBatchRead() */
+} RecvBatch;
+
+/* Receives each flushed datagram in place of the socket. */
+typedef void (*SendSinkFn)(void* ctx, const void* buf, size_t len,
+                           const struct sockaddr_in* to);
+
+typedef struct SendQueue {
+    int fd;
+    SendSinkFn sink;    /* non-NULL => flush calls it instead of sendmmsg() */
+    void* sinkCtx;
+    struct mmsghdr msgs[NETIO_SEND_BATCH];
+    struct iovec iovs[NETIO_SEND_BATCH];
+    struct sockaddr_in to[NETIO_SEND_BATCH];
+    size_t offsets[NETIO_SEND_BATCH]; /* payload offsets into data */
+    int count;
+    char* data;         /* payload arena, reused across flushes */
+    size_t dataLen;
+    size_t dataCap;
+
+    /* since the last sendQueueResetStats() */
+    unsigned long datagrams;   /* handed to the kernel */
+    unsigned long syscalls;    /* sendmmsg() calls made */
+    unsigned long errors;      /* datagrams the kernel refused */
+} SendQueue;
+
+/**
+ * @brief Allocate the buffer ring; each slot holds bufSize bytes + NUL.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int recvBatchInit(RecvBatch* b, size_t bufSize);
+
+/**
+ * @brief Free the buffer ring.
+ */
+void recvBatchFree(RecvBatch* b);
+
+/**
+ * @brief Block until at least one datagram is available on fd, then take
+ *        every queued datagram up to NETIO_RECV_BATCH in the same call.
+ *        Each datagram is NUL-terminated; truncated ones are dropped.
+ * @return Number of datagrams (also in b->count), -1 on error (errno set).
+ */
+int recvBatchRead(RecvBatch* b, int fd);
+
+/**
+ * @brief recvBatchRead() for a socket epoll reported readable: never
+ *        blocks, returns -1 with errno EAGAIN if nothing was queued after
+ *        all (e.g. a datagram dropped for a bad checksum).
+ */
+int recvBatchReadNow(RecvBatch* b, int fd);
+
+/**
+ * @brief Datagram i of the last read and its length.
+ */
+static inline char* recvBatchData(const RecvBatch* b, int i, size_t* len) {
+    *len = b->msgs[i].msg_len;
+    return (char*) b->iovs[i].iov_base;
+}
+
+/**
+ * @brief Empty queue sending on fd.
+ */
+void sendQueueInit(SendQueue* q, int fd);
+
+/**
+ * @brief Free the payload arena (queued datagrams are dropped).
+ */
+void sendQueueFree(SendQueue* q);
+
+/**
+ * @brief Queue a copy of buf for to. Flushes first if the queue is full.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int sendQueuePush(SendQueue* q, const void* buf, size_t len,
+                  const struct sockaddr_in* to);
+
+/**
+ * @brief Send all queued datagrams, NETIO_SEND_BATCH per sendmmsg().
+ *        A datagram the kernel refuses is counted in errors and skipped.
+ * @return Number of datagrams sent.
+ */
+int sendQueueFlush(SendQueue* q);
+
+/**
+ * @brief From now on sendQueueFlush() passes each datagram to fn(ctx, ...)
+ *        in queue order and makes no syscalls; fn == NULL => back to fd.
+ */
+void sendQueueSetSink(SendQueue* q, SendSinkFn fn, void* ctx);
+
+/**
+ * @brief Zero the datagrams/syscalls/errors counters.
+ */
+void sendQueueResetStats(SendQueue* q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NETIO_H */
@@ -0,0 +1,200 @@
+/******************************************************************************
+ * File: rcu.c
+ *
+ * Epoch-based reclamation.
+ *
+ * A global epoch starts at 1 and is bumped by every rcuRetire(). A reader
+ * entering a read section copies the current epoch into its own slot (0 =>
+ * not reading). An object retired while the epoch was E was unpublished
+ * before the bump to E+1, so only readers whose slot holds an epoch <= E
+ * can still reference it; once the oldest active slot is > E it is freed.
+ *
+ * Threads get a slot on their first rcuReadLock() and give it back when
+ * they exit. If all RCU_MAX_READERS slots are taken the thread reads
+ * slotless and reclamation is paused while it is inside a read section.
+ ******************************************************************************/
+
+#include "rcu.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+typedef struct RcuSlot {
+    uint64_t epoch;      /* epoch at rcuReadLock(), 0 => quiescent */
+    int inUse;           /* claimed by a thread */
+    char pad[64 - sizeof(uint64_t) - sizeof(int)]; /* one per cache line */
+} RcuSlot;
+
+typedef struct RcuRetired {
+    void* p;
+    RcuFreeFn fn;
+    uint64_t epoch;      /* epoch before the bump that retired it */
+} RcuRetired;
+
+static uint64_t g_epoch = 1;
+static RcuSlot g_slots[RCU_MAX_READERS];
+static int g_slotlessReaders = 0;
+
+static pthread_once_t g_keyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t g_slotKey;
+static __thread int t_slot = -1;
+static __thread unsigned t_depth = 0;
+static __thread int t_slotless = 0;
+
+/* Retired list, writers only. */
+static pthread_mutex_t g_retireLock = PTHREAD_MUTEX_INITIALIZER;
+static RcuRetired* g_retired = NULL;
+static size_t g_retiredCount = 0;
+static size_t g_retiredCap = 0;
+
+/******************************************************************************
+ * Slot ownership
+ *   releaseSlot runs at thread exit (pthread key destructor).
+ ******************************************************************************/
+static void releaseSlot(void* p) {
+    RcuSlot* slot = (RcuSlot*) p;
+    __atomic_store_n(&slot->epoch, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&slot->inUse, 0, __ATOMIC_RELEASE);
+}
+
+static void makeKey(void) {
+    pthread_key_create(&g_slotKey, releaseSlot);
+}
+
+static int claimSlot(void) {
+    pthread_once(&g_keyOnce, makeKey);
+    for (int i = 0; i < RCU_MAX_READERS; i++) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&g_slots[i].inUse, &expected, 1, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            pthread_setspecific(g_slotKey, &g_slots[i]);
+            return i;
+        }
+    }
+    return -1;
+}
+
+/******************************************************************************
+ * rcuReadLock
+ ******************************************************************************/
+void rcuReadLock(void) {
+    if (t_depth++) return;
+
+    if (t_slot < 0) t_slot = claimSlot();
+    if (t_slot < 0) {
+        t_slotless = 1;
+        __atomic_fetch_add(&g_slotlessReaders, 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        return;
+    }
+    /* acquire: seeing epoch E+1 means seeing what was published before the
+       bump, so nothing retired at E can be loaded below */
+    uint64_t e = __atomic_load_n(&g_epoch, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&g_slots[t_slot].epoch, e, __ATOMIC_RELAXED);
+    /* slot store must be visible before we load any published pointer */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/******************************************************************************
+ * rcuReadUnlock
+ ******************************************************************************/
+void rcuReadUnlock(void) {
+    if (!t_depth || --t_depth) return;
+
+    if (t_slotless) {
+        t_slotless = 0;
+        __atomic_fetch_sub(&g_slotlessReaders, 1, __ATOMIC_RELEASE);
+        return;
+    }
+    __atomic_store_n(&g_slots[t_slot].epoch, 0, __ATOMIC_RELEASE);
+}
+
+/******************************************************************************
+ * oldestReader
+ *   Smallest epoch held by an active reader, UINT64_MAX if none.
+ ******************************************************************************/
+static uint64_t oldestReader(void) {
+    uint64_t min = UINT64_MAX;
+    for (int i = 0; i < RCU_MAX_READERS; i++) {
+        uint64_t e = __atomic_load_n(&g_slots[i].epoch, __ATOMIC_ACQUIRE);
+        if (e && e < min) min = e;
+    }
+    return min;
+}
+
+/******************************************************************************
+ * rcuRetire
+ ******************************************************************************/
+void rcuRetire(void* p, RcuFreeFn fn) {
+    if (!p) return;
+    pthread_mutex_lock(&g_retireLock);
+    if (g_retiredCount == g_retiredCap) {
+        size_t newCap = g_retiredCap ? g_retiredCap * 2 : 16;
+        RcuRetired* r = (RcuRetired*) realloc(g_retired, newCap * sizeof(RcuRetired));
+        if (!r) {
+            /* nowhere to park it => leak rather than free under a reader */
+            pthread_mutex_unlock(&g_retireLock);
+            fprintf(stderr, "[ERROR] Out of memory in rcuRetire, leaking object.\n");
+            return;
+        }
+        g_retired    = r;
+        g_retiredCap = newCap;
+    }
+    g_retired[g_retiredCount].p     = p;
+    g_retired[g_retiredCount].fn    = fn;
+    g_retired[g_retiredCount].epoch = __atomic_fetch_add(&g_epoch, 1, __ATOMIC_SEQ_CST);
+    g_retiredCount++;
+    pthread_mutex_unlock(&g_retireLock);
+}
+
+/******************************************************************************
+ * rcuReclaim
+ ******************************************************************************/
+size_t rcuReclaim(void) {
+    size_t freed = 0;
+    pthread_mutex_lock(&g_retireLock);
+    if (g_retiredCount &&
+        __atomic_load_n(&g_slotlessReaders, __ATOMIC_SEQ_CST) == 0) {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        uint64_t oldest = oldestReader();
+        size_t keep = 0;
+        for (size_t i = 0; i < g_retiredCount; i++) {
+            RcuRetired* r = &g_retired[i];
+            if (r->epoch < oldest) {
+                r->fn(r->p);
+                freed++;
+            } else {
+                g_retired[keep++] = *r;
+            }
+        }
+        g_retiredCount = keep;
+    }
+    pthread_mutex_unlock(&g_retireLock);
+    return freed;
+}
+
+/******************************************************************************
+ * rcuPending
+ ******************************************************************************/
+size_t rcuPending(void) {
+    pthread_mutex_lock(&g_retireLock);
+    size_t n = g_retiredCount;
+    pthread_mutex_unlock(&g_retireLock);
+    return n;
+}
+
+/******************************************************************************
+ * rcuCleanup
+ ******************************************************************************/
+void rcuCleanup(void) {
+    pthread_mutex_lock(&g_retireLock);
+    for (size_t i = 0; i < g_retiredCount; i++) {
+        g_retired[i].fn(g_retired[i].p);
+    }
+    free(g_retired);
+    g_retired      = NULL;
+    g_retiredCount = 0;
+    g_retiredCap   = 0;
+    pthread_mutex_unlock(&g_retireLock);
+}
@@ -0,0 +1,69 @@
+/******************************************************************************
+ * File: rcu.h
+ *
+ * Epoch-based deferred reclamation for read-mostly snapshots.
+ *
+ *   - rcuReadLock()/rcuReadUnlock() -> bracket a lock-free read of a
+ *                                      published pointer; never blocks
+ *   - rcuRetire()                   -> writer hands over an unpublished
+ *                                      object, freed once no reader can
+ *                                      still see it
+ *   - rcuReclaim()                  -> free what is safe to free now
+ *
+ * Writers publish with __atomic_store_n/__atomic_exchange_n(RELEASE),
+ * readers load with __atomic_load_n(ACQUIRE) inside a read section.
+ * Writers serialize among themselves (each module has its own mutex).
+ ******************************************************************************/
+
+#ifndef RCU_H
+#define RCU_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Threads that can be inside a read section at the same time. */
+#define RCU_MAX_READERS 64
+
+typedef void (*RcuFreeFn)(void* p);
+
+/**
+ * @brief Enter a read section. Pointers loaded inside stay valid until
+ *        the matching rcuReadUnlock(). Nests; wait-free.
+ */
+void rcuReadLock(void);
+
+/**
+ * @brief Leave a read section.
+ */
+void rcuReadUnlock(void);
+
+/**
+ * @brief Free p with fn once every read section that might have loaded
+ *        it has ended. p must already be unreachable for new readers.
+ */
+void rcuRetire(void* p, RcuFreeFn fn);
+
+/**
+ * @brief Free retired objects no reader can still hold.
+ * @return Number of objects freed.
+ */
+size_t rcuReclaim(void);
+
+/**
+ * @brief Objects retired but not yet freed.
+ */
+size_t rcuPending(void);
+
+/**
+ * @brief Free everything still retired. Only when no thread is reading.
+ */
+void rcuCleanup(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RCU_H */
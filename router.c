@@ -0,0 +1,115 @@
+/******************************************************************************
+ * File: router.c
+ *
+ * Router instance lifecycle and link configuration; the tables belong
+ * to neighbor.c and distance.c, the sockets are opened by neighborInit().
+ ******************************************************************************/
+
+#include "router.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ifaddrs.h>
+#include <arpa/inet.h>
+#include "distance.h"
+#include "neighbor.h"
+
+/******************************************************************************
+ * routerCreate
+ ******************************************************************************/
+Router* routerCreate(uint32_t ip) {
+    Router* r = (Router*) calloc(1, sizeof(Router));
+    if (!r) {
+        fprintf(stderr, "[ERROR] Out of memory creating router.\n");
+        return NULL;
+    }
+    r->ip = ip;
+    ipFormat(ip, r->ipStr);
+    r->nb = neighborStateCreate();
+    r->dv = distanceStateCreate();
+    if (!r->nb || !r->dv) {
+        routerDestroy(r);
+        return NULL;
+    }
+    return r;
+}
+
+/******************************************************************************
+ * routerAddInterface
+ ******************************************************************************/
+int routerAddInterface(Router* r, const char* name, unsigned cost) {
+    if (r->linkCount == ROUTER_MAX_LINKS) {
+        fprintf(stderr, "[ERROR] More than %d links.\n", ROUTER_MAX_LINKS);
+        return -1;
+    }
+    RouterLink* l = &r->links[r->linkCount];
+    memset(l, 0, sizeof(*l));
+    l->cost = cost ? cost : ROUTER_DEFAULT_COST;
+    l->sock = -1;
+    l->broadcastAddr.sin_family = AF_INET;
+    l->broadcastAddr.sin_port   = htons(ROUTER_PORT);
+
+    if (!name) {
+        l->broadcastAddr.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+        return (int) r->linkCount++;
+    }
+
+    struct ifaddrs* ifs;
+    if (getifaddrs(&ifs) != 0) {
+        perror("[ERROR] getifaddrs()");
+        return -1;
+    }
+    int found = 0;
+    for (struct ifaddrs* ifa = ifs; ifa && !found; ifa = ifa->ifa_next) {
+        if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET) continue;
+        if (strcmp(ifa->ifa_name, name) != 0) continue;
+        const struct sockaddr_in* a = (const struct sockaddr_in*) ifa->ifa_addr;
+        const struct sockaddr_in* m = (const struct sockaddr_in*) ifa->ifa_netmask;
+        l->addr = ntohl(a->sin_addr.s_addr);
+        l->mask = m ? ntohl(m->sin_addr.s_addr) : 0xFFFFFFFFu;
+
+        /* subnet-directed broadcast, or the far end of a point-to-point
+           link. Without a configured one getifaddrs() reports 0 or our own
+           address; derive it from the mask then. */
+        uint32_t to = l->addr | ~l->mask;
+        const struct sockaddr_in* peer = (const struct sockaddr_in*) ifa->ifa_broadaddr;
+        if ((ifa->ifa_flags & (IFF_BROADCAST | IFF_POINTOPOINT)) && peer) {
+            uint32_t peerAddr = ntohl(peer->sin_addr.s_addr);
+            if (peerAddr != 0 && peerAddr != l->addr) to = peerAddr;
+        }
+        l->broadcastAddr.sin_addr.s_addr = htonl(to);
+        found = 1;
+    }
+    freeifaddrs(ifs);
+    if (!found) {
+        fprintf(stderr, "[ERROR] Interface %s has no IPv4 address.\n", name);
+        return -1;
+    }
+    snprintf(l->name, sizeof(l->name), "%s", name);
+    l->ifindex = if_nametoindex(name);
+    return (int) r->linkCount++;
+}
+
+/******************************************************************************
+ * routerLinkFor
+ ******************************************************************************/
+int routerLinkFor(const Router* r, int sock, int ifindex) {
+    for (unsigned i = 0; i < r->linkCount; i++) {
+        const RouterLink* l = &r->links[i];
+        if (l->sock != sock) continue;
+        /* IP_PKTINFO is on for every socket, bound to a device or shared */
+        if (l->ifindex == 0 || (int) l->ifindex == ifindex) return (int) i;
+    }
+    return -1;
+}
+
+/******************************************************************************
+ * routerDestroy
+ ******************************************************************************/
+void routerDestroy(Router* r) {
+    if (!r) return;
+    if (r->nb) neighborStop(r);
+    neighborStateDestroy(r->nb);
+    distanceStateDestroy(r->dv);
+    free(r);
+}
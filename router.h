@@ -0,0 +1,133 @@
+/******************************************************************************
+ * File: router.h
+ *
+ * One router instance: its address, links, neighbor table, distance
+ * tables and clock. Every neighbor*() and distance/DV function takes the
+ * Router it works on, so any number of instances can live in one process
+ * (simulation, sharded workers), each on its own thread if need be.
+ *
+ * A link is one interface the router runs on: its own socket, the
+ * subnet-directed broadcast address HELLOs go to, and a cost. Neighbors
+ * are tracked per link. A router without configured links runs on one
+ * "any" link: INADDR_ANY and 255.255.255.255.
+ *
+ *   - routerCreate()        -> empty instance for an address, no links
+ *   - routerAddInterface()  -> add a link on a named interface (or "any")
+ *   - routerLinkFor()       -> link a datagram arrived on
+ *   - routerDestroy()       -> close the sockets, free the tables
+ *   - routerNowMs()         -> the instance's clock
+ *   - routerNowCoarseMs()   -> the same, cheaper and up to a tick behind
+ *   - routerCoarseResMs()   -> that tick, 0 if none
+ ******************************************************************************/
+
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <stdint.h>
+#include <time.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include "clock.h"
+#include "ipaddr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct NeighborState NeighborState; /* neighbor.c */
+typedef struct DistanceState DistanceState; /* distance.c */
+
+/* UDP port of every link. */
+#define ROUTER_PORT 5555
+
+/* Links per router. */
+#define ROUTER_MAX_LINKS 16
+
+/* Cost of a link unless configured. */
+#define ROUTER_DEFAULT_COST 1
+
+typedef struct RouterLink {
+    char name[IF_NAMESIZE];            /* "" => the any link */
+    unsigned ifindex;                  /* kernel index, 0 => any */
+    uint32_t addr;                     /* host order, 0 => any */
+    uint32_t mask;
+    unsigned cost;                     /* added to metrics learned on it */
+    int sock;                          /* UDP 5555 after neighborInit(), else -1 */
+    int ownsSock;                      /* 0 => shares an earlier link's socket */
+    struct sockaddr_in broadcastAddr;  /* where HELLOs and broadcast DVs go */
+} RouterLink;
+
+typedef struct Router {
+    uint32_t ip;                       /* router ID, host order */
+    char ipStr[IPV4_STR_LEN];          /* preformatted for message text */
+    RouterLink links[ROUTER_MAX_LINKS];
+    unsigned linkCount;
+    NeighborState* nb;
+    DistanceState* dv;
+    ClockFn clockFn;                   /* NULL => clockNowMs() */
+    void* clockCtx;
+    void* user;                        /* owner's data, e.g. a simulator node */
+} Router;
+
+/**
+ * @brief New router for address ip (host order) with empty tables.
+ * @return NULL on allocation failure.
+ */
+Router* routerCreate(uint32_t ip);
+
+/**
+ * @brief Add a link on interface name (NULL => the any link) with the
+ *        given cost. Reads the interface's IPv4 address, netmask and
+ *        broadcast address; the socket is opened by neighborInit().
+ * @return Link index, -1 if the interface has no IPv4 address or there
+ *         are already ROUTER_MAX_LINKS links.
+ */
+int routerAddInterface(Router* r, const char* name, unsigned cost);
+
+/**
+ * @brief Link of a datagram received on sock whose IP_PKTINFO named
+ *        ifindex (0 if unknown).
+ * @return Link index, -1 if it came in on an interface we don't run on.
+ */
+int routerLinkFor(const Router* r, int sock, int ifindex);
+
+/**
+ * @brief Close its sockets (if any) and free everything.
+ */
+void routerDestroy(Router* r);
+
+/**
+ * @brief Current time in ms on this router's clock.
+ */
+static inline uint64_t routerNowMs(const Router* r) {
+    return r->clockFn ? r->clockFn(r->clockCtx) : clockNowMs();
+}
+
+/**
+ * @brief routerNowMs() through clockNowCoarseMs(): for timeouts, which
+ *        only need to fire no earlier than due. Measurements (HELLO
+ *        times) use routerNowMs().
+ */
+static inline uint64_t routerNowCoarseMs(const Router* r) {
+    return r->clockFn ? r->clockFn(r->clockCtx) : clockNowCoarseMs();
+}
+
+/**
+ * @brief How far routerNowCoarseMs() may be behind routerNowMs(), in ms.
+ */
+static inline unsigned routerCoarseResMs(const Router* r) {
+    return r->clockFn ? 0 : clockCoarseResMs();
+}
+
+/**
+ * @brief routerNowMs() in whole seconds.
+ */
+static inline time_t routerNowSec(const Router* r) {
+    return (time_t) (routerNowMs(r) / 1000);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ROUTER_H */
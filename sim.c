@@ -0,0 +1,648 @@
+/******************************************************************************
+ * File: sim.c
+ *
+ * Implementation of the network simulator (sim.h).
+ *
+ *   Provides:
+ *     - simDefaults()
+ *     - simTopologyParse()
+ *     - simCreate()
+ *     - simRun()
+ *     - simDestroy()
+ *
+ * One thread, one event queue (binary heap ordered by virtual time, then
+ * by insertion). Handling an event for router i runs the same calls on
+ * router i's Router that main.c's threads make, publishes, and flushes
+ * router i's SendQueue. Every Router reads the Sim's virtual clock, so
+ * separate Sims share nothing and can run on separate threads. The queue's
+ * sink (netio.h) turns each datagram into delivery events: a unicast to a
+ * linked router goes over that link, anything else (HELLO, broadcast DV,
+ * DVREQ) is copied to every link.
+ ******************************************************************************/
+
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include "distance.h"
+#include "dvcodec.h"
+#include "ipaddr.h"
+#include "message.h"
+#include "neighbor.h"
+#include "netio.h"
+#include "router.h"
+#include "trigger.h"
+
+#define SIM_HELLO_MS     5000   /* as main.c HELLO_INTERVAL_SEC */
+#define SIM_FULL_EVERY   6      /* HELLO ticks per full DV (30 s) */
+#define SIM_QUIET_MS     (2 * SIM_HELLO_MS)
+#define SIM_ROUTER_BASE  0x0A000001u /* router i => 10.0.0.1 + i */
+#define SIM_STUB_BASE    0x0A400001u /* its stub => 10.64.0.1 + i */
+#define SIM_FLAP_COST    8      /* cost of the flapping link while up */
+
+typedef enum SimEventType {
+    SIM_EV_DELIVER = 0,
+    SIM_EV_HELLO,
+    SIM_EV_DV,         /* coalescing window / hold-down / bucket expired */
+    SIM_EV_FLAP        /* cfg.flapMs: toggle node 0's first link cost */
+} SimEventType;
+
+typedef struct SimEvent {
+    uint64_t at;
+    uint64_t seq;      /* insertion order, breaks ties deterministically */
+    unsigned node;
+    unsigned from;     /* SIM_EV_DELIVER: sending router */
+    SimEventType type;
+    char* data;        /* SIM_EV_DELIVER: NUL-terminated copy */
+    size_t len;
+} SimEvent;
+
+typedef struct SimNode {
+    uint32_t ip;
+    Router* router;    /* user => this node */
+    SendQueue q;
+    unsigned* links;   /* linked routers */
+    unsigned degree;
+    unsigned linkCap;
+    unsigned helloTicks;
+    DVTrigger trig;    /* armed => SIM_EV_DV queued */
+    int flapped;       /* node 0: first link at SIM_FLAP_COST */
+    double cpuSec;
+} SimNode;
+
+struct Sim {
+    SimConfig cfg;
+    SimNode* nodes;
+    unsigned nodeCount;
+    unsigned linkCount;
+    SimEvent* heap;
+    size_t heapCount;
+    size_t heapCap;
+    uint64_t seq;
+    uint64_t now;
+    uint64_t lastChange;
+    uint32_t rng;
+    SimNode* current;  /* router whose event is being handled */
+    SimStats stats;
+};
+
+/******************************************************************************
+ * Utility: random numbers, CPU time
+ ******************************************************************************/
+static uint32_t simRand(Sim* s) {
+    uint32_t x = s->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return s->rng = x;
+}
+
+static double simRandUnit(Sim* s) {
+    return (double) (simRand(s) >> 8) / 16777216.0;
+}
+
+static double cpuSec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static uint64_t simClock(void* ctx) {
+    return ((Sim*) ctx)->now;
+}
+
+/******************************************************************************
+ * Event heap
+ ******************************************************************************/
+static int eventBefore(const SimEvent* a, const SimEvent* b) {
+    return a->at < b->at || (a->at == b->at && a->seq < b->seq);
+}
+
+static int heapPush(Sim* s, SimEvent ev) {
+    if (s->heapCount == s->heapCap) {
+        size_t newCap = s->heapCap ? s->heapCap * 2 : 1024;
+        SimEvent* h = (SimEvent*) realloc(s->heap, newCap * sizeof(SimEvent));
+        if (!h) {
+            fprintf(stderr, "[ERROR] Out of memory in simulator event queue.\n");
+            return -1;
+        }
+        s->heap    = h;
+        s->heapCap = newCap;
+    }
+    ev.seq = s->seq++;
+    size_t i = s->heapCount++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!eventBefore(&ev, &s->heap[parent])) break;
+        s->heap[i] = s->heap[parent];
+        i = parent;
+    }
+    s->heap[i] = ev;
+    return 0;
+}
+
+static SimEvent heapPop(Sim* s) {
+    SimEvent top = s->heap[0];
+    SimEvent last = s->heap[--s->heapCount];
+    size_t i = 0;
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= s->heapCount) break;
+        if (c + 1 < s->heapCount && eventBefore(&s->heap[c + 1], &s->heap[c])) c++;
+        if (!eventBefore(&s->heap[c], &last)) break;
+        s->heap[i] = s->heap[c];
+        i = c;
+    }
+    if (s->heapCount) s->heap[i] = last;
+    return top;
+}
+
+static void schedule(Sim* s, uint64_t at, SimEventType type, unsigned node) {
+    SimEvent ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.at   = at;
+    ev.type = type;
+    ev.node = node;
+    heapPush(s, ev);
+}
+
+/******************************************************************************
+ * Topology
+ ******************************************************************************/
+static int linked(const SimNode* n, unsigned peer) {
+    for (unsigned k = 0; k < n->degree; k++) {
+        if (n->links[k] == peer) return 1;
+    }
+    return 0;
+}
+
+static int addLinkEnd(SimNode* n, unsigned peer) {
+    if (n->degree == n->linkCap) {
+        unsigned newCap = n->linkCap ? n->linkCap * 2 : 4;
+        unsigned* l = (unsigned*) realloc(n->links, newCap * sizeof(unsigned));
+        if (!l) return -1;
+        n->links   = l;
+        n->linkCap = newCap;
+    }
+    n->links[n->degree++] = peer;
+    return 0;
+}
+
+static int addLink(Sim* s, unsigned a, unsigned b) {
+    if (a == b || linked(&s->nodes[a], b)) return 0;
+    if (addLinkEnd(&s->nodes[a], b) != 0 || addLinkEnd(&s->nodes[b], a) != 0) {
+        fprintf(stderr, "[ERROR] Out of memory building topology.\n");
+        return -1;
+    }
+    s->linkCount++;
+    return 0;
+}
+
+/* Routers needed for topo at the requested size. */
+static unsigned topoSize(SimTopology topo, unsigned nodes, unsigned* param) {
+    switch (topo) {
+    case SIM_TOPO_GRID: {
+        unsigned side = 2;
+        while ((side + 1) * (side + 1) <= nodes) side++;
+        *param = side;
+        return side * side;
+    }
+    case SIM_TOPO_FATTREE: {
+        /* (k/2)^2 core + k pods of k/2 aggregation + k/2 edge + k^3/4 hosts */
+        unsigned k = 2;
+        while (5 * (k + 2) * (k + 2) / 4 + (k + 2) * (k + 2) * (k + 2) / 4 <= nodes) k += 2;
+        *param = k;
+        return 5 * k * k / 4 + k * k * k / 4;
+    }
+    default:
+        *param = 0;
+        return nodes < 3 ? 3 : nodes;
+    }
+}
+
+static int buildTopology(Sim* s, unsigned param) {
+    unsigned n = s->nodeCount;
+    int rc = 0;
+    switch (s->cfg.topo) {
+    case SIM_TOPO_RING:
+        for (unsigned i = 0; i < n && rc == 0; i++) rc = addLink(s, i, (i + 1) % n);
+        break;
+    case SIM_TOPO_GRID:
+        for (unsigned i = 0; i < n && rc == 0; i++) {
+            if (i % param != param - 1) rc = addLink(s, i, i + 1);
+            if (rc == 0 && i + param < n) rc = addLink(s, i, i + param);
+        }
+        break;
+    case SIM_TOPO_RANDOM:
+        /* spanning tree keeps it connected, then as many random links again */
+        for (unsigned i = 1; i < n && rc == 0; i++) rc = addLink(s, i, simRand(s) % i);
+        for (unsigned i = 0; i < n && rc == 0; i++) {
+            rc = addLink(s, simRand(s) % n, simRand(s) % n);
+        }
+        break;
+    case SIM_TOPO_FATTREE: {
+        unsigned k = param, half = k / 2;
+        unsigned core = half * half;
+        unsigned pods = core;                   /* first pod router */
+        unsigned hosts = core + k * k;          /* first host */
+        for (unsigned p = 0; p < k && rc == 0; p++) {
+            unsigned agg  = pods + p * k;       /* half aggregation ... */
+            unsigned edge = agg + half;         /* ... then half edge */
+            for (unsigned a = 0; a < half && rc == 0; a++) {
+                for (unsigned c = 0; c < half && rc == 0; c++) {
+                    rc = addLink(s, agg + a, a * half + c);
+                }
+                for (unsigned e = 0; e < half && rc == 0; e++) {
+                    rc = addLink(s, agg + a, edge + e);
+                }
+            }
+            for (unsigned e = 0; e < half && rc == 0; e++) {
+                for (unsigned h = 0; h < half && rc == 0; h++) {
+                    rc = addLink(s, edge + e, hosts + (p * half + e) * half + h);
+                }
+            }
+        }
+        break;
+    }
+    }
+    return rc;
+}
+
+/******************************************************************************
+ * Virtual link layer
+ *   SendQueue sink of every router: one delivery event per receiving link.
+ ******************************************************************************/
+static void simSink(void* ctx, const void* buf, size_t len, const struct sockaddr_in* to) {
+    Sim* s = (Sim*) ctx;
+    SimNode* src = s->current;
+    unsigned self = (unsigned) (src - s->nodes);
+    uint32_t dst = ntohl(to->sin_addr.s_addr);
+
+    int unicast = (dst - SIM_ROUTER_BASE) < s->nodeCount && linked(src, dst - SIM_ROUTER_BASE);
+
+    s->stats.messages++;
+    s->stats.bytes += len;
+    for (unsigned k = 0; k < src->degree; k++) {
+        unsigned peer = src->links[k];
+        if (unicast && s->nodes[peer].ip != dst) continue;
+
+        if (s->cfg.loss > 0 && simRandUnit(s) < s->cfg.loss) {
+            s->stats.dropped++;
+            continue;
+        }
+        SimEvent ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.at   = s->now + s->cfg.latencyMs;
+        if (s->cfg.jitterMs) ev.at += simRand(s) % (s->cfg.jitterMs + 1);
+        ev.type = SIM_EV_DELIVER;
+        ev.node = peer;
+        ev.from = self;
+        ev.len  = len;
+        ev.data = (char*) malloc(len + 1);
+        if (!ev.data) {
+            s->stats.dropped++;
+            continue;
+        }
+        memcpy(ev.data, buf, len);
+        ev.data[len] = '\0';
+        if (heapPush(s, ev) != 0) free(ev.data);
+    }
+}
+
+/******************************************************************************
+ * Router side, as main.c
+ ******************************************************************************/
+/* Gap handler: DVREQ to the router that skipped a DV. */
+static void simRequestFull(Router* router, uint32_t sender) {
+    SimNode* n = (SimNode*) router->user;
+    char msg[64], target[IPV4_STR_LEN];
+    int len = snprintf(msg, sizeof(msg), "%s:DVREQ:%s", router->ipStr,
+                       ipFormat(sender, target));
+    sendQueuePush(&n->q, msg, (size_t) len, &router->links[0].broadcastAddr);
+}
+
+static void simEmit(void* ctx, const void* buf, size_t len) {
+    SimNode* n = (SimNode*) ctx;
+    sendQueuePush(&n->q, buf, len, &n->router->links[0].broadcastAddr);
+}
+
+typedef struct SimPeerCtx {
+    SimNode* node;
+    const NeighborPeer* peers;
+} SimPeerCtx;
+
+static void simPeerEmit(void* ctx, size_t peer, const void* buf, size_t len) {
+    SimPeerCtx* c = (SimPeerCtx*) ctx;
+    sendQueuePush(&c->node->q, buf, len, &c->peers[peer].addr);
+}
+
+/* broadcastDV()/unicastDV() of main.c */
+static void simSendDV(Sim* s, SimNode* n, int full) {
+    Router* r = n->router;
+    int rc;
+    if (s->cfg.horizon == DV_HORIZON_NONE) {
+        DVFormat fmt = neighborAllHaveCaps(r, NEIGHBOR_CAP_DV_BINARY) ? DV_FORMAT_BINARY
+                                                                      : DV_FORMAT_TEXT;
+        rc = emitDistanceVector(r, fmt, DV_DEFAULT_MTU, full, simEmit, n);
+    } else {
+        size_t count;
+        NeighborPeer* peers = neighborGetPeers(r, &count);
+        DVPeer* dvPeers = count ? (DVPeer*) malloc(count * sizeof(DVPeer)) : NULL;
+        if (count && !dvPeers) {
+            free(peers);
+            return;
+        }
+        for (size_t i = 0; i < count; i++) {
+            dvPeers[i].ip  = peers[i].ip;
+            dvPeers[i].fmt = (peers[i].caps & NEIGHBOR_CAP_DV_BINARY) ? DV_FORMAT_BINARY
+                                                                      : DV_FORMAT_TEXT;
+        }
+        SimPeerCtx ctx = { n, peers };
+        rc = emitDistanceVectorPeers(r, s->cfg.horizon, dvPeers, count, DV_DEFAULT_MTU,
+                                     full, simPeerEmit, &ctx);
+        free(dvPeers);
+        free(peers);
+    }
+    if (rc < 0) {
+        dvRequestFull(r);
+    } else {
+        dvSent(r);
+    }
+}
+
+/******************************************************************************
+ * simFlap
+ *   Churn: node 0's cost to its first neighbor alternates between the
+ *   default and SIM_FLAP_COST until cfg.minMs, then is restored so the
+ *   tables can settle on shortest paths again.
+ ******************************************************************************/
+static void simFlap(Sim* s, SimNode* n) {
+    if (!n->degree) return;
+    uint32_t peer = s->nodes[n->links[0]].ip;
+    n->flapped = !n->flapped && s->now < s->cfg.minMs;
+    unsigned cost = n->flapped ? SIM_FLAP_COST : ROUTER_DEFAULT_COST;
+    neighborSetCost(n->router, peer, n->flapped ? cost : 0);
+    distanceSetLinkCost(n->router, peer, cost);
+}
+
+static double simEnter(Sim* s, SimNode* n) {
+    s->current = n;
+    return cpuSec();
+}
+
+/* Publish, send what the event queued, arm a triggered DV if needed. */
+static void simLeave(Sim* s, SimNode* n, double cpuStart) {
+    neighborPublish(n->router);
+    distancePublish(n->router);
+    sendQueueFlush(&n->q);
+
+    uint64_t due;
+    if (dvPending(n->router) && dvTriggerArm(&n->trig, s->now, &due)) {
+        schedule(s, due, SIM_EV_DV, (unsigned) (n - s->nodes));
+        s->lastChange = s->now;
+    }
+    n->cpuSec += cpuSec() - cpuStart;
+}
+
+static void simHandle(Sim* s, SimEvent* ev) {
+    SimNode* n = &s->nodes[ev->node];
+    double t = simEnter(s, n);
+
+    switch (ev->type) {
+    case SIM_EV_DELIVER: {
+        struct sockaddr_in from;
+        memset(&from, 0, sizeof(from));
+        from.sin_family      = AF_INET;
+        from.sin_addr.s_addr = htonl(s->nodes[ev->from].ip);
+        from.sin_port        = htons(ROUTER_PORT);
+        messageDispatch(n->router, 0, ev->data, ev->len, &from);
+        break;
+    }
+    case SIM_EV_HELLO:
+        neighborSendHELLO(n->router, 0, &n->q);
+        neighborRemoveStale(n->router);
+        distanceGarbageCollect(n->router);
+        if (n->helloTicks++ % SIM_FULL_EVERY == 0) simSendDV(s, n, 1);
+        schedule(s, s->now + SIM_HELLO_MS, SIM_EV_HELLO, ev->node);
+        break;
+    case SIM_EV_DV: {
+        uint64_t due;
+        if (!dvPending(n->router)) {
+            dvTriggerCancel(&n->trig);
+        } else if (dvTriggerFire(&n->trig, s->now, &due)) {
+            simSendDV(s, n, 0);
+        } else {
+            schedule(s, due, SIM_EV_DV, ev->node);
+        }
+        break;
+    }
+    case SIM_EV_FLAP:
+        simFlap(s, n);
+        if (s->now < s->cfg.minMs) schedule(s, s->now + s->cfg.flapMs, SIM_EV_FLAP, ev->node);
+        break;
+    }
+    simLeave(s, n, t);
+}
+
+/******************************************************************************
+ * verifyRoutes
+ *   Every router must reach every stub over a shortest path: hops + 1.
+ ******************************************************************************/
+static int verifyRoutes(Sim* s) {
+    unsigned n = s->nodeCount;
+    unsigned* hops  = (unsigned*) malloc(n * sizeof(unsigned));
+    unsigned* queue = (unsigned*) malloc(n * sizeof(unsigned));
+    int ok = (hops && queue);
+
+    for (unsigned v = 0; ok && v < n; v++) {
+        /* BFS from the stub's router */
+        for (unsigned i = 0; i < n; i++) hops[i] = UINT32_MAX;
+        size_t head = 0, tail = 0;
+        hops[v] = 0;
+        queue[tail++] = v;
+        while (head < tail) {
+            unsigned u = queue[head++];
+            for (unsigned k = 0; k < s->nodes[u].degree; k++) {
+                unsigned w = s->nodes[u].links[k];
+                if (hops[w] != UINT32_MAX) continue;
+                hops[w] = hops[u] + 1;
+                queue[tail++] = w;
+            }
+        }
+        for (unsigned u = 0; ok && u < n; u++) {
+            int dist;
+            if (distanceLookup(s->nodes[u].router, SIM_STUB_BASE + v, NULL, &dist) != 0 ||
+                dist != (int) hops[u] + 1) {
+                ok = 0;
+            }
+        }
+    }
+    free(hops);
+    free(queue);
+    return ok;
+}
+
+/******************************************************************************
+ * simDefaults
+ ******************************************************************************/
+void simDefaults(SimConfig* cfg, SimTopology topo, unsigned nodes) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->topo       = topo;
+    cfg->nodes      = nodes;
+    cfg->latencyMs  = 1;
+    cfg->horizon    = DV_HORIZON_POISON;
+    cfg->coalesceMs = 20;
+    cfg->holdDownMs = 200;
+    cfg->triggerRate  = DV_TRIGGER_RATE;
+    cfg->triggerBurst = DV_TRIGGER_BURST;
+    cfg->seed       = 1;
+    cfg->maxMs      = 600 * 1000;
+}
+
+/******************************************************************************
+ * simTopologyParse
+ ******************************************************************************/
+int simTopologyParse(const char* name, SimTopology* out) {
+    static const char* const names[] = { "ring", "grid", "random", "fattree" };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *out = (SimTopology) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/******************************************************************************
+ * simCreate
+ ******************************************************************************/
+Sim* simCreate(const SimConfig* cfg) {
+    Sim* s = (Sim*) calloc(1, sizeof(Sim));
+    if (!s) return NULL;
+    s->cfg = *cfg;
+    s->rng = cfg->seed ? cfg->seed : 1;
+
+    unsigned param;
+    s->nodeCount = topoSize(cfg->topo, cfg->nodes, &param);
+    s->nodes = (SimNode*) calloc(s->nodeCount, sizeof(SimNode));
+    if (!s->nodes || buildTopology(s, param) != 0) {
+        simDestroy(s);
+        return NULL;
+    }
+
+    for (unsigned i = 0; i < s->nodeCount; i++) {
+        SimNode* n = &s->nodes[i];
+        n->ip = SIM_ROUTER_BASE + i;
+        n->router = routerCreate(n->ip);
+        sendQueueInit(&n->q, -1);
+        sendQueueSetSink(&n->q, simSink, s);
+        /* one link to all of its neighbors, like the any link of main */
+        if (!n->router || routerAddInterface(n->router, NULL, ROUTER_DEFAULT_COST) < 0) {
+            simDestroy(s);
+            return NULL;
+        }
+        Router* r = n->router;
+        r->clockFn  = simClock;
+        r->clockCtx = s;
+        r->user     = n;
+        neighborSetLossHandler(r, distanceNeighborLost);
+        dvSetGapHandler(r, simRequestFull);
+    }
+    return s;
+}
+
+/******************************************************************************
+ * simRun
+ ******************************************************************************/
+int simRun(Sim* s, SimStats* out) {
+    memset(&s->stats, 0, sizeof(s->stats));
+    s->now = 0;
+    s->lastChange = 0;
+    for (unsigned i = 0; i < s->nodeCount; i++) {
+        dvTriggerInit(&s->nodes[i].trig, s->cfg.coalesceMs, s->cfg.holdDownMs,
+                      s->cfg.triggerRate, s->cfg.triggerBurst, 0);
+    }
+
+    /* t=0: every router learns its stub; HELLOs start at random phases */
+    for (unsigned i = 0; i < s->nodeCount; i++) {
+        SimNode* n = &s->nodes[i];
+        char stub[IPV4_STR_LEN], seed[64];
+        ipFormat(SIM_STUB_BASE + i, stub);
+        int len = snprintf(seed, sizeof(seed), "%s:DV:(%s,0)", stub, stub);
+        double t = simEnter(s, n);
+        processDistanceVectorText(n->router, seed, (size_t) len);
+        simLeave(s, n, t);
+        schedule(s, simRand(s) % SIM_HELLO_MS, SIM_EV_HELLO, i);
+    }
+    if (s->cfg.flapMs) schedule(s, s->cfg.flapMs, SIM_EV_FLAP, 0);
+
+    while (s->heapCount) {
+        if (s->heap[0].at > s->cfg.maxMs) break;
+        if (s->heap[0].at > s->lastChange + SIM_QUIET_MS &&
+            s->heap[0].at > s->cfg.minMs) break;
+        SimEvent ev = heapPop(s);
+        s->now = ev.at;
+        s->stats.events++;
+        simHandle(s, &ev);
+        free(ev.data);
+    }
+
+    s->current = NULL;
+
+    s->stats.nodes     = s->nodeCount;
+    s->stats.links     = s->linkCount;
+    s->stats.settledMs = s->lastChange;
+    s->stats.converged = verifyRoutes(s);
+    size_t rttCount = 0, nbCount = 0;
+    for (unsigned i = 0; i < s->nodeCount; i++) {
+        DVUpdateStats up;
+        dvGetUpdateStats(s->nodes[i].router, &up);
+        s->stats.triggered += s->nodes[i].trig.sent;
+        s->stats.limited   += s->nodes[i].trig.limited;
+        s->stats.updates   += up.updates;
+        s->stats.merged    += up.merged;
+        s->stats.cpuSec += s->nodes[i].cpuSec;
+        if (s->nodes[i].cpuSec > s->stats.maxNodeCpuSec) {
+            s->stats.maxNodeCpuSec = s->nodes[i].cpuSec;
+        }
+        size_t count;
+        NeighborStats* nb = neighborGetStats(s->nodes[i].router, &count);
+        for (size_t k = 0; k < count; k++) {
+            if (nb[k].rttSamples) {
+                s->stats.helloRttMs += nb[k].srttUs / 1e3;
+                rttCount++;
+            }
+            s->stats.helloJitterMs += nb[k].jitterUs / 1e3;
+            s->stats.helloLoss     += nb[k].loss;
+            nbCount++;
+        }
+        free(nb);
+    }
+    if (rttCount) s->stats.helloRttMs /= (double) rttCount;
+    if (nbCount) {
+        s->stats.helloJitterMs /= (double) nbCount;
+        s->stats.helloLoss     /= (double) nbCount;
+    }
+
+    if (out) *out = s->stats;
+    return 0;
+}
+
+/******************************************************************************
+ * simDestroy
+ ******************************************************************************/
+void simDestroy(Sim* s) {
+    if (!s) return;
+    for (unsigned i = 0; s->nodes && i < s->nodeCount; i++) {
+        SimNode* n = &s->nodes[i];
+        routerDestroy(n->router);
+        sendQueueFree(&n->q);
+        free(n->links);
+    }
+    for (size_t i = 0; i < s->heapCount; i++) free(s->heap[i].data);
+    free(s->heap);
+    free(s->nodes);
+    free(s);
+}
@@ -0,0 +1,116 @@
+/******************************************************************************
+ * File: sim.h
+ *
+ * Deterministic in-process network simulator: N Routers (router.h) on a
+ * virtual link layer with latency, jitter and loss, driven by a virtual
+ * clock.
+ *
+ *   - simCreate()   -> build a topology and its routers
+ *   - simRun()      -> run until the tables settle or the time limit
+ *   - simDestroy()  -> free everything
+ *
+ * Each router does what main.c's threads do: HELLO every 5 s (which also
+ * expires neighbors and collects withdrawn routes), a full DV every 30 s,
+ * and triggered DVs paced as the sender thread does (trigger.h). Received
+ * datagrams go through messageDispatch(). Router i owns one stub
+ * destination, learned from a host that is not a router; simRun() checks
+ * that every router ends with a shortest path to every stub.
+ *
+ * Same config and seed => same event order and results. A Sim shares no
+ * state with other Sims, so several can run at once on different threads.
+ ******************************************************************************/
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "distance.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum SimTopology {
+    SIM_TOPO_RING = 0,
+    SIM_TOPO_GRID,       /* side x side, side = floor(sqrt(nodes)) */
+    SIM_TOPO_RANDOM,     /* random spanning tree + extra links, mean degree ~4 */
+    SIM_TOPO_FATTREE     /* k-ary fat-tree, hosts as leaf routers */
+} SimTopology;
+
+typedef struct SimConfig {
+    SimTopology topo;
+    unsigned nodes;        /* requested; grid and fat-tree round down */
+    unsigned latencyMs;    /* one-way per link */
+    unsigned jitterMs;     /* plus 0..jitterMs, uniform */
+    double loss;           /* probability a datagram is dropped */
+    DVHorizon horizon;     /* DV_HORIZON_NONE => broadcast DVs, as -s none */
+    unsigned coalesceMs;   /* triggered DV timing, as main's -c and -H */
+    unsigned holdDownMs;
+    unsigned triggerRate;  /* token bucket, as main's -r and -b */
+    unsigned triggerBurst;
+    unsigned flapMs;       /* 0, or toggle router 0's cost to its first
+                              neighbor this often until minMs (churn) */
+    uint32_t seed;
+    uint64_t maxMs;        /* virtual time limit */
+    uint64_t minMs;        /* keep running this long even once settled */
+} SimConfig;
+
+typedef struct SimStats {
+    unsigned nodes;
+    unsigned links;
+    uint64_t settledMs;    /* virtual time of the last route change */
+    int converged;         /* 1 => every router has every shortest path */
+    uint64_t messages;     /* datagrams sent */
+    uint64_t bytes;
+    uint64_t dropped;      /* lost on a link */
+    uint64_t events;
+    uint64_t triggered;    /* triggered DVs sent, all routers */
+    uint64_t limited;      /* of the send times, pushed back by the bucket */
+    uint64_t updates;      /* table changes (DVUpdateStats), all routers */
+    uint64_t merged;       /*   of those, folded into an already pending DV */
+    double cpuSec;         /* CPU spent inside the routers, all nodes */
+    double maxNodeCpuSec;  /* busiest router */
+    double helloRttMs;     /* HELLO measurements (neighbor.h), mean over */
+    double helloJitterMs;  /*   every router's neighbor entries */
+    double helloLoss;
+} SimStats;
+
+typedef struct Sim Sim;
+
+/**
+ * @brief Default config for topo and nodes: 1 ms latency, no jitter or
+ *        loss, poisoned reverse, 20/200 ms triggered DV timing with
+ *        main's token bucket (trigger.h), no flapping, 600 s limit.
+ */
+void simDefaults(SimConfig* cfg, SimTopology topo, unsigned nodes);
+
+/**
+ * @brief "ring", "grid", "random" or "fattree".
+ * @return 0 on success, -1 if unknown.
+ */
+int simTopologyParse(const char* name, SimTopology* out);
+
+/**
+ * @brief Build the topology and one router per node.
+ * @return NULL on error.
+ */
+Sim* simCreate(const SimConfig* cfg);
+
+/**
+ * @brief Run until no route has changed for two HELLO intervals (and at
+ *        least cfg->minMs), or until cfg->maxMs of virtual time.
+ * @return 0 on success, -1 on error.
+ */
+int simRun(Sim* s, SimStats* out);
+
+/**
+ * @brief Free the routers and links.
+ */
+void simDestroy(Sim* s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_H */
@@ -0,0 +1,96 @@
+/******************************************************************************
+ * File: slab.c
+ *
+ * Fixed-size object pool (see slab.h). Memory comes from malloc() in
+ * chunks of perSlab objects and only goes back in slabRelease(); freed
+ * objects are kept on an intrusive free list, so route churn reuses the
+ * same few chunks instead of hitting the allocator per entry.
+ ******************************************************************************/
+
+#include "slab.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+struct SlabChunk {
+    SlabChunk* next;
+    void* align;         /* header is two pointers, objects follow */
+};
+
+/******************************************************************************
+ * slabInit
+ ******************************************************************************/
+void slabInit(SlabPool* p, size_t objSize, size_t perSlab) {
+    size_t a = sizeof(void*);
+    if (objSize < a) objSize = a;
+    p->objSize    = (objSize + a - 1) & ~(a - 1);
+    p->perSlab    = perSlab ? perSlab : 1;
+    p->freeList   = NULL;
+    p->bump       = NULL;
+    p->bumpEnd    = NULL;
+    p->chunks     = NULL;
+    p->chunkCount = 0;
+    p->inUse      = 0;
+    p->peakInUse  = 0;
+}
+
+/******************************************************************************
+ * slabAlloc
+ ******************************************************************************/
+void* slabAlloc(SlabPool* p) {
+    void* obj;
+    if (p->freeList) {
+        obj = p->freeList;
+        p->freeList = *(void**) obj;
+    } else {
+        if (p->bump == p->bumpEnd) {
+            SlabChunk* c = (SlabChunk*) malloc(sizeof(SlabChunk) + p->perSlab * p->objSize);
+            if (!c) {
+                fprintf(stderr, "[ERROR] Out of memory growing slab pool.\n");
+                return NULL;
+            }
+            c->next    = p->chunks;
+            p->chunks  = c;
+            p->chunkCount++;
+            p->bump    = (char*) (c + 1);
+            p->bumpEnd = p->bump + p->perSlab * p->objSize;
+        }
+        obj = p->bump;
+        p->bump += p->objSize;
+    }
+    if (++p->inUse > p->peakInUse) p->peakInUse = p->inUse;
+    return obj;
+}
+
+/******************************************************************************
+ * slabFree
+ ******************************************************************************/
+void slabFree(SlabPool* p, void* obj) {
+    if (!obj) return;
+    *(void**) obj = p->freeList;
+    p->freeList = obj;
+    p->inUse--;
+}
+
+/******************************************************************************
+ * slabRelease
+ ******************************************************************************/
+void slabRelease(SlabPool* p) {
+    while (p->chunks) {
+        SlabChunk* c = p->chunks;
+        p->chunks = c->next;
+        free(c);
+    }
+    slabInit(p, p->objSize, p->perSlab);
+}
+
+/******************************************************************************
+ * slabStats
+ ******************************************************************************/
+void slabStats(const SlabPool* p, SlabStats* out) {
+    out->objSize   = p->objSize;
+    out->chunks    = p->chunkCount;
+    out->capacity  = p->chunkCount * p->perSlab;
+    out->inUse     = p->inUse;
+    out->peakInUse = p->peakInUse;
+    out->bytes     = p->chunkCount * (sizeof(SlabChunk) + p->perSlab * p->objSize);
+}
@@ -0,0 +1,84 @@
+/******************************************************************************
+ * File: slab.h
+ *
+ * Fixed-size object pool for the routing tables' nodes (Route,
+ * NeighborNode).
+ *
+ *   - slabInit()    -> pool of objSize-byte objects, perSlab per chunk
+ *   - slabAlloc()   -> pop the free list, else carve from the current chunk
+ *   - slabFree()    -> push back on the free list (memory stays in the pool)
+ *   - slabRelease() -> free every chunk at once (bulk release)
+ *   - slabStats()   -> occupancy
+ *
+ * Not thread-safe: each pool is used under its owner's lock. Objects are
+ * aligned to sizeof(void*).
+ ******************************************************************************/
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct SlabChunk SlabChunk;
+
+typedef struct SlabPool {
+    size_t objSize;      /* rounded up to sizeof(void*) */
+    size_t perSlab;      /* objects per chunk */
+    void* freeList;      /* freed objects, linked through their first word */
+    char* bump;          /* next never-used object in the newest chunk */
+    char* bumpEnd;
+    SlabChunk* chunks;
+    size_t chunkCount;
+    size_t inUse;
+    size_t peakInUse;
+} SlabPool;
+
+typedef struct SlabStats {
+    size_t objSize;
+    size_t chunks;
+    size_t capacity;     /* objects the chunks can hold */
+    size_t inUse;
+    size_t peakInUse;
+    size_t bytes;        /* memory held by the pool */
+} SlabStats;
+
+/* Static initializer, same as slabInit(). */
+#define SLAB_POOL_INIT(objSize, perSlab) \
+    { ((objSize) + sizeof(void*) - 1) & ~(sizeof(void*) - 1), (perSlab), \
+      NULL, NULL, NULL, NULL, 0, 0, 0 }
+
+/**
+ * @brief Initialize an empty pool; no memory is allocated until slabAlloc().
+ */
+void slabInit(SlabPool* p, size_t objSize, size_t perSlab);
+
+/**
+ * @brief Get an uninitialized object, NULL if out of memory.
+ */
+void* slabAlloc(SlabPool* p);
+
+/**
+ * @brief Return obj (from slabAlloc() on p) to the pool. NULL is ignored.
+ */
+void slabFree(SlabPool* p, void* obj);
+
+/**
+ * @brief Free all chunks, invalidating every object from the pool, and
+ *        leave p empty but usable.
+ */
+void slabRelease(SlabPool* p);
+
+/**
+ * @brief Fill *out with p's occupancy.
+ */
+void slabStats(const SlabPool* p, SlabStats* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SLAB_H */
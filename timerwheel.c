@@ -0,0 +1,199 @@
+/******************************************************************************
+ * File: timerwheel.c
+ *
+ * Hierarchical timer wheel (see timerwheel.h), the classic cascading
+ * layout: a timer goes to the lowest level whose span covers its distance
+ * from w->next, in the slot given by its deadline's bits for that level.
+ * When w->next crosses a multiple of SLOTS^l, the level-l slot it enters
+ * is emptied and its timers reinserted one level down.
+ *
+ * timerAdvance() does not step through empty ticks: a bitmap of occupied
+ * slots per level lets it jump to the next occupied level-0 slot or the
+ * next cascade boundary, whichever comes first.
+ ******************************************************************************/
+
+#include "timerwheel.h"
+#include <string.h>
+
+#define SLOT_MASK ((uint64_t) TIMER_WHEEL_SLOTS - 1)
+
+/* Deadlines are rounded up to a tick so no timer fires early. */
+static inline uint64_t msToTick(const TimerWheel* w, uint64_t ms) {
+    return ms / w->tickMs + (ms % w->tickMs != 0);
+}
+
+/* Slots per level-l slot: SLOTS^l ticks. */
+static inline uint64_t levelSpan(unsigned level) {
+    return (uint64_t) 1 << (TIMER_WHEEL_BITS * level);
+}
+
+static inline uint64_t rotateRight(uint64_t x, unsigned n) {
+    return n ? (x >> n) | (x << (64 - n)) : x;
+}
+
+/******************************************************************************
+ * timerWheelInit
+ ******************************************************************************/
+void timerWheelInit(TimerWheel* w, unsigned tickMs) {
+    memset(w, 0, sizeof(*w));
+    w->tickMs = tickMs ? tickMs : 1;
+}
+
+/******************************************************************************
+ * insertTimer
+ *   Link t (t->expires set) into its slot relative to w->next.
+ ******************************************************************************/
+static void insertTimer(TimerWheel* w, TimerNode* t) {
+    if (t->expires < w->next) t->expires = w->next;
+    uint64_t delta = t->expires - w->next;
+    unsigned level = 0;
+    while (level + 1 < TIMER_WHEEL_LEVELS && delta >= levelSpan(level + 1)) level++;
+    if (delta >= levelSpan(TIMER_WHEEL_LEVELS)) {
+        /* beyond the top level: fire at its edge, the owner re-checks */
+        t->expires = w->next + levelSpan(TIMER_WHEEL_LEVELS) - 1;
+    }
+
+    unsigned index = (unsigned) ((t->expires >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK);
+    TimerNode** head = &w->slots[level][index];
+    t->next  = *head;
+    t->pprev = head;
+    if (*head) (*head)->pprev = &t->next;
+    *head = t;
+    t->slot = level * TIMER_WHEEL_SLOTS + index;
+    w->occupied[level] |= (uint64_t) 1 << index;
+}
+
+/******************************************************************************
+ * unlinkTimer
+ ******************************************************************************/
+static void unlinkTimer(TimerWheel* w, TimerNode* t) {
+    *t->pprev = t->next;
+    if (t->next) t->next->pprev = t->pprev;
+    unsigned level = t->slot / TIMER_WHEEL_SLOTS;
+    unsigned index = t->slot % TIMER_WHEEL_SLOTS;
+    if (!w->slots[level][index]) w->occupied[level] &= ~((uint64_t) 1 << index);
+    t->next  = NULL;
+    t->pprev = NULL;
+}
+
+/******************************************************************************
+ * timerSchedule
+ ******************************************************************************/
+void timerSchedule(TimerWheel* w, TimerNode* t, uint64_t nowMs, uint64_t expiresMs) {
+    if (timerPending(t)) {
+        unlinkTimer(w, t);
+        w->count--;
+    }
+    /* an empty wheel has nothing to keep in step with: restart it at now */
+    if (w->count == 0) w->next = nowMs / w->tickMs;
+    t->expires = msToTick(w, expiresMs);
+    insertTimer(w, t);
+    w->count++;
+}
+
+/******************************************************************************
+ * timerCancel
+ ******************************************************************************/
+void timerCancel(TimerWheel* w, TimerNode* t) {
+    if (!timerPending(t)) return;
+    unlinkTimer(w, t);
+    w->count--;
+}
+
+/******************************************************************************
+ * cascade
+ *   Reinsert the timers of w->slots[level][index] relative to w->next.
+ ******************************************************************************/
+static void cascade(TimerWheel* w, unsigned level, unsigned index) {
+    TimerNode* t = w->slots[level][index];
+    w->slots[level][index] = NULL;
+    w->occupied[level] &= ~((uint64_t) 1 << index);
+    while (t) {
+        TimerNode* next = t->next;
+        insertTimer(w, t);
+        t = next;
+    }
+}
+
+/******************************************************************************
+ * timerAdvance
+ ******************************************************************************/
+size_t timerAdvance(TimerWheel* w, uint64_t nowMs, TimerFn fn, void* ctx) {
+    uint64_t target = nowMs / w->tickMs;
+    size_t fired = 0;
+
+    while (w->next <= target) {
+        if (w->count == 0) {
+            w->next = target + 1;
+            break;
+        }
+
+        /* entering a new level-0 rotation: pull down the slots now due */
+        if ((w->next & SLOT_MASK) == 0) {
+            for (unsigned level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+                unsigned index = (unsigned) ((w->next >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK);
+                cascade(w, level, index);
+                if (index != 0) break;
+            }
+        }
+
+        /* skip to the next occupied level-0 slot or rotation boundary */
+        unsigned off = (unsigned) (w->next & SLOT_MASK);
+        uint64_t toBoundary = TIMER_WHEEL_SLOTS - off;
+        uint64_t rot = rotateRight(w->occupied[0], off);
+        uint64_t skip = rot ? (uint64_t) __builtin_ctzll(rot) : toBoundary;
+        if (skip > toBoundary) skip = toBoundary;
+        if (skip > 0) {
+            if (skip > target + 1 - w->next) skip = target + 1 - w->next;
+            w->next += skip;
+            continue;
+        }
+
+        /* detach the slot first: a timer fn reschedules may hash back into
+           it; the rest stay cancellable through the local list head */
+        TimerNode* due = w->slots[0][off];
+        due->pprev = &due;
+        w->slots[0][off] = NULL;
+        w->occupied[0] &= ~((uint64_t) 1 << off);
+        w->next++;
+        while (due) {
+            TimerNode* t = due;
+            due = t->next;
+            if (due) due->pprev = &due;
+            t->next  = NULL;
+            t->pprev = NULL;
+            w->count--;
+            fired++;
+            fn(ctx, t);
+        }
+    }
+    return fired;
+}
+
+/******************************************************************************
+ * timerNextExpiry
+ ******************************************************************************/
+uint64_t timerNextExpiry(const TimerWheel* w) {
+    if (w->count == 0) return UINT64_MAX;
+    uint64_t best = UINT64_MAX;
+
+    /* level 0 holds exact deadlines within one rotation of w->next */
+    if (w->occupied[0]) {
+        unsigned off = (unsigned) (w->next & SLOT_MASK);
+        best = w->next + (uint64_t) __builtin_ctzll(rotateRight(w->occupied[0], off));
+    }
+    /* higher levels: the first tick of the next occupied slot's span; the
+       current slot was cascaded already, so what is in it is a rotation
+       ahead */
+    for (unsigned level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        if (!w->occupied[level]) continue;
+        unsigned shift = TIMER_WHEEL_BITS * level;
+        uint64_t cur = w->next >> shift;
+        unsigned index = (unsigned) (cur & SLOT_MASK);
+        uint64_t rot = rotateRight(w->occupied[level], (index + 1) % TIMER_WHEEL_SLOTS);
+        uint64_t ahead = (uint64_t) __builtin_ctzll(rot) + 1;
+        uint64_t start = (cur + ahead) << shift;
+        if (start < best) best = start;
+    }
+    return best == UINT64_MAX ? best : best * w->tickMs;
+}
@@ -0,0 +1,101 @@
+/******************************************************************************
+ * File: timerwheel.h
+ *
+ * Hierarchical timer wheel for the routing tables' timeouts (neighbor
+ * expiry, route hold time).
+ *
+ *   - timerWheelInit()     -> empty wheel with a tick of tickMs
+ *   - timerSchedule()      -> (re)arm an embedded TimerNode, O(1)
+ *   - timerCancel()        -> disarm it, O(1)
+ *   - timerAdvance()       -> run every timer due by now, O(expired) plus
+ *                             one step per TIMER_WHEEL_SLOTS ticks crossed
+ *   - timerNextExpiry()    -> when to call timerAdvance() next
+ *
+ * Four levels of TIMER_WHEEL_SLOTS slots; level l holds timers due within
+ * SLOTS^(l+1) ticks and is cascaded into the level below as time reaches
+ * each of its slots, so every timer fires in the tick it is due. With a
+ * 10 ms tick that spans 46 hours; later deadlines are clamped there and
+ * fire early, so callers check their own deadline when a timer fires.
+ *
+ * Times are milliseconds from the owner's monotonic clock. Not
+ * thread-safe: each wheel is used under its owner's lock.
+ ******************************************************************************/
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TIMER_WHEEL_BITS   6
+#define TIMER_WHEEL_SLOTS  (1u << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+/* Embed in the object to time; zero-initialized => not scheduled. */
+typedef struct TimerNode {
+    struct TimerNode* next;
+    struct TimerNode** pprev;   /* NULL => not scheduled */
+    uint64_t expires;           /* tick it is due */
+    unsigned slot;              /* level * TIMER_WHEEL_SLOTS + index */
+} TimerNode;
+
+typedef struct TimerWheel {
+    unsigned tickMs;
+    uint64_t next;              /* next tick to run */
+    size_t count;               /* scheduled timers */
+    uint64_t occupied[TIMER_WHEEL_LEVELS];  /* non-empty slots per level */
+    TimerNode* slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+} TimerWheel;
+
+/* Called by timerAdvance() for each expired timer, already unscheduled;
+   it may schedule t again. */
+typedef void (*TimerFn)(void* ctx, TimerNode* t);
+
+/**
+ * @brief Initialize an empty wheel with a resolution of tickMs (>= 1).
+ */
+void timerWheelInit(TimerWheel* w, unsigned tickMs);
+
+/**
+ * @brief Arm t to fire at expiresMs (moving it if already scheduled).
+ *        nowMs is the current time; deadlines already past fire on the
+ *        next timerAdvance().
+ */
+void timerSchedule(TimerWheel* w, TimerNode* t, uint64_t nowMs, uint64_t expiresMs);
+
+/**
+ * @brief Disarm t. No-op if it is not scheduled.
+ */
+void timerCancel(TimerWheel* w, TimerNode* t);
+
+/**
+ * @brief 1 if t is scheduled.
+ */
+static inline int timerPending(const TimerNode* t) {
+    return t->pprev != NULL;
+}
+
+/**
+ * @brief Run fn for every timer due at or before nowMs, in deadline order
+ *        (tick resolution).
+ * @return Number of timers that fired.
+ */
+size_t timerAdvance(TimerWheel* w, uint64_t nowMs, TimerFn fn, void* ctx);
+
+/**
+ * @brief Earliest time a timer may be due: exact for timers within
+ *        TIMER_WHEEL_SLOTS ticks, the start of their slot's span for
+ *        later ones (so waking then and calling timerAdvance() is never
+ *        late). UINT64_MAX if the wheel is empty.
+ */
+uint64_t timerNextExpiry(const TimerWheel* w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TIMERWHEEL_H */
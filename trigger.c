@@ -0,0 +1,79 @@
+/******************************************************************************
+ * File: trigger.c
+ *
+ * Triggered-DV pacing (see trigger.h). The bucket counts thousandths of a
+ * DV so refilling at ratePerSec is exact per millisecond.
+ ******************************************************************************/
+
+#include "trigger.h"
+
+#define TOKEN 1000u  /* one DV */
+
+/******************************************************************************
+ * refill
+ ******************************************************************************/
+static void refill(DVTrigger* t, uint64_t now) {
+    if (now <= t->refilledAt) return;
+    uint64_t cap = (uint64_t) t->burst * TOKEN;
+    uint64_t add = (now - t->refilledAt) * t->ratePerSec;
+    t->tokens     = (cap - t->tokens < add) ? cap : t->tokens + add;
+    t->refilledAt = now;
+}
+
+/******************************************************************************
+ * dvTriggerInit
+ ******************************************************************************/
+void dvTriggerInit(DVTrigger* t, unsigned coalesceMs, unsigned holdDownMs,
+                   unsigned ratePerSec, unsigned burst, uint64_t nowMs) {
+    t->coalesceMs = coalesceMs;
+    t->holdDownMs = holdDownMs;
+    t->ratePerSec = ratePerSec;
+    t->burst      = burst ? burst : 1;
+    t->tokens     = (uint64_t) t->burst * TOKEN;
+    t->refilledAt = nowMs;
+    t->lastSent   = 0;
+    t->armed      = 0;
+    t->sent       = 0;
+    t->limited    = 0;
+}
+
+/******************************************************************************
+ * dvTriggerArm
+ ******************************************************************************/
+int dvTriggerArm(DVTrigger* t, uint64_t nowMs, uint64_t* dueMs) {
+    if (t->armed) return 0;
+    uint64_t due = nowMs + t->coalesceMs;
+    if (t->lastSent && t->lastSent + t->holdDownMs > due) {
+        due = t->lastSent + t->holdDownMs;
+    }
+    t->armed = 1;
+    *dueMs = due;
+    return 1;
+}
+
+/******************************************************************************
+ * dvTriggerFire
+ ******************************************************************************/
+int dvTriggerFire(DVTrigger* t, uint64_t nowMs, uint64_t* dueMs) {
+    if (t->ratePerSec) {
+        refill(t, nowMs);
+        if (t->tokens < TOKEN) {
+            uint64_t need = TOKEN - t->tokens;
+            *dueMs = nowMs + (need + t->ratePerSec - 1) / t->ratePerSec;
+            t->limited++;
+            return 0;
+        }
+        t->tokens -= TOKEN;
+    }
+    t->armed    = 0;
+    t->lastSent = nowMs;
+    t->sent++;
+    return 1;
+}
+
+/******************************************************************************
+ * dvTriggerCancel
+ ******************************************************************************/
+void dvTriggerCancel(DVTrigger* t) {
+    t->armed = 0;
+}
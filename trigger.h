@@ -0,0 +1,76 @@
+/******************************************************************************
+ * File: trigger.h
+ *
+ * Pacing of triggered DVs, shared by main.c's sender thread and sim.c.
+ *
+ *   - dvTriggerInit()    -> coalescing window, hold-down and token bucket
+ *   - dvTriggerArm()     -> a DV became pending: when to send it
+ *   - dvTriggerFire()    -> that time came: send now, or when to retry
+ *   - dvTriggerCancel()  -> nothing to send after all
+ *
+ * A pending DV waits coalesceMs so a burst of changes goes out as one, and
+ * never follows the previous triggered DV by less than holdDownMs. On top
+ * of that, a token bucket of burst DVs refilled at ratePerSec bounds the
+ * sustained rate under churn (a flapping neighbor) while letting a
+ * convergence burst through. Periodic full DVs are not counted.
+ *
+ * Times are ms from the caller's clock. Not thread-safe: one owner.
+ ******************************************************************************/
+
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DV_TRIGGER_RATE  3    /* default triggered DVs per second, sustained */
+#define DV_TRIGGER_BURST 20   /* default bucket depth */
+
+typedef struct DVTrigger {
+    unsigned coalesceMs;
+    unsigned holdDownMs;
+    unsigned ratePerSec;   /* 0 => no bucket */
+    unsigned burst;
+    uint64_t tokens;       /* in thousandths of a DV */
+    uint64_t refilledAt;
+    uint64_t lastSent;     /* 0 => none yet */
+    int armed;             /* a send time is pending */
+
+    uint64_t sent;         /* triggered DVs sent */
+    uint64_t limited;      /* times the bucket pushed one back */
+} DVTrigger;
+
+/**
+ * @brief Start with a full bucket at nowMs. ratePerSec == 0 disables the
+ *        bucket; burst is at least 1.
+ */
+void dvTriggerInit(DVTrigger* t, unsigned coalesceMs, unsigned holdDownMs,
+                   unsigned ratePerSec, unsigned burst, uint64_t nowMs);
+
+/**
+ * @brief A DV is pending at nowMs (dvPending()).
+ * @return 1 and *dueMs = when to call dvTriggerFire(), or 0 if a send time
+ *         is already armed (the change joins that DV).
+ */
+int dvTriggerArm(DVTrigger* t, uint64_t nowMs, uint64_t* dueMs);
+
+/**
+ * @brief The armed time came and a DV is still pending.
+ * @return 1 => send it now (a token is taken), 0 => rate-limited, stay
+ *         armed and call again at *dueMs.
+ */
+int dvTriggerFire(DVTrigger* t, uint64_t nowMs, uint64_t* dueMs);
+
+/**
+ * @brief The armed time came but nothing is pending any more.
+ */
+void dvTriggerCancel(DVTrigger* t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRIGGER_H */